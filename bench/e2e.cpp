@@ -131,6 +131,19 @@ static void testdemos_freddie_parse(benchmark::State &state) {
   get_bytes(state);
 }
 
+static void testdemos_freddie_parse_lazy(benchmark::State &state) {
+  auto demos = get_test_demos();
+
+  for (auto _ : state) {
+    for (auto &file : demos) {
+      freddie::demo_t demo;
+      freddie::demo_t::parse_demo_lazy(&demo, file.c_str());
+    }
+  }
+
+  get_bytes(state);
+}
+
 static void testdemos_freddie_write(benchmark::State &state) {
   auto demos = get_test_demos();
   std::vector<std::shared_ptr<freddie::demo_t>> demo_vec;
@@ -152,6 +165,27 @@ static void testdemos_freddie_write(benchmark::State &state) {
   get_bytes(state);
 }
 
+static void testdemos_freddie_write_parallel(benchmark::State &state) {
+  auto demos = get_test_demos();
+  std::vector<std::shared_ptr<freddie::demo_t>> demo_vec;
+  for (auto &file : demos) {
+    std::shared_ptr<freddie::demo_t> ptr = std::make_shared<freddie::demo_t>();
+    freddie::demo_t::parse_demo(ptr.get(), file.c_str());
+    demo_vec.emplace_back(ptr);
+  }
+
+  for (auto _ : state) {
+    for (auto demo : demo_vec) {
+      freddie::memory_stream output;
+      auto result = demo->write_demo(&output, {freddie::memory_stream_write}, false, 0);
+      if(result.error)
+        abort();
+    }
+  }
+
+  get_bytes(state);
+}
+
 static void testdemos_freddie_convert(benchmark::State &state) {
   auto demos = get_test_demos();
   std::vector<std::shared_ptr<freddie::demo_t>> demo_vec;
@@ -170,10 +204,36 @@ static void testdemos_freddie_convert(benchmark::State &state) {
   get_bytes(state);
 }
 
+static void testdemos_freddie_convert_streaming(benchmark::State &state) {
+  auto demos = get_test_demos();
+  std::vector<std::shared_ptr<freddie::demo_t>> demo_vec;
+  for (auto &file : demos) {
+    std::shared_ptr<freddie::demo_t> ptr = std::make_shared<freddie::demo_t>();
+    freddie::demo_t::parse_demo_lazy(ptr.get(), file.c_str());
+    demo_vec.emplace_back(ptr);
+  }
+
+  for (auto _ : state) {
+    for (size_t i = 0; i < demos.size(); ++i) {
+      freddie::memory_stream input;
+      input.fill_with_file(demos[i].c_str());
+      freddie::memory_stream output;
+      freddie::convert_demo(demo_vec[i].get(), &input,
+                            {freddie::memory_stream_read, freddie::memory_stream_seek}, &output,
+                            {freddie::memory_stream_write});
+    }
+  }
+
+  get_bytes(state);
+}
+
 BENCHMARK(testdemos_parse_only);
 BENCHMARK(testdemos_packet_only);
 BENCHMARK(testdemos_header_only);
 BENCHMARK(testdemos_parse_everything);
 BENCHMARK(testdemos_freddie_parse);
+BENCHMARK(testdemos_freddie_parse_lazy);
 BENCHMARK(testdemos_freddie_write);
+BENCHMARK(testdemos_freddie_write_parallel);
 BENCHMARK(testdemos_freddie_convert);
+BENCHMARK(testdemos_freddie_convert_streaming);
@@ -0,0 +1,114 @@
+#include "benchmark/benchmark.h"
+#include "demogobbler.h"
+#include "test_demos.hpp"
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace {
+struct demo_datatables {
+  dg_demver_data version;
+  std::vector<uint8_t> raw;
+  bool has_datatables = false;
+};
+} // namespace
+
+static void version_handler(parser_state *state, dg_demver_data version) {
+  demo_datatables *output = (demo_datatables *)state->client_state;
+  output->version = version;
+}
+
+static void datatables_handler(parser_state *state, dg_datatables *message) {
+  demo_datatables *output = (demo_datatables *)state->client_state;
+  if (!output->has_datatables) {
+    uint8_t *data = (uint8_t *)message->data;
+    output->raw.assign(data, data + message->size_bytes);
+    output->has_datatables = true;
+  }
+}
+
+// Datatables of every game in the test corpus, parsed once so that only flattening is measured
+struct parsed_datatables {
+  dg_demver_data version;
+  std::vector<uint8_t> raw;
+  dg_arena arena;
+  dg_datatables_parsed parsed;
+
+  parsed_datatables() { arena = dg_arena_create(1 << 17); }
+  ~parsed_datatables() { dg_arena_free(&arena); }
+};
+
+static std::vector<std::unique_ptr<parsed_datatables>> get_datatables() {
+  std::vector<std::unique_ptr<parsed_datatables>> output;
+
+  for (auto &demo : get_test_demos()) {
+    demo_datatables datatables;
+    dg_settings settings;
+    dg_settings_init(&settings);
+    settings.client_state = &datatables;
+    settings.demo_version_handler = version_handler;
+    settings.datatables_handler = datatables_handler;
+    dg_parse_file(&settings, demo.c_str());
+
+    if (!datatables.has_datatables)
+      continue;
+
+    auto ptr = std::make_unique<parsed_datatables>();
+    ptr->version = datatables.version;
+    ptr->raw = std::move(datatables.raw);
+
+    dg_datatables message;
+    memset(&message, 0, sizeof(message));
+    message.data = ptr->raw.data();
+    message.size_bytes = ptr->raw.size();
+    dg_alloc_state allocator = dg_arena_create_allocator(&ptr->arena);
+    auto result = dg_parse_datatables(&ptr->version, &allocator, &message);
+
+    if (result.error)
+      continue;
+
+    ptr->parsed = result.output;
+    output.emplace_back(std::move(ptr));
+  }
+
+  return output;
+}
+
+static void testdemos_flatten_datatables(benchmark::State &state) {
+  auto datatables = get_datatables();
+  dg_arena arena = dg_arena_create(1 << 20);
+  dg_alloc_state allocator = dg_arena_create_allocator(&arena);
+  estate entity_state;
+  memset(&entity_state, 0, sizeof(entity_state));
+  size_t props = 0;
+
+  for (auto _ : state) {
+    for (auto &dt : datatables) {
+      estate_init_args args;
+      args.version_data = &dt->version;
+      args.message = &dt->parsed;
+      args.allocator = &allocator;
+      args.flatten_datatables = true;
+      args.should_store_props = false;
+      args.build_prop_lookup = false;
+
+      // Scrap is kept around between iterations like a parser context would
+      entity_parse_scrap scrap = entity_state.scrap;
+      memset(&entity_state, 0, sizeof(entity_state));
+      entity_state.scrap = scrap;
+      dg_estate_init(&entity_state, args);
+
+      for (size_t i = 0; i < entity_state.serverclass_count; ++i) {
+        props += entity_state.class_datas[i].prop_count;
+      }
+      dg_arena_clear(&arena);
+    }
+  }
+
+  benchmark::DoNotOptimize(props);
+  state.SetItemsProcessed(props);
+  dg_estate_free(&entity_state);
+  dg_arena_free(&arena);
+}
+
+BENCHMARK(testdemos_flatten_datatables);
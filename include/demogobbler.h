@@ -8,6 +8,7 @@ extern "C" {
 #include "demogobbler/bitwriter.h"
 #include "demogobbler/datatable_types.h"
 #include "demogobbler/entity_types.h"
+#include "demogobbler/gameevent_types.h"
 #include "demogobbler/header.h"
 #include "demogobbler/io.h"
 #include "demogobbler/packet_netmessages.h"
@@ -32,6 +33,16 @@ dg_parse_result dg_parse_file(dg_settings *settings, const char *filepath);
 dg_parse_result dg_parse_buffer(dg_settings *settings, void *buffer, size_t size);
 dg_parse_result dg_parse(dg_settings *settings, void *stream, dg_input_interface dg_input_interface);
 
+dg_parser_context dg_parser_context_create(void);
+void dg_parser_context_reset(dg_parser_context *context);
+void dg_parser_context_free(dg_parser_context *context);
+dg_parse_result dg_parse_file_with_context(dg_parser_context *context, dg_settings *settings,
+                                           const char *filepath);
+dg_parse_result dg_parse_buffer_with_context(dg_parser_context *context, dg_settings *settings,
+                                             void *buffer, size_t size);
+dg_parse_result dg_parse_with_context(dg_parser_context *context, dg_settings *settings,
+                                      void *stream, dg_input_interface dg_input_interface);
+
 struct dg_writer {
   void *_stream;
   const char *error_message;
@@ -41,6 +52,9 @@ struct dg_writer {
   bool expect_equal;
   dg_demver_data version;
   struct dg_bitwriter bitwriter;
+  uint8_t *_buffer; // Output is gathered here and passed on in large blocks
+  size_t _buffer_offset;
+  size_t _buffer_size;
 };
 
 typedef struct dg_writer writer;
@@ -49,6 +63,8 @@ void dg_writer_init(writer *thisptr);
 void dg_writer_open_file(writer *thisptr, const char *filepath);
 void dg_writer_open(writer *thisptr, void *stream, output_interface output_interface);
 void dg_writer_close(writer *thisptr);
+// Passes on buffered output, done automatically on close
+void dg_writer_flush(writer *thisptr);
 void dg_write_consolecmd(writer *thisptr, dg_consolecmd *message);
 void dg_write_customdata(writer *thisptr, dg_customdata *message);
 void dg_write_datatables(writer *thisptr, dg_datatables *message);
@@ -56,6 +72,9 @@ void dg_write_datatables_parsed(writer *thisptr, dg_datatables_parsed *datatable
 void dg_write_header(writer *thisptr, dg_header *message);
 void dg_write_packet(writer *thisptr, dg_packet *message);
 void dg_write_packet_parsed(writer *thisptr, packet_parsed *message);
+// Encodes the net messages of a packet padded to a whole byte, without the packet header
+void dg_bitwriter_write_packet_data(dg_bitwriter *bitwriter, dg_demver_data *version,
+                                    packet_parsed *message);
 void dg_write_preamble(writer *thisptr, dg_message_preamble preamble);
 void dg_write_synctick(writer *thisptr, dg_synctick *message);
 void dg_write_stop(writer *thisptr, dg_stop *message);
@@ -75,11 +94,27 @@ typedef struct {
   dg_alloc_state* allocator;
   bool flatten_datatables;
   bool should_store_props;
+  bool build_prop_lookup; // Allows dg_estate_find_prop to find props without a linear scan
 } estate_init_args;
 
 dg_parse_result dg_parse_instancebaseline(const dg_instancebaseline_args* args);
+void dg_baseline_cache_init(dg_baseline_cache *cache, dg_alloc_state *allocator, uint32_t table_id,
+                            uint32_t max_entries);
+// Stores the changed entries of the instancebaseline stringtable, they are decoded right away if
+// the entity state has been initialized
+dg_parse_result dg_baseline_cache_update(dg_baseline_cache *cache, const dg_baseline_cache_args *args,
+                                         const dg_sentry *entries);
+// Decodes the baselines that have changed since they were last decoded
+dg_parse_result dg_baseline_cache_decode(dg_baseline_cache *cache, const dg_baseline_cache_args *args);
+// Returns NULL if the class has no decoded baseline
+const dg_ent_update *dg_baseline_cache_get(const dg_baseline_cache *cache, uint32_t datatable_id);
 dg_datatables_parsed_rval dg_parse_datatables(dg_demver_data *state, dg_alloc_state *allocator,
                                               dg_datatables *message);
+// Strings are interned into the pool, which can be shared between demos
+dg_datatables_parsed_rval dg_parse_datatables_with_pool(dg_demver_data *state,
+                                                        dg_alloc_state *allocator,
+                                                        dg_datatables *message,
+                                                        struct dg_string_pool *pool);
 dg_parse_result dg_estate_init(estate *thisptr, estate_init_args args);
 dg_parse_result dg_parse_stringtables(dg_stringtables_parsed *out, stringtable_parse_args args);
 dg_parse_result dg_estate_update(estate *entity_state, const dg_packetentities_data *data);
@@ -87,7 +122,12 @@ void dg_estate_free(estate *thisptr);
 
 void dg_estate_init_table(dg_parser *thisptr, size_t index);
 void dg_parser_init_estate(dg_parser *thisptr, dg_datatables_parsed *message);
+void dg_parser_attach_estate(dg_parser *thisptr, const struct dg_shared_datatables *shared);
 dg_serverclass_data *dg_estate_serverclass_data(estate *thisptr, const dg_demver_data* demver_data, dg_alloc_state* allocator, size_t index);
+// Returns the flattened index of the prop or -1 if not found. The name is either qualified with
+// the table name ("DT_BaseEntity.m_vecOrigin") or just the prop name, in which case the first
+// match is returned. The class must have been flattened already.
+int dg_estate_find_prop(const estate *thisptr, size_t class_id, const char *name);
 dg_eproparr dg_eproparr_init(uint16_t prop_count);
 // Get a dg_prop_value_inner for this index, also creates it if doesnt exist
 dg_prop_value_inner *dg_eproparr_get(dg_eproparr *thisptr, uint16_t index, bool *new_prop);
@@ -95,6 +135,30 @@ dg_prop_value_inner *dg_eproparr_get(dg_eproparr *thisptr, uint16_t index, bool
 // Returns null when no more values left
 dg_prop_value_inner *dg_eproparr_next(const dg_eproparr *thisptr, dg_prop_value_inner *current);
 void dg_eproparr_free(dg_eproparr *thisptr);
+// Only valid while the entity state tracks changed props
+bool dg_edict_prop_changed(const dg_edict *ent, uint32_t prop_index);
+// Snapshots record the original values of the props that get written after the snapshot was
+// taken, so a diff only looks at entities that were updated since. Requires stored props,
+// returns NULL otherwise. Snapshots are freed along with the entity state.
+dg_estate_snapshot *dg_estate_snapshot_create(estate *thisptr);
+// Moves the snapshot to the current state
+void dg_estate_snapshot_reset(estate *thisptr, dg_estate_snapshot *snapshot);
+void dg_estate_snapshot_free(estate *thisptr, dg_estate_snapshot *snapshot);
+dg_estate_diff dg_estate_snapshot_diff(const estate *thisptr, const dg_estate_snapshot *snapshot,
+                                       dg_alloc_state *allocator);
+// The history keeps the values that props had before each change in the last max_ticks ticks
+// that changed anything, updates are recorded at the tick set in the entity state. Requires
+// stored props, returns NULL otherwise. Replaces the previous history if there was one.
+dg_estate_history *dg_estate_history_create(estate *thisptr, uint32_t max_ticks);
+void dg_estate_history_free(estate *thisptr);
+// Value of the prop at the end of the tick, NULL if the entity did not have the prop or the tick
+// is older than the history. Values are only valid until the next update.
+const dg_prop_value_inner *dg_estate_history_get(const estate *thisptr, uint32_t ent_index,
+                                                 uint32_t prop_index, int32_t tick);
+// Value at first_tick followed by every change up to and including last_tick
+dg_prop_history dg_estate_history_range(const estate *thisptr, uint32_t ent_index,
+                                        uint32_t prop_index, int32_t first_tick,
+                                        int32_t last_tick, dg_alloc_state *allocator);
 
 dg_eproplist dg_eproplist_init(void);
 dg_epropnode *dg_eproplist_get(dg_eproplist *thisptr, dg_epropnode *initial_guess, uint16_t index,
@@ -103,6 +167,7 @@ dg_epropnode *dg_eproplist_next(const dg_eproplist *thisptr, dg_epropnode *curre
 void dg_eproplist_free(dg_eproplist *thisptr);
 void dg_sendprop_name(char* buffer, size_t size, const dg_sendprop *prop);
 enum dg_proptype dg_sendprop_type(const dg_sendprop* prop);
+void dg_flatprop_init(dg_flatprop *flatprop, const dg_sendprop *prop);
 dg_parse_result dg_parse_stringtable_entry(dg_sentry_parse_args *args, dg_sentry *out);
 dg_parse_result dg_write_stringtable_entry(dg_sentry_write_args *args);
 
@@ -117,9 +182,20 @@ dg_alloc_state* dg_parser_packet_allocator(dg_parser *thisptr);
 void dg_init_baseline(dg_ent_update *baseline, const dg_serverclass_data *target_datatable,
                           dg_alloc_state* allocator);
 dg_parse_result dg_parse_packetentities(dg_packetentities_parse_args* args);
+dg_parse_result dg_parse_temp_entities(dg_temp_entities_parse_args* args);
 
 struct dg_usercmd_parsed;
 
+dg_parse_result dg_parse_game_event_list(dg_game_event_list *out, const dg_game_event_list_parse_args *args);
+dg_parse_result dg_parse_game_event(dg_game_event_parsed *out, const dg_game_event_parse_args *args);
+// Returns NULL if not found
+const dg_game_event_descriptor *dg_game_event_list_find(const dg_game_event_list *list, const char *name);
+// Returns the index into the value array or -1 if not found
+int dg_game_event_find_key(const dg_game_event_descriptor *descriptor, const char *name);
+
+dg_user_message_type dg_get_user_message_type(const dg_demver_data *version_data, uint8_t msg_type);
+dg_parse_result dg_parse_user_message(dg_user_message_parsed *out, const dg_user_message_parse_args *args);
+
 dg_parse_result dg_parser_parse_usercmd(const dg_demver_data* version_data, const dg_usercmd *input, struct dg_usercmd_parsed* out);
 void dg_bitwriter_write_usercmd(dg_bitwriter* thisptr, struct dg_usercmd_parsed* parsed);
 
@@ -40,6 +40,8 @@ typedef struct write_packetentities_args write_packetentities_args;
 
 void dg_bitwriter_init(dg_bitwriter *thisptr, uint32_t initial_size_bits);
 int64_t dg_bitwriter_get_available_bits(dg_bitwriter *thisptr);
+// Makes room for at least this many more bits, so that writing them doesn't reallocate
+void dg_bitwriter_reserve(dg_bitwriter *thisptr, uint32_t bits);
 void dg_bitwriter_write_bit(dg_bitwriter *thisptr, bool value);
 void dg_bitwriter_write_bitcoord(dg_bitwriter *thisptr, dg_bitcoord value);
 void dg_bitwriter_write_bits(dg_bitwriter *thisptr, const void *src, unsigned int bits);
@@ -0,0 +1,41 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "demogobbler/datatable_types.h"
+#include "demogobbler/entity_types.h"
+#include "demogobbler/parser_types.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Flattened datatables that are shared between all parsers that see the same datatables block.
+// Everything in here is immutable once published, per-demo entity state lives in the parser.
+struct dg_shared_datatables {
+  dg_datatables_parsed datatables;
+  dg_serverclass_data *class_datas; // All serverclasses are flattened
+  uint64_t hash;                    // Hash of the raw datatables block
+};
+
+typedef struct dg_shared_datatables dg_shared_datatables;
+typedef struct dg_datatable_registry dg_datatable_registry;
+
+// Thread-safe, can be shared by any number of parsers running at the same time
+dg_datatable_registry *dg_datatable_registry_create(void);
+// All entries must have been released before this is called
+void dg_datatable_registry_free(dg_datatable_registry *registry);
+// Finds or creates the entry for this datatables block, the entry stays alive until released
+const dg_shared_datatables *dg_datatable_registry_acquire(dg_datatable_registry *registry,
+                                                          const dg_demver_data *version_data,
+                                                          const dg_datatables *message,
+                                                          const char **error_message);
+void dg_datatable_registry_release(dg_datatable_registry *registry,
+                                   const dg_shared_datatables *entry);
+// Frees the entries that are not currently in use, returns the amount of entries freed
+size_t dg_datatable_registry_trim(dg_datatable_registry *registry);
+size_t dg_datatable_registry_count(dg_datatable_registry *registry);
+
+#ifdef __cplusplus
+}
+#endif
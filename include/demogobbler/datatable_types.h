@@ -75,6 +75,8 @@ struct dg_sendtable {
   const char *name;
   dg_sendprop *props;
   size_t prop_count;
+  uint32_t name_hash; // dg_hashtable_hash of the name
+  uint32_t name_length;
   bool needs_decoder;
 };
 
@@ -5,8 +5,11 @@ extern "C" {
 #endif
 
 #include "demogobbler/allocator.h"
+#include "demogobbler/bitstream.h"
 #include "demogobbler/floats.h"
+#include "demogobbler/vector_array.h"
 #include <stddef.h>
+#include <stdint.h>
 
 struct dg_sendprop;
 struct dg_sendtable;
@@ -19,7 +22,16 @@ typedef struct {
 } dg_hashtable_entry;
 
 typedef struct {
-  dg_hashtable_entry *arr;
+  const char *str;
+  size_t value;
+  uint32_t hash;
+  uint32_t length;
+} dg_hashtable_slot;
+
+// Open addressing table with one control byte per slot, probed a group of slots at a time
+typedef struct {
+  dg_hashtable_slot *arr;
+  uint8_t *ctrl; // Empty or the low 7 bits of the hash of the slot
   size_t max_items;
   size_t item_count;
 } dg_hashtable;
@@ -107,6 +119,22 @@ struct dg_ent_update {
 
 typedef struct dg_ent_update dg_ent_update;
 
+typedef struct {
+  dg_bitstream data;     // Copy of the stringtable userdata in the permanent arena
+  dg_ent_update decoded; // Props are allocated from the permanent arena
+  bool has_data;
+  bool is_decoded;
+} dg_instancebaseline;
+
+// Contents of the instancebaseline stringtable, each baseline is decoded once per update
+typedef struct {
+  dg_instancebaseline *baselines; // Indexed by datatable id
+  int32_t *entry_classes;         // Datatable id of each stringtable entry, -1 if not known
+  uint32_t max_entries;           // Size of both arrays
+  uint32_t table_id;
+  bool exists;
+} dg_baseline_cache;
+
 struct dg_packetentities_data {
   dg_ent_update *ent_updates;
   size_t ent_updates_count;
@@ -122,6 +150,24 @@ typedef struct {
   struct dg_svc_packet_entities *orig;
 } dg_svc_packetentities_parsed;
 
+struct dg_svc_temp_entities;
+
+struct dg_temp_entity {
+  dg_ent_update update; // ent_index and handle are not used by temp entities
+  float delay;
+  bool new_class; // If false, props are a delta from the previous temp entity in the message
+};
+
+typedef struct dg_temp_entity dg_temp_entity;
+
+struct dg_svc_temp_entities_parsed {
+  dg_temp_entity *entities; // Only contains classes that passed the filter
+  size_t entities_count;
+  struct dg_svc_temp_entities *orig;
+};
+
+typedef struct dg_svc_temp_entities_parsed dg_svc_temp_entities_parsed;
+
 struct dg_epropnode;
 typedef struct dg_epropnode dg_epropnode;
 
@@ -152,10 +198,81 @@ typedef struct {
 #else
   dg_eproparr props;
 #endif
+  uint64_t *changed_props; // Bit per flattened prop whose value changed in the last update
+  bool changed;
 } dg_edict;
 
 typedef struct {
-  struct dg_sendprop *props;
+  const dg_edict *ent;
+  const uint64_t *changed_props; // See dg_edict_prop_changed
+  uint32_t ent_index;
+} dg_changed_entity;
+
+// Entities whose props changed value in a svc_packetentities message, props that were sent with
+// the same value they already had are not included
+struct dg_changed_props {
+  dg_changed_entity *entities;
+  size_t entities_count;
+};
+
+typedef struct dg_changed_props dg_changed_props;
+
+enum {
+  dg_entity_diff_created = 1,
+  dg_entity_diff_deleted = 2, // Both created and deleted are set if the edict was reused
+  dg_entity_diff_entered_pvs = 4,
+  dg_entity_diff_left_pvs = 8,
+};
+
+typedef struct {
+  uint16_t *changed_props; // Flattened indices of props whose value differs, in ascending order
+  uint32_t changed_props_count;
+  uint32_t ent_index;
+  uint32_t flags;
+} dg_entity_diff;
+
+// Entities that differ between a snapshot and the current entity state
+typedef struct {
+  dg_entity_diff *entities;
+  size_t entities_count;
+} dg_estate_diff;
+
+typedef struct dg_estate_snapshot dg_estate_snapshot;
+typedef struct dg_estate_history dg_estate_history;
+
+typedef struct {
+  const dg_prop_value_inner *value; // NULL if the entity did not have the prop at this tick
+  int32_t tick;
+} dg_prop_history_entry;
+
+// Value of a prop at the first tick of a range followed by the values it changed to within it
+typedef struct {
+  dg_prop_history_entry *entries;
+  size_t entries_count;
+} dg_prop_history;
+
+// What decoding needs from a flattened prop, kept in its own array so that the decode loop only
+// touches a few bytes per prop
+typedef struct {
+  float low_value;
+  float high_value;
+  unsigned proptype : 4; // dg_sendproptype
+  unsigned type : 4;     // enum dg_proptype, for vectors this is the type of the components
+  unsigned prop_numbits : 7;
+  unsigned array_num_elements : 10;
+  unsigned flag_normal : 1;
+} dg_flatprop;
+
+typedef struct {
+  uint32_t hash;
+  uint32_t value; // Flattened prop index + 1 with the top bit set for qualified names, 0 if empty
+} dg_prop_lookup_slot;
+
+typedef struct {
+  struct dg_sendprop **props; // Point into the sendtables, shared by every class that has the prop
+  dg_flatprop *flatprops;     // Same order as props
+  dg_prop_lookup_slot *lookup; // Name to index, only built if requested when flattening
+  uint32_t lookup_mask;
   size_t prop_count;
   const char *dt_name;
 } dg_serverclass_data;
@@ -164,6 +281,7 @@ struct entity_parse_scrap {
   dg_pes excluded_props;
   dg_hashtable dts_with_excludes;
   dg_hashtable dt_hashtable;
+  dg_vector_array flattened_props; // Pointers to the props of the serverclass being flattened
 };
 
 typedef struct entity_parse_scrap entity_parse_scrap;
@@ -176,7 +294,15 @@ struct estate {
   uint32_t sendtable_count;
   uint32_t serverclass_count;
   entity_parse_scrap scrap;
+  const dg_baseline_cache *instancebaselines; // Applied on enter PVS when props are stored
+  dg_estate_snapshot *snapshots; // Snapshots that record the updates applied after them
+  dg_estate_history *history;    // Optional, prop changes of the last few ticks
+  uint16_t *changed_edicts; // Edicts with changed props in the last update
+  uint32_t changed_edicts_count;
+  int32_t tick; // Tick of the updates being applied, only used by the history
   bool should_store_props;
+  bool track_changed_props; // Requires should_store_props, set before the first update
+  bool build_prop_lookup;
 };
 
 typedef struct estate estate;
@@ -197,6 +323,7 @@ struct dg_parser_state {
   estate entity_state;
   dg_stringtable_data stringtables[MAX_STRINGTABLES];
   uint32_t stringtables_count;
+  dg_baseline_cache instancebaselines;
   const char *error_message;
   bool error;
 };
@@ -27,14 +27,35 @@ namespace freddie {
   void free(void *ptr); // free specific pointer
   };
 
+  // dg_packet is only used for packets of lazily loaded demos that have not been decoded
   typedef std::variant<packet_parsed, dg_customdata, dg_datatables_parsed,
                       dg_stringtables_parsed, dg_consolecmd, dg_synctick, dg_usercmd,
-                      dg_stop>
+                      dg_stop, dg_packet>
       packet_variant_t;
 
-  struct demo_packet {
-  packet_variant_t packet;
-  mallocator memory;
+  struct lazy_decoder;
+
+  template <typename T, size_t I = 0> constexpr size_t packet_variant_index() {
+    if constexpr (std::is_same_v<std::variant_alternative_t<I, packet_variant_t>, T>) {
+      return I;
+    } else {
+      return packet_variant_index<T, I + 1>();
+    }
+  }
+
+  struct packet_range {
+    size_t first;
+    size_t last; // One past the last packet
+  };
+
+  struct tick_run {
+    int32_t tick;
+    packet_range packets;
+  };
+
+  struct message_location {
+    size_t packet_index;
+    size_t message_index;
   };
 
   dg_parse_result splice_demos(const char *output_path, const char **demo_paths, size_t demo_count);
@@ -43,32 +64,99 @@ namespace freddie {
     demo_t();
     ~demo_t();
 
-    mallocator temp_allocator;
-    dg_arena arena;
+    dg_arena arena;    // Owns everything the packets point to
+    mallocator memory; // Buffers handed over to the demo, e.g. rewritten packetentities data
     dg_demver_data demver_data;
     dg_header header;
-    std::vector<std::shared_ptr<demo_packet>> packets;
+    std::vector<packet_variant_t> packets; // In demo order
+    std::unique_ptr<lazy_decoder> decoder; // Only set for lazily loaded demos
+    // Indices into packets, built while parsing. Net messages of lazily loaded packets are not
+    // indexed. Call rebuild_indices after adding or removing packets.
+    std::vector<tick_run> tick_runs; // Consecutive packets with the same tick, in demo order
+    std::vector<size_t> type_index[std::variant_size_v<packet_variant_t>];
+    std::vector<message_location> netmessage_index[svc_invalid + 1];
+    bool ticks_sorted = true;
+    // Parsed packets that are not marked as modified are copied from their original data instead
+    // of being encoded. Changes to packets that aren't marked are lost, so only turn this on if
+    // every edit sets the flag.
+    bool passthrough_unmodified = false;
     demo_t(const demo_t &rhs) = delete;
     demo_t &operator=(const demo_t &rhs) = delete;
-  
-
-    template <typename T> std::shared_ptr<demo_packet> copy_packet(T *orig) {
-        auto packet = std::make_shared<demo_packet>();
-        packet->memory = std::move(temp_allocator);
-        packet->packet = *orig;
-        temp_allocator.release();
-
-        return packet;
-    }
 
     static dg_parse_result parse_demo(demo_t *output, void *stream, dg_input_interface interface);
     static dg_parse_result parse_demo(demo_t *output, const char *filepath);
-    dg_parse_result write_demo(void *stream, dg_output_interface interface, bool expect_equal=false);
-    dg_parse_result write_demo(const char *filepath);
-    dg_datatables_parsed *get_datatables() const;
+    // Keeps packets as raw dg_packets and decodes them on access through get_packet, the last
+    // cache_size decoded packets are kept around. Packet entities are not decoded since that
+    // needs the entity state of every packet before them, use parse_demo for that.
+    static dg_parse_result parse_demo_lazy(demo_t *output, void *stream,
+                                           dg_input_interface interface, size_t cache_size = 64);
+    static dg_parse_result parse_demo_lazy(demo_t *output, const char *filepath,
+                                           size_t cache_size = 64);
+    // Returns NULL if the message is not a packet or could not be decoded. Lazily decoded packets
+    // are only valid until they drop out of the cache and changes to them are not written out.
+    packet_parsed *get_packet(size_t index);
+
+    void index_packet(size_t index);
+    void rebuild_indices();
+    // Packets of the first run of the tick, empty if there are none. Stop has the tick of the
+    // packet before it.
+    packet_range get_tick_range(int32_t tick) const;
+    template <typename T> const std::vector<size_t> &get_packets_of_type() const {
+      return type_index[packet_variant_index<T>()];
+    }
+    const std::vector<message_location> &get_netmessages(net_message_type type) const {
+      return netmessage_index[type];
+    }
+    packet_net_message *get_netmessage(message_location location);
+    // With more than one thread parsed packets are encoded on worker threads and written out in
+    // order as they finish, 0 uses one thread per core. expect_equal encodes every parsed packet,
+    // even with passthrough_unmodified.
+    dg_parse_result write_demo(void *stream, dg_output_interface interface, bool expect_equal=false,
+                               unsigned thread_count = 1);
+    dg_parse_result write_demo(const char *filepath, unsigned thread_count = 1);
+    // Flattening the datatables caches lookups in them, so they are handed out as non-const
+    dg_datatables_parsed *get_datatables();
+  };
+
+  dg_parse_result convert_demo(demo_t *example, demo_t *demo);
+
+  // Gets every message of a streamed demo before it is written. Messages point to memory that is
+  // reused once they have been written, anything kept around has to be copied. Memory the message
+  // needs until then can be allocated from the allocator.
+  typedef std::function<dg_parse_result(packet_variant_t *message, dg_alloc_state *allocator)>
+      transform_func;
+
+  struct stream_settings {
+    std::vector<transform_func> transforms; // Applied in order
+    // Called before anything is written with the header and version of the input demo. Changing
+    // the version changes how parsed packets are encoded, with passthrough_unmodified packets have
+    // to be marked as modified for that to happen.
+    std::function<dg_parse_result(dg_header *header, dg_demver_data *version)> header_func;
+    // Called when the version of the input demo is updated after the header, which happens once
+    // the build of an L4D2 demo is known. The version can be changed the same way as in
+    // header_func.
+    std::function<dg_parse_result(dg_demver_data *version)> version_func;
+    // Holds messages back until the datatables have gone through the transforms, for transforms
+    // that need the datatables to handle signon data. Held messages stay in memory.
+    bool hold_until_datatables = false;
+    bool parse_packetentities = false;
+    // Same as demo_t::passthrough_unmodified, transforms have to mark the packets they change
+    bool passthrough_unmodified = false;
   };
 
-  dg_parse_result convert_demo(const demo_t *example, demo_t *demo);
+  // Parses the input and writes it to the output one message at a time, the demo is never kept
+  // in memory as a whole
+  dg_parse_result transform_demo(void *input, dg_input_interface input_interface, void *output,
+                                 dg_output_interface output_interface,
+                                 const stream_settings &settings);
+  dg_parse_result transform_demo(const char *input_path, const char *output_path,
+                                 const stream_settings &settings);
+  // Streaming version of convert_demo, only the example has to be in memory
+  dg_parse_result convert_demo(demo_t *example, void *input,
+                               dg_input_interface input_interface, void *output,
+                               dg_output_interface output_interface);
+  dg_parse_result convert_demo(demo_t *example, const char *input_path,
+                               const char *output_path);
 
   struct prop_status {
     dg_sendprop* target = nullptr;
@@ -89,24 +177,32 @@ namespace freddie {
     datatable_change_info(const datatable_change_info& lhs) = delete;
     datatable_change_info& operator=(const datatable_change_info& lhs) = delete;
 
-    dg_parse_result init(freddie::demo_t *input, const freddie::demo_t *target);
+    dg_parse_result init(freddie::demo_t *input, freddie::demo_t *target);
+    dg_parse_result init(dg_datatables_parsed *input, const dg_demver_data *input_version,
+                         dg_datatables_parsed *target, const dg_demver_data *target_version);
     void add_datatable(uint32_t new_index, bool changed, bool exists);
-    void add_prop(dg_sendprop* prop, prop_status status);
+    void add_prop(uint32_t datatable_id, uint32_t prop_index, prop_status status);
     void print(bool print_props);
     void print_props(uint32_t datatable_id);
   
-    prop_status get_prop_status(dg_sendprop* prop);
+    prop_status get_prop_status(uint32_t datatable_id, uint32_t prop_index);
     datatable_status get_datatable_status(uint32_t index);
     dg_parse_result convert_updates(dg_packetentities_data* data);
     dg_parse_result convert_instancebaselines(dg_sentry* stringtable, dg_bitstream* data);
     dg_parse_result convert_props(dg_ent_update* update, uint32_t new_datatable_id);
+    dg_parse_result convert_packet(packet_parsed* packet);
     dg_parse_result convert_demo(freddie::demo_t* input);
 
     dg_alloc_state allocator;
+    dg_alloc_state message_allocator; // Converted values, same as allocator unless streaming
     estate input_estate;
     estate target_estate;
-    std::unordered_map<dg_sendprop*, prop_status> prop_map;
-    std::vector<datatable_status> datatables;
+    // Status of every flattened prop of the input classes, the props of class i start at
+    // prop_offsets[i]. Flattened props share their sendprops between classes, so they are indexed
+    // by class and prop index instead of by sendprop.
+    std::vector<prop_status> props;
+    std::vector<size_t> prop_offsets;
+    std::vector<datatable_status> datatables; // Indexed by input datatable id
     dg_ent_update* baselines;
     uint32_t baselines_count;
     dg_datatables_parsed target_datatable;
@@ -0,0 +1,79 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "demogobbler/allocator.h"
+#include "demogobbler/bitstream.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Key types as they appear on the wire in svc_game_event_list
+enum dg_game_event_key_type {
+  dg_gekey_local = 0, // Not networked
+  dg_gekey_string = 1,
+  dg_gekey_float = 2,
+  dg_gekey_long = 3,
+  dg_gekey_short = 4,
+  dg_gekey_byte = 5,
+  dg_gekey_bool = 6,
+  dg_gekey_uint64 = 7
+};
+
+struct dg_game_event_descriptor_key {
+  const char *key_value; // Interned, same name => same pointer within one event list
+  uint32_t type;         // enum dg_game_event_key_type
+};
+
+struct dg_game_event_descriptor {
+  uint32_t event_id;
+  const char *name; // NULL if no event with this id exists
+  size_t key_count;
+  struct dg_game_event_descriptor_key *keys;
+  bool subscribed; // Unsubscribed events are skipped without decoding
+};
+
+typedef struct dg_game_event_descriptor_key dg_game_event_descriptor_key;
+typedef struct dg_game_event_descriptor dg_game_event_descriptor;
+
+// Compiled form of svc_game_event_list, descriptors are indexed directly by event id
+struct dg_game_event_list {
+  dg_game_event_descriptor *descriptors;
+  uint32_t descriptor_count; // Highest event id + 1
+};
+
+typedef struct dg_game_event_list dg_game_event_list;
+
+typedef union {
+  const char *str_val;
+  float float_val;
+  int32_t int_val; // long, short and byte
+  uint64_t uint64_val;
+  bool bool_val;
+} dg_game_event_value;
+
+// values[i] holds the value for descriptor->keys[i]
+struct dg_game_event_parsed {
+  const dg_game_event_descriptor *descriptor; // NULL if the event id was not in the list
+  dg_game_event_value *values;
+};
+
+typedef struct dg_game_event_parsed dg_game_event_parsed;
+
+typedef struct {
+  dg_alloc_state *allocator; // Descriptors and key names are allocated from here
+  dg_bitstream stream;
+  uint32_t events;
+} dg_game_event_list_parse_args;
+
+typedef struct {
+  dg_alloc_state *allocator; // Values and strings are allocated from here
+  const dg_game_event_list *list;
+  dg_bitstream stream;
+} dg_game_event_parse_args;
+
+#ifdef __cplusplus
+}
+#endif
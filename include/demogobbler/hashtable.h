@@ -1,17 +1,40 @@
 #pragma once
 
+#include "demogobbler/allocator.h"
 #include "demogobbler/datatable_types.h"
 #include "demogobbler/entity_types.h"
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
+// The table grows as needed, array_size is only a hint for the initial capacity
 dg_hashtable dg_hashtable_create(size_t array_size);
 dg_hashtable_entry dg_hashtable_get(dg_hashtable *thisptr, const char *str);
+// Returns false if the string is already in the table
 bool dg_hashtable_insert(dg_hashtable *thisptr, dg_hashtable_entry entry);
+// Versions of the above for when the length and hash of the string are already known
+uint32_t dg_hashtable_hash(const char *str, size_t length);
+dg_hashtable_entry dg_hashtable_get_hashed(dg_hashtable *thisptr, const char *str, size_t length,
+                                          uint32_t hash);
+bool dg_hashtable_insert_hashed(dg_hashtable *thisptr, dg_hashtable_entry entry, size_t length,
+                                uint32_t hash);
 void dg_hashtable_clear(dg_hashtable *thisptr);
 void dg_hashtable_free(dg_hashtable *thisptr);
 
+// Strings interned into the same pool can be compared by pointer
+struct dg_string_pool {
+  dg_hashtable table;
+  dg_alloc_state *allocator; // Interned strings are allocated from here
+};
+
+typedef struct dg_string_pool dg_string_pool;
+
+dg_string_pool dg_string_pool_create(dg_alloc_state *allocator, size_t size_hint);
+const char *dg_string_pool_intern(dg_string_pool *thisptr, const char *str, size_t length,
+                                  uint32_t hash);
+// Only frees the table, the strings stay alive as long as the allocator does
+void dg_string_pool_free(dg_string_pool *thisptr);
+
 dg_pes dg_pes_create(size_t array_size);
 bool dg_pes_has(dg_pes *thisptr, dg_sendtable *table, dg_sendprop *prop);
 bool dg_pes_insert(dg_pes *thisptr, dg_sendprop *entry);
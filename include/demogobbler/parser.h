@@ -57,13 +57,24 @@ typedef void (*func_dg_datatables_parsed)(parser_state *state, dg_datatables_par
 typedef void (*func_dg_packetentities_parsed)(parser_state *state,
                                               dg_svc_packetentities_parsed *message);
 typedef void (*func_dg_estate_init)(parser_state *state);
+typedef void (*func_dg_game_event)(parser_state *state, dg_game_event_parsed *event);
+typedef void (*func_dg_game_event_list)(parser_state *state, dg_game_event_list *list);
+typedef void (*func_dg_user_message)(parser_state *state, dg_user_message_parsed *message);
+typedef void (*func_dg_temp_entities_parsed)(parser_state *state,
+                                             dg_svc_temp_entities_parsed *message);
+typedef bool (*func_dg_temp_entity_filter)(parser_state *state, const dg_serverclass *serverclass);
+typedef void (*func_dg_changed_props)(parser_state *state, const dg_changed_props *changes);
 typedef struct dg_settings dg_settings;
+struct dg_datatable_registry;
+struct dg_string_pool;
+struct dg_shared_datatables;
 
 enum dg_alloc_type { dg_alloc_temp, dg_alloc_permanent };
 typedef enum dg_alloc_type dg_alloc_type;
 
 // The settings struct contains all the callbacks for application code
 struct dg_settings {
+  func_dg_changed_props changed_props_handler; // Called after each svc_packetentities, stores props
   func_dg_consolecmd consolecmd_handler;
   func_dg_customdata customdata_handler;
   func_dg_datatables datatables_handler;
@@ -71,6 +82,8 @@ struct dg_settings {
   func_dg_packetentities_parsed packetentities_parsed_handler;
   func_dg_demover demo_version_handler;
   func_dg_estate_init flattened_props_handler; // Called after parsing prop flattening stuff
+  func_dg_game_event game_event_handler; // Only called for events that are subscribed
+  func_dg_game_event_list game_event_list_handler; // Unsubscribe from events here
   func_dg_header header_handler;
   func_dg_packet packet_handler;
   func_dg_packet_parsed packet_parsed_handler;
@@ -78,21 +91,44 @@ struct dg_settings {
   func_dg_stop stop_handler;
   func_dg_stringtables stringtables_handler;
   func_dg_stringtables_parsed stringtables_parsed_handler;
+  func_dg_temp_entities_parsed temp_entities_parsed_handler;
+  func_dg_temp_entity_filter temp_entity_filter; // Return false for classes that should be skipped
   func_dg_usercmd usercmd_handler;
+  func_dg_user_message user_message_handler; // Only called for types that have a decoder
   dg_parser_funcs funcs;
   dg_alloc_state temp_alloc_state;
   dg_alloc_state permanent_alloc_state;
   dg_alloc_type packet_alloc_type;
+  struct dg_datatable_registry *datatable_registry; // Optional, shares flattened datatables
+  struct dg_string_pool *string_pool; // Optional, interns datatable strings across demos
+  uint32_t user_message_mask; // Bitmask of (1 << dg_user_message_type) to decode, 0 decodes all
+  uint32_t history_ticks; // Keep prop changes of this many ticks, see dg_estate_history_create
   bool parse_packetentities;
+  bool build_prop_lookup; // Build name lookups for the flattened props, see dg_estate_find_prop
+  bool store_props; // Keep the props of every entity in the entity state, baselines included
   void *client_state;
 };
 
+// Keeps memory warm across successive parses so that batch processing many small demos doesn't
+// pay for setting up and tearing down the arenas and hashtables every time
+struct dg_parser_context {
+  dg_arena permanent_arena;
+  dg_arena temp_arena;
+  entity_parse_scrap scrap;
+};
+
+typedef struct dg_parser_context dg_parser_context;
+
 struct dg_parser {
   parser_state state;
+  dg_parser_context *context; // NULL if parsing without a context
   dg_settings m_settings;
   dg_parser_funcs _parser_funcs;
   dg_filereader m_reader;
   dg_demver_data demo_version;
+  dg_game_event_list game_events;
+  bool *temp_entity_classes; // Result of temp_entity_filter per datatable id
+  const struct dg_shared_datatables *shared_datatables; // Acquired from the datatable registry
   const char *error_message;
   bool error;
   bool parse_netmessages;
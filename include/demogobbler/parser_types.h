@@ -6,6 +6,8 @@ extern "C" {
 
 #include "demogobbler/bitstream.h"
 #include "demogobbler/floats.h"
+#include "demogobbler/gameevent_types.h"
+#include "demogobbler/usermessage_types.h"
 #include "stringtable_types.h"
 
 // clang-format off
@@ -221,6 +223,7 @@ struct dg_svc_user_message {
   uint8_t msg_type; // type of the user message
   uint32_t length;  // specifies the length for the void* buffer in bits
   dg_bitstream data;
+  dg_user_message_parsed *parsed; // NULL if not decoded
 };
 
 struct dg_svc_entity_message {
@@ -233,6 +236,7 @@ struct dg_svc_entity_message {
 struct dg_svc_game_event {
   uint32_t length;
   dg_bitstream data;
+  dg_game_event_parsed *parsed; // NULL if not decoded
 };
 
 struct dg_svc_packet_entities {
@@ -254,6 +258,7 @@ struct dg_svc_splitscreen {
 struct dg_svc_temp_entities {
   uint8_t num_entries;
   dg_bitstream data;
+  struct dg_svc_temp_entities_parsed *parsed; // NULL if not decoded
 };
 
 struct dg_svc_prefetch {
@@ -265,22 +270,11 @@ struct dg_svc_menu {
   dg_bitstream data;
 };
 
-struct dg_game_event_descriptor_key {
-  const char *key_value;
-  uint32_t type;
-};
-
-struct dg_game_event_descriptor {
-  uint32_t event_id;
-  const char *name;
-  size_t key_count;
-  struct dg_game_event_descriptor_key *keys;
-};
-
 struct dg_svc_game_event_list {
   uint32_t events;
   uint32_t length;
-  dg_bitstream data; // Add game event descriptor array here later on
+  dg_bitstream data;
+  const dg_game_event_list *parsed; // NULL if not decoded
 };
 
 struct dg_svc_get_cvar_value {
@@ -366,6 +360,9 @@ struct dg_demver_data {
   unsigned int svc_update_stringtable_table_id_bits : 4;
   net_message_type *netmessage_array;
   unsigned int netmessage_count;
+  int8_t netmessage_ids[svc_invalid + 1]; // Index in netmessage_array, -1 if not on this protocol
+  dg_user_message_type *user_message_array;
+  unsigned int user_message_count;
   unsigned int network_protocol;
   unsigned int l4d2_version;
 };
@@ -378,6 +375,7 @@ struct packet_parsed {
   uint32_t message_count;
   dg_bitstream leftover_bits;
   struct dg_packet orig;
+  bool modified; // Set when the messages are changed, see freddie's passthrough_unmodified
 };
 
 typedef struct packet_parsed packet_parsed;
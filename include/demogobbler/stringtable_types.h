@@ -56,6 +56,14 @@ struct dg_instancebaseline_args {
 };
 
 typedef struct dg_instancebaseline_args dg_instancebaseline_args;
+
+struct dg_baseline_cache_args {
+  struct estate* estate_ptr;
+  const struct dg_demver_data* demver_data;
+  struct dg_alloc_state* permanent_allocator; // The cache keeps pointers into this
+};
+
+typedef struct dg_baseline_cache_args dg_baseline_cache_args;
 struct dg_alloc_state;
 struct dg_demver_data;
 
@@ -120,6 +128,18 @@ struct dg_packetentities_parse_args {
 
 typedef struct dg_packetentities_parse_args dg_packetentities_parse_args;
 
+struct dg_temp_entities_parse_args {
+  struct dg_svc_temp_entities *message;
+  struct dg_alloc_state *allocator;
+  const struct dg_demver_data* demver_data;
+  struct estate* entity_state;
+  struct dg_svc_temp_entities_parsed* output;
+  struct dg_alloc_state* permanent_allocator;
+  const bool *class_filter; // Indexed by datatable id, NULL decodes all classes
+};
+
+typedef struct dg_temp_entities_parse_args dg_temp_entities_parse_args;
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,123 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "demogobbler/allocator.h"
+#include "demogobbler/bitstream.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// User messages that have a decoder, the wire id of each type depends on the game
+// clang-format off
+#define DEMOGOBBLER_MACRO_ALL_USER_MESSAGES(macro) \
+  macro(um_geiger) \
+  macro(um_train) \
+  macro(um_hudtext) \
+  macro(um_saytext) \
+  macro(um_saytext2) \
+  macro(um_textmsg) \
+  macro(um_resethud) \
+  macro(um_shake) \
+  macro(um_fade) \
+  macro(um_rumble)
+// clang-format on
+
+#define DEMOGOBBLER_DECLARE_ENUMS(x) x,
+
+enum dg_user_message_type {
+  DEMOGOBBLER_MACRO_ALL_USER_MESSAGES(DEMOGOBBLER_DECLARE_ENUMS) um_invalid
+};
+typedef enum dg_user_message_type dg_user_message_type;
+
+#undef DEMOGOBBLER_DECLARE_ENUMS
+
+struct dg_um_geiger {
+  uint8_t range;
+};
+
+struct dg_um_train {
+  uint8_t pos;
+};
+
+struct dg_um_hudtext {
+  const char *text;
+};
+
+struct dg_um_saytext {
+  uint8_t client;
+  bool chat;
+  const char *text;
+};
+
+struct dg_um_saytext2 {
+  uint8_t client;
+  bool chat;
+  const char *msg_name;
+  const char *params[4]; // NULL if not present
+};
+
+struct dg_um_textmsg {
+  uint8_t dest;
+  const char *msg_name;
+  const char *params[4]; // NULL if not present
+};
+
+struct dg_um_resethud {
+  uint8_t unk;
+};
+
+struct dg_um_shake {
+  uint8_t command;
+  float amplitude;
+  float frequency;
+  float duration;
+};
+
+struct dg_um_fade {
+  uint16_t duration;
+  uint16_t hold_time;
+  uint16_t flags;
+  uint8_t r, g, b, a;
+};
+
+struct dg_um_rumble {
+  uint8_t index;
+  uint8_t data;
+  uint8_t flags;
+};
+
+#define DECLARE_USER_MESSAGE_IN_UNION(message) struct dg_##message message_##message
+
+struct dg_user_message_parsed {
+  dg_user_message_type type;
+
+  union {
+    DECLARE_USER_MESSAGE_IN_UNION(um_geiger);
+    DECLARE_USER_MESSAGE_IN_UNION(um_train);
+    DECLARE_USER_MESSAGE_IN_UNION(um_hudtext);
+    DECLARE_USER_MESSAGE_IN_UNION(um_saytext);
+    DECLARE_USER_MESSAGE_IN_UNION(um_saytext2);
+    DECLARE_USER_MESSAGE_IN_UNION(um_textmsg);
+    DECLARE_USER_MESSAGE_IN_UNION(um_resethud);
+    DECLARE_USER_MESSAGE_IN_UNION(um_shake);
+    DECLARE_USER_MESSAGE_IN_UNION(um_fade);
+    DECLARE_USER_MESSAGE_IN_UNION(um_rumble);
+  };
+};
+
+typedef struct dg_user_message_parsed dg_user_message_parsed;
+
+struct dg_demver_data;
+
+typedef struct {
+  dg_alloc_state *allocator; // Strings are allocated from here
+  const struct dg_demver_data *version_data;
+  uint8_t msg_type; // Wire id of the message
+  dg_bitstream stream;
+} dg_user_message_parse_args;
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,7 +1,9 @@
 #pragma once
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define MIN(X, Y) (((X) < (Y)) ? (X) : (Y))
 #define MAX(X, Y) (((X) > (Y)) ? (X) : (Y))
@@ -35,6 +37,11 @@ static inline size_t alignment_loss(size_t bytes_allocated, size_t alignment) {
   }
 }
 
+// Names are interned, demos parsed with the same string pool can be compared by pointer
+static inline bool dt_name_equal(const char *name1, const char *name2) {
+  return name1 == name2 || strcmp(name1, name2) == 0;
+}
+
 unsigned dg_bits_required(unsigned i);
 unsigned int highest_bit_index(unsigned int number);
 int Q_log2(int val);
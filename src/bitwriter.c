@@ -3,18 +3,16 @@
 #include "demogobbler/utils.h"
 #include <string.h>
 
-#ifdef _MSC_VER
-#define NO_ASAN
-#else
-#define NO_ASAN __attribute__((no_sanitize("address")))
-#endif
+// Writes go through unaligned 64-bit loads and stores, the buffer has this much slack at the end so
+// they never go out of bounds
+#define BITWRITER_PADDING_BYTES 8
 
 void dg_bitwriter_init(dg_bitwriter *thisptr, uint32_t initial_size_bits) {
   memset(thisptr, 0, sizeof(*thisptr));
   uint32_t bytes = initial_size_bits / 8;
   if((initial_size_bits & 0x7) != 0)
     ++bytes;
-  thisptr->ptr = malloc(bytes);
+  thisptr->ptr = malloc(bytes + BITWRITER_PADDING_BYTES);
   thisptr->bitoffset = 0;
   thisptr->bitsize = bytes * 8;
 }
@@ -72,69 +70,66 @@ int64_t dg_bitwriter_get_available_bits(dg_bitwriter *thisptr) {
   }
 }
 
-static void bitwriter_allocate_space_if_needed(dg_bitwriter *thisptr, unsigned int bits_wanted) {
+static void bitwriter_grow(dg_bitwriter *thisptr, uint32_t bits_wanted) {
+  uint32_t bytes = (thisptr->bitoffset + bits_wanted) / 8;
+  uint32_t current_bytes = thisptr->bitsize / 8;
+  if ((thisptr->bitoffset + bits_wanted) % 8 != 0)
+    ++bytes;
+  bytes = MAX(current_bytes * 2, bytes);
+  thisptr->ptr = realloc(thisptr->ptr, bytes + BITWRITER_PADDING_BYTES);
+  thisptr->bitsize = bytes * 8;
+}
+
+static inline void bitwriter_allocate_space_if_needed(dg_bitwriter *thisptr, uint32_t bits_wanted) {
   if (dg_bitwriter_get_available_bits(thisptr) < bits_wanted) {
-    uint32_t bytes = (thisptr->bitsize + bits_wanted) / 8;
-    uint32_t current_bytes = thisptr->bitsize / 8;
-    if(bits_wanted % 8 != 0)
-      ++bytes;
-    bytes = MAX(current_bytes * 2, bytes);
-    thisptr->ptr = realloc(thisptr->ptr, bytes);
-    thisptr->bitsize = bytes * 8;
+    bitwriter_grow(thisptr, bits_wanted);
   }
 }
 
-#define CHECK_SIZE() bitwriter_allocate_space_if_needed(thisptr, bits)
+void dg_bitwriter_reserve(dg_bitwriter *thisptr, uint32_t bits) {
+  bitwriter_allocate_space_if_needed(thisptr, bits);
+}
 
-void NO_ASAN dg_bitwriter_write_bit(dg_bitwriter *thisptr, bool value) {
-  bitwriter_allocate_space_if_needed(thisptr, 1);
-  uint8_t MASKS[] = {0x1, 0x2, 0x4, 0x8, 0x10, 0x20, 0x40, 0x80};
-  int index = thisptr->bitoffset & 0x7;
+// Writes up to 57 bits with a single load and store of the 64-bit word the write starts in. Bits
+// after the written ones are cleared, which is fine since nothing has been written there yet.
+static inline void bitwriter_put(dg_bitwriter *thisptr, uint64_t value, unsigned int bits) {
   uint8_t *dest = thisptr->ptr + thisptr->bitoffset / 8;
+  unsigned int shift = thisptr->bitoffset & 0x7;
+  uint64_t word;
+  memcpy(&word, dest, sizeof(word));
+  word &= (1ULL << shift) - 1;
+  word |= (value & ((1ULL << bits) - 1)) << shift;
+  memcpy(dest, &word, sizeof(word));
+  thisptr->bitoffset += bits;
+}
 
-  // If value does not match then flip the bit
-  *dest &= ~(MASKS[index]);
-  if(value)
-    *dest |= MASKS[index];
-
-  thisptr->bitoffset += 1;
+void dg_bitwriter_write_bit(dg_bitwriter *thisptr, bool value) {
+  bitwriter_allocate_space_if_needed(thisptr, 1);
+  bitwriter_put(thisptr, value, 1);
 #ifdef GROUND_TRUTH_CHECK
   ground_truth_check(thisptr, 1);
 #endif
 }
 
-void NO_ASAN dg_bitwriter_write_bits(dg_bitwriter *thisptr, const void *_src, unsigned int bits) {
-  CHECK_SIZE();
-  unsigned int src_offset = 0;
+void dg_bitwriter_write_bits(dg_bitwriter *thisptr, const void *_src, unsigned int bits) {
+  bitwriter_allocate_space_if_needed(thisptr, bits);
+  const uint8_t *src = _src;
 #ifdef GROUND_TRUTH_CHECK
   unsigned int requested_bits = bits;
 #endif
-  while (bits > 0) {
-    int dest_byte_offset = thisptr->bitoffset & 0x7;
-    int src_byte_offset = src_offset & 0x7;
-    int bits_written = MIN(8 - dest_byte_offset, 8 - src_byte_offset);
-    bits_written = MIN(bits, bits_written);
-    const uint8_t *src = (uint8_t *)_src + src_offset / 8;
-    uint8_t *dest = thisptr->ptr + thisptr->bitoffset / 8;
-
-    // Get rid of the extra bits at the end of the destination value
-    uint8_t cur_value = 0;
-    if(dest_byte_offset != 0) {
-      cur_value = *dest << (8 - dest_byte_offset);
-      cur_value >>= (8 - dest_byte_offset);
-    }
+  // 7 bytes at a time keeps the source byte aligned and fits in a single put
+  while (bits >= 56) {
+    uint64_t value = 0;
+    memcpy(&value, src, 7);
+    bitwriter_put(thisptr, value, 56);
+    src += 7;
+    bits -= 56;
+  }
 
-    uint8_t src_value = *src;
-    src_value >>= src_byte_offset;
-    src_value <<= (8 - bits_written);
-    src_value >>= (8 - bits_written);
-    src_value <<= dest_byte_offset;
-    uint8_t output = cur_value | src_value;
-
-    *dest = output;
-    bits -= bits_written;
-    src_offset += bits_written;
-    thisptr->bitoffset += bits_written;
+  if (bits > 0) {
+    uint64_t value = 0;
+    memcpy(&value, src, (bits + 7) / 8);
+    bitwriter_put(thisptr, value, bits);
   }
 
 #ifdef GROUND_TRUTH_CHECK
@@ -225,7 +220,16 @@ void dg_bitwriter_write_sint32(dg_bitwriter *thisptr, int32_t value) {
 }
 
 void dg_bitwriter_write_uint(dg_bitwriter *thisptr, uint64_t value, unsigned int bits) {
-  dg_bitwriter_write_bits(thisptr, &value, bits);
+  bitwriter_allocate_space_if_needed(thisptr, bits);
+  if (bits > 32) {
+    bitwriter_put(thisptr, value, 32);
+    bitwriter_put(thisptr, value >> 32, bits - 32);
+  } else if (bits > 0) {
+    bitwriter_put(thisptr, value, bits);
+  }
+#ifdef GROUND_TRUTH_CHECK
+  ground_truth_check(thisptr, bits);
+#endif
 }
 
 void dg_bitwriter_write_uint32(dg_bitwriter *thisptr, uint32_t value) {
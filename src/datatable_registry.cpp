@@ -0,0 +1,188 @@
+#include "demogobbler/datatable_registry.h"
+#include "demogobbler.h"
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <vector>
+#define XXH_INLINE_ALL
+#include "xxhash.h"
+
+namespace {
+struct registry_entry {
+  dg_shared_datatables shared;
+  dg_arena arena; // Owns everything the shared datatables point to
+  void *raw;      // Copy of the datatables block, used to confirm hash matches
+  size_t raw_bytes;
+  unsigned int game;
+  unsigned int demo_protocol;
+  unsigned int network_protocol;
+  size_t refcount;
+};
+
+void free_entry(registry_entry *entry) {
+  dg_arena_free(&entry->arena);
+  delete entry;
+}
+
+bool entry_matches(const registry_entry *entry, const dg_demver_data *version_data,
+                   const dg_datatables *message, uint64_t hash) {
+  return entry->shared.hash == hash && entry->raw_bytes == (size_t)message->size_bytes &&
+         entry->game == version_data->game &&
+         entry->demo_protocol == version_data->demo_protocol &&
+         entry->network_protocol == version_data->network_protocol &&
+         memcmp(entry->raw, message->data, message->size_bytes) == 0;
+}
+
+registry_entry *create_entry(const dg_demver_data *version_data, const dg_datatables *message,
+                             uint64_t hash, const char **error_message) {
+  registry_entry *entry = new registry_entry();
+  entry->arena = dg_arena_create(1 << 17);
+  dg_alloc_state allocator = dg_arena_create_allocator(&entry->arena);
+
+  entry->raw_bytes = message->size_bytes;
+  entry->raw = dg_alloc_allocate(&allocator, message->size_bytes, 1);
+  memcpy(entry->raw, message->data, message->size_bytes);
+  entry->game = version_data->game;
+  entry->demo_protocol = version_data->demo_protocol;
+  entry->network_protocol = version_data->network_protocol;
+  entry->shared.hash = hash;
+
+  // Parse from the copy so that the raw buffer in the parsed datatables stays valid
+  dg_datatables copy = *message;
+  copy.data = entry->raw;
+  dg_demver_data version_copy = *version_data;
+  dg_datatables_parsed_rval parsed = dg_parse_datatables(&version_copy, &allocator, &copy);
+
+  if (parsed.error) {
+    *error_message = parsed.error_message;
+    free_entry(entry);
+    return nullptr;
+  }
+
+  entry->shared.datatables = parsed.output;
+
+  estate scratch;
+  memset(&scratch, 0, sizeof(scratch));
+  estate_init_args args;
+  args.version_data = version_data;
+  args.message = &entry->shared.datatables;
+  args.allocator = &allocator;
+  args.flatten_datatables = true;
+  args.should_store_props = false;
+  // Shared entries are immutable, so the lookups have to exist up front
+  args.build_prop_lookup = true;
+  dg_parse_result result = dg_estate_init(&scratch, args);
+  entry->shared.class_datas = scratch.class_datas;
+  dg_estate_free(&scratch);
+
+  if (result.error) {
+    *error_message = result.error_message;
+    free_entry(entry);
+    return nullptr;
+  }
+
+  return entry;
+}
+} // namespace
+
+struct dg_datatable_registry {
+  std::mutex mutex;
+  std::vector<registry_entry *> entries;
+};
+
+// Must be called with the mutex held
+static registry_entry *find_entry(dg_datatable_registry *registry,
+                                  const dg_demver_data *version_data, const dg_datatables *message,
+                                  uint64_t hash) {
+  for (auto entry : registry->entries) {
+    if (entry_matches(entry, version_data, message, hash)) {
+      return entry;
+    }
+  }
+
+  return nullptr;
+}
+
+dg_datatable_registry *dg_datatable_registry_create(void) { return new dg_datatable_registry(); }
+
+void dg_datatable_registry_free(dg_datatable_registry *registry) {
+  for (auto entry : registry->entries) {
+    free_entry(entry);
+  }
+  delete registry;
+}
+
+const dg_shared_datatables *dg_datatable_registry_acquire(dg_datatable_registry *registry,
+                                                          const dg_demver_data *version_data,
+                                                          const dg_datatables *message,
+                                                          const char **error_message) {
+  const uint64_t hash = XXH64(message->data, message->size_bytes, 0);
+  {
+    std::lock_guard<std::mutex> lock(registry->mutex);
+    registry_entry *entry = find_entry(registry, version_data, message, hash);
+    if (entry) {
+      ++entry->refcount;
+      return &entry->shared;
+    }
+  }
+
+  // Flattening happens outside the lock so that other parsers are not held up by it. Parsers
+  // racing on the same build all flatten it and the first one to publish wins.
+  registry_entry *created = create_entry(version_data, message, hash, error_message);
+  if (created == nullptr) {
+    return nullptr;
+  }
+
+  registry_entry *output;
+  {
+    std::lock_guard<std::mutex> lock(registry->mutex);
+    output = find_entry(registry, version_data, message, hash);
+    if (output) {
+      ++output->refcount;
+    } else {
+      output = created;
+      output->refcount = 1;
+      registry->entries.push_back(output);
+    }
+  }
+
+  if (output != created) {
+    free_entry(created);
+  }
+
+  return &output->shared;
+}
+
+void dg_datatable_registry_release(dg_datatable_registry *registry,
+                                   const dg_shared_datatables *shared) {
+  std::lock_guard<std::mutex> lock(registry->mutex);
+  for (auto entry : registry->entries) {
+    if (&entry->shared == shared) {
+      --entry->refcount;
+      break;
+    }
+  }
+}
+
+size_t dg_datatable_registry_trim(dg_datatable_registry *registry) {
+  std::lock_guard<std::mutex> lock(registry->mutex);
+  size_t freed = 0;
+
+  for (size_t i = 0; i < registry->entries.size();) {
+    registry_entry *entry = registry->entries[i];
+    if (entry->refcount == 0) {
+      free_entry(entry);
+      registry->entries.erase(registry->entries.begin() + i);
+      ++freed;
+    } else {
+      ++i;
+    }
+  }
+
+  return freed;
+}
+
+size_t dg_datatable_registry_count(dg_datatable_registry *registry) {
+  std::lock_guard<std::mutex> lock(registry->mutex);
+  return registry->entries.size();
+}
@@ -1,50 +1,19 @@
 #include "demogobbler/freddie.hpp"
 #include "demogobbler/streams.h"
+#include <algorithm>
+#include <condition_variable>
 #include <cstdint>
 #include <cstring>
 #include <iostream>
+#include <list>
+#include <mutex>
+#include <thread>
 
-using namespace freddie;
-
-typedef void *(*func_dg_alloc)(void *allocator, uint32_t size, uint32_t alignment);
-typedef void *(*func_dg_realloc)(void *allocator, void *ptr, uint32_t prev_size, uint32_t size,
-                                 uint32_t alignment);
-typedef void (*func_dg_clear)(void *allocator);
-typedef void (*func_dg_free)(void *allocator);
-typedef void (*func_dg_attach)(void *allocator, void *ptr, uint32_t size);
-
-static void *mallocator_allocate(void *alloc, uint32_t size, uint32_t alignment) {
-  mallocator *arena = (mallocator *)alloc;
-  void *ptr = malloc(size);
-  arena->pointers.push_back(ptr);
-  return ptr;
-}
-
-static void *mallocator_reallocate(void *allocator, void *ptr, uint32_t prev_size, uint32_t size,
-                                   uint32_t alignment) {
-  mallocator *arena = (mallocator *)allocator;
-  for (size_t i = 0; i < arena->pointers.size(); ++i) {
-    if (ptr == arena->pointers[i]) {
-      return arena->pointers[i] = realloc(ptr, size);
-    }
-  }
-
-  void *rval = malloc(size);
-  arena->pointers.push_back(rval);
-  return rval;
-}
-
-static void mallocator_clear(void *allocator) {
-  mallocator *arena = (mallocator *)allocator;
-  for (auto ptr : arena->pointers)
-    ::free(ptr);
-  arena->pointers.clear();
+extern "C" {
+#include "parser_netmessages.h"
 }
 
-static void mallocator_attach(void *allocator, void *ptr, uint32_t size) {
-  mallocator *arena = (mallocator *)allocator;
-  arena->pointers.push_back(ptr);
-}
+using namespace freddie;
 
 mallocator::mallocator() {}
 
@@ -73,7 +42,36 @@ demo_t::demo_t() {
   arena = dg_arena_create(INITIAL_ARENA_SIZE);
 }
 
-demo_t::~demo_t() { dg_arena_free(&arena); }
+namespace freddie {
+  // Decodes packets of lazily loaded demos with a parser that only ever sees single packets
+  struct lazy_decoder {
+    struct entry {
+      size_t index;
+      dg_arena arena; // Reused once the entry drops out of the cache
+      packet_parsed parsed;
+    };
+
+    dg_parser parser;
+    std::list<entry> entries; // Most recently used first
+    std::unordered_map<size_t, std::list<entry>::iterator> lookup;
+    size_t cache_size;
+    uint32_t stringtables_count;
+    bool warmed_up = false;
+    bool decoded = false; // Set by the handler, errors on negative ticks don't reach the caller
+    packet_parsed *output = nullptr;
+
+    ~lazy_decoder() {
+      for (auto &entry : entries) {
+        dg_arena_free(&entry.arena);
+      }
+    }
+  };
+} // namespace freddie
+
+demo_t::~demo_t() {
+  decoder.reset();
+  dg_arena_free(&arena);
+}
 
 static void handle_header(parser_state *_state, struct dg_header *header) {
   demo_t *state = (demo_t *)_state->client_state;
@@ -88,8 +86,8 @@ static void handle_version(parser_state *_state, dg_demver_data data) {
 #define HANDLE_PACKET(type)                                                                        \
   static void handle_##type(parser_state *_state, type *packet) {                                  \
     demo_t *state = (demo_t *)_state->client_state;                                                \
-    auto copy = state->copy_packet(packet);                                                        \
-    state->packets.push_back(copy);                                                                \
+    state->packets.emplace_back(*packet);                                                          \
+    state->index_packet(state->packets.size() - 1);                                                \
   }
 
 HANDLE_PACKET(dg_consolecmd);
@@ -141,7 +139,388 @@ dg_parse_result demo_t::parse_demo(demo_t *output, const char *filepath) {
   return result;
 }
 
-dg_parse_result demo_t::write_demo(void *stream, dg_output_interface interface, bool expect_equal) {
+static void handle_dg_packet(parser_state *_state, dg_packet *packet) {
+  demo_t *state = (demo_t *)_state->client_state;
+  state->packets.emplace_back(*packet);
+  state->index_packet(state->packets.size() - 1);
+}
+
+static void handle_decoded_packet(parser_state *_state, packet_parsed *packet) {
+  lazy_decoder *decoder = (lazy_decoder *)_state->client_state;
+  *decoder->output = *packet;
+  decoder->decoded = true;
+}
+
+dg_parse_result demo_t::parse_demo_lazy(demo_t *output, void *stream, dg_input_interface interface,
+                                        size_t cache_size) {
+  dg_settings settings;
+  dg_settings_init(&settings);
+  settings.permanent_alloc_state.allocator = &output->arena;
+  settings.permanent_alloc_state.clear = noop;
+  settings.client_state = output;
+  settings.header_handler = handle_header;
+  settings.demo_version_handler = handle_version;
+  settings.consolecmd_handler = handle_dg_consolecmd;
+  settings.customdata_handler = handle_dg_customdata;
+  settings.datatables_parsed_handler = handle_dg_datatables_parsed;
+  settings.stringtables_parsed_handler = handle_dg_stringtables_parsed;
+  settings.packet_handler = handle_dg_packet;
+  settings.stop_handler = handle_dg_stop;
+  settings.synctick_handler = handle_dg_synctick;
+  settings.usercmd_handler = handle_dg_usercmd;
+  settings.packet_alloc_type = dg_alloc_permanent;
+
+  dg_parse_result result = dg_parse(&settings, stream, interface);
+  if (!result.error) {
+    output->decoder = std::make_unique<lazy_decoder>();
+    lazy_decoder *decoder = output->decoder.get();
+    decoder->cache_size = std::max<size_t>(cache_size, 1);
+
+    dg_settings decoder_settings;
+    dg_settings_init(&decoder_settings);
+    decoder_settings.client_state = decoder;
+    decoder_settings.packet_parsed_handler = handle_decoded_packet;
+    dg_parser_init(&decoder->parser, &decoder_settings);
+    decoder->parser.demo_version = output->demver_data;
+    decoder->parser.parse_netmessages = true;
+  }
+
+  return result;
+}
+
+dg_parse_result demo_t::parse_demo_lazy(demo_t *output, const char *filepath, size_t cache_size) {
+  FILE *file = fopen(filepath, "rb");
+  dg_parse_result result;
+
+  if (file == nullptr) {
+    result.error = true;
+    result.error_message = "unable to open file";
+  } else {
+    result = parse_demo_lazy(output, file, {dg_fstream_read, dg_fstream_seek}, cache_size);
+    fclose(file);
+  }
+
+  return result;
+}
+
+static bool decode_packet(lazy_decoder *decoder, dg_packet *raw, dg_arena *arena,
+                          packet_parsed *output) {
+  dg_parser *parser = &decoder->parser;
+  parser->m_settings.temp_alloc_state = dg_arena_create_allocator(arena);
+  parser->m_settings.permanent_alloc_state = dg_arena_create_allocator(arena);
+  parser->error = false;
+  parser->error_message = nullptr;
+  decoder->output = output;
+  decoder->decoded = false;
+  parse_netmessages(parser, raw);
+
+  return decoder->decoded;
+}
+
+// Stringtable updates need the tables created during signon, the tables don't change afterwards
+static void warm_up(demo_t *demo) {
+  lazy_decoder *decoder = demo->decoder.get();
+  dg_arena scratch = dg_arena_create(1 << 16);
+  packet_parsed parsed;
+
+  for (auto &packet : demo->packets) {
+    dg_packet *raw = std::get_if<dg_packet>(&packet);
+    if (raw && raw->preamble.converted_type == dg_type_signon) {
+      decode_packet(decoder, raw, &scratch, &parsed);
+      dg_arena_clear(&scratch);
+    }
+  }
+
+  dg_arena_free(&scratch);
+  decoder->stringtables_count = decoder->parser.state.stringtables_count;
+  decoder->warmed_up = true;
+}
+
+packet_parsed *demo_t::get_packet(size_t index) {
+  if (index >= packets.size()) {
+    return nullptr;
+  }
+
+  dg_packet *raw = std::get_if<dg_packet>(&packets[index]);
+  if (raw == nullptr || !decoder) {
+    return std::get_if<packet_parsed>(&packets[index]);
+  }
+
+  auto it = decoder->lookup.find(index);
+  if (it != decoder->lookup.end()) {
+    decoder->entries.splice(decoder->entries.begin(), decoder->entries, it->second);
+    return &it->second->parsed;
+  }
+
+  if (!decoder->warmed_up) {
+    warm_up(this);
+  }
+
+  if (decoder->entries.size() >= decoder->cache_size) {
+    auto &oldest = decoder->entries.back();
+    decoder->lookup.erase(oldest.index);
+    dg_arena_clear(&oldest.arena);
+    decoder->entries.splice(decoder->entries.begin(), decoder->entries,
+                            std::prev(decoder->entries.end()));
+  } else {
+    lazy_decoder::entry entry;
+    entry.arena = dg_arena_create(1 << 16);
+    decoder->entries.push_front(entry);
+  }
+
+  auto &entry = decoder->entries.front();
+  entry.index = index;
+  bool decoded = decode_packet(decoder.get(), raw, &entry.arena, &entry.parsed);
+  // Signon packets would otherwise add their stringtables again
+  decoder->parser.state.stringtables_count = decoder->stringtables_count;
+
+  if (!decoded) {
+    dg_arena_clear(&entry.arena);
+    decoder->entries.splice(decoder->entries.end(), decoder->entries, decoder->entries.begin());
+    decoder->entries.back().index = SIZE_MAX;
+    return nullptr;
+  }
+
+  decoder->lookup[index] = decoder->entries.begin();
+  return &entry.parsed;
+}
+
+static int32_t get_tick(const packet_variant_t &packet, int32_t previous) {
+  return std::visit(
+      [previous](auto &&message) -> int32_t {
+        using T = std::decay_t<decltype(message)>;
+        if constexpr (std::is_same_v<T, dg_stop>) {
+          return previous;
+        } else if constexpr (std::is_same_v<T, packet_parsed> ||
+                             std::is_same_v<T, dg_datatables_parsed> ||
+                             std::is_same_v<T, dg_stringtables_parsed>) {
+          return message.orig.preamble.tick;
+        } else {
+          return message.preamble.tick;
+        }
+      },
+      packet);
+}
+
+void demo_t::index_packet(size_t index) {
+  const packet_variant_t &packet = packets[index];
+  type_index[packet.index()].push_back(index);
+
+  int32_t tick = get_tick(packet, tick_runs.empty() ? 0 : tick_runs.back().tick);
+  if (!tick_runs.empty() && tick_runs.back().tick == tick && tick_runs.back().packets.last == index) {
+    tick_runs.back().packets.last = index + 1;
+  } else {
+    if (!tick_runs.empty() && tick < tick_runs.back().tick) {
+      ticks_sorted = false;
+    }
+    tick_runs.push_back({tick, {index, index + 1}});
+  }
+
+  const packet_parsed *parsed = std::get_if<packet_parsed>(&packet);
+  if (parsed) {
+    for (size_t i = 0; i < parsed->message_count; ++i) {
+      netmessage_index[parsed->messages[i].mtype].push_back({index, i});
+    }
+  }
+}
+
+void demo_t::rebuild_indices() {
+  tick_runs.clear();
+  ticks_sorted = true;
+  for (auto &index : type_index) {
+    index.clear();
+  }
+  for (auto &index : netmessage_index) {
+    index.clear();
+  }
+
+  for (size_t i = 0; i < packets.size(); ++i) {
+    index_packet(i);
+  }
+}
+
+packet_range demo_t::get_tick_range(int32_t tick) const {
+  if (ticks_sorted) {
+    auto it = std::lower_bound(tick_runs.begin(), tick_runs.end(), tick,
+                               [](const tick_run &run, int32_t tick) { return run.tick < tick; });
+    if (it != tick_runs.end() && it->tick == tick) {
+      return it->packets;
+    }
+  } else {
+    for (auto &run : tick_runs) {
+      if (run.tick == tick) {
+        return run.packets;
+      }
+    }
+  }
+
+  return {0, 0};
+}
+
+packet_net_message *demo_t::get_netmessage(message_location location) {
+  packet_parsed *parsed = std::get_if<packet_parsed>(&packets[location.packet_index]);
+  return parsed ? parsed->messages + location.message_index : nullptr;
+}
+
+namespace {
+// With passthrough, unmodified packets are copied from the original data
+bool needs_encoding(const packet_parsed *packet, bool passthrough) {
+  return !passthrough || packet->modified;
+}
+
+// Returns false if the message could not be written
+bool write_message(dg_writer *writer, packet_variant_t *packet, bool passthrough) {
+  packet_parsed *packet_ptr = std::get_if<packet_parsed>(packet);
+  dg_datatables_parsed *dt_ptr = std::get_if<dg_datatables_parsed>(packet);
+  dg_stringtables_parsed *st_ptr = std::get_if<dg_stringtables_parsed>(packet);
+  dg_consolecmd *cmd_ptr = std::get_if<dg_consolecmd>(packet);
+  dg_usercmd *user_ptr = std::get_if<dg_usercmd>(packet);
+  dg_stop *stop_ptr = std::get_if<dg_stop>(packet);
+  dg_synctick *sync_ptr = std::get_if<dg_synctick>(packet);
+  dg_customdata *custom_ptr = std::get_if<dg_customdata>(packet);
+  dg_packet *raw_ptr = std::get_if<dg_packet>(packet);
+
+  if (packet_ptr && !needs_encoding(packet_ptr, passthrough)) {
+    dg_write_packet(writer, &packet_ptr->orig);
+  } else if (packet_ptr) {
+    dg_write_packet_parsed(writer, packet_ptr);
+  } else if (dt_ptr) {
+    dg_write_datatables_parsed(writer, dt_ptr);
+  } else if (st_ptr) {
+    dg_write_stringtables_parsed(writer, st_ptr);
+  } else if (cmd_ptr) {
+    dg_write_consolecmd(writer, cmd_ptr);
+  } else if (user_ptr) {
+    dg_write_usercmd(writer, user_ptr);
+  } else if (stop_ptr) {
+    dg_write_stop(writer, stop_ptr);
+  } else if (sync_ptr) {
+    dg_write_synctick(writer, sync_ptr);
+  } else if (custom_ptr) {
+    dg_write_customdata(writer, custom_ptr);
+  } else if (raw_ptr) {
+    dg_write_packet(writer, raw_ptr);
+  } else {
+    return false;
+  }
+
+  return true;
+}
+
+// Encodes the parsed packets of a demo on worker threads. Each slot holds the bitwriter of one
+// packet, workers stay at most a window of slots ahead of the committer writing them out.
+struct packet_encoder {
+  struct slot {
+    dg_bitwriter bitwriter;
+    bool done = false;
+  };
+
+  std::vector<packet_parsed *> jobs; // In demo order
+  std::vector<slot> slots;
+  dg_demver_data version;
+  bool expect_equal;
+  size_t next_job = 0;
+  size_t committed = 0;
+  bool stopped = false;
+  std::mutex mutex;
+  std::condition_variable job_available;
+  std::condition_variable job_done;
+  std::vector<std::thread> threads;
+
+  packet_encoder(demo_t *demo, bool expect_equal, bool passthrough, unsigned thread_count)
+      : version(demo->demver_data), expect_equal(expect_equal) {
+    // Not taken from the type index, the committer has to see the same packets even if the
+    // indices are out of date
+    for (auto &packet : demo->packets) {
+      auto *parsed = std::get_if<packet_parsed>(&packet);
+      if (parsed && needs_encoding(parsed, passthrough)) {
+        jobs.push_back(parsed);
+      }
+    }
+
+    slots.resize(std::min<size_t>(jobs.size(), thread_count * 16));
+    for (auto &slot : slots) {
+      dg_bitwriter_init(&slot.bitwriter, 1 << 16);
+    }
+
+    for (unsigned i = 0; i < thread_count; ++i) {
+      threads.emplace_back(&packet_encoder::work, this);
+    }
+  }
+
+  ~packet_encoder() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopped = true;
+    }
+    job_available.notify_all();
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    for (auto &slot : slots) {
+      dg_bitwriter_free(&slot.bitwriter);
+    }
+  }
+
+  void work() {
+    dg_demver_data thread_version = version;
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true) {
+      job_available.wait(lock, [this] {
+        return stopped || next_job >= jobs.size() || next_job < committed + slots.size();
+      });
+      if (stopped || next_job >= jobs.size()) {
+        return;
+      }
+
+      size_t job = next_job++;
+      lock.unlock();
+
+      packet_parsed *packet = jobs[job];
+      dg_bitwriter *bitwriter = &slots[job % slots.size()].bitwriter;
+      bitwriter->bitoffset = 0;
+      bitwriter->error = false;
+      dg_bitwriter_reserve(bitwriter, packet->orig.size_bytes * 8);
+#ifdef GROUND_TRUTH_CHECK
+      if (expect_equal) {
+        bitwriter->truth_data = packet->orig.data;
+        bitwriter->truth_data_offset = 0;
+        bitwriter->truth_size_bits = packet->orig.size_bytes * 8;
+      }
+#endif
+      dg_bitwriter_write_packet_data(bitwriter, &thread_version, packet);
+#ifdef GROUND_TRUTH_CHECK
+      bitwriter->truth_data = NULL;
+#endif
+
+      lock.lock();
+      slots[job % slots.size()].done = true;
+      job_done.notify_all();
+    }
+  }
+
+  // Blocks until the next packet in demo order has been encoded
+  dg_bitwriter *wait_next() {
+    std::unique_lock<std::mutex> lock(mutex);
+    slot *next = &slots[committed % slots.size()];
+    job_done.wait(lock, [next] { return next->done; });
+    return &next->bitwriter;
+  }
+
+  void commit() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      slots[committed % slots.size()].done = false;
+      ++committed;
+    }
+    job_available.notify_all();
+  }
+};
+} // namespace
+
+dg_parse_result demo_t::write_demo(void *stream, dg_output_interface interface, bool expect_equal,
+                                   unsigned thread_count) {
   dg_parse_result result;
   std::memset(&result, 0, sizeof(result));
   dg_writer writer;
@@ -151,34 +530,34 @@ dg_parse_result demo_t::write_demo(void *stream, dg_output_interface interface,
   dg_writer_open(&writer, stream, interface);
   dg_write_header(&writer, &header);
 
+  if (thread_count == 0) {
+    thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+
+  // The encoder itself is being checked with expect_equal, so nothing is passed through
+  const bool passthrough = passthrough_unmodified && !expect_equal;
+  std::unique_ptr<packet_encoder> encoder;
+  if (thread_count > 1) {
+    encoder = std::make_unique<packet_encoder>(this, expect_equal, passthrough, thread_count);
+  }
+
   for (size_t i = 0; i < packets.size(); ++i) {
-    auto *packet = &packets[i]->packet;
+    auto *packet = &packets[i];
     packet_parsed *packet_ptr = std::get_if<packet_parsed>(packet);
-    dg_datatables_parsed *dt_ptr = std::get_if<dg_datatables_parsed>(packet);
-    dg_stringtables_parsed *st_ptr = std::get_if<dg_stringtables_parsed>(packet);
-    dg_consolecmd *cmd_ptr = std::get_if<dg_consolecmd>(packet);
-    dg_usercmd *user_ptr = std::get_if<dg_usercmd>(packet);
-    dg_stop *stop_ptr = std::get_if<dg_stop>(packet);
-    dg_synctick *sync_ptr = std::get_if<dg_synctick>(packet);
-    dg_customdata *custom_ptr = std::get_if<dg_customdata>(packet);
-
-    if (packet_ptr) {
-      dg_write_packet_parsed(&writer, packet_ptr);
-    } else if (dt_ptr) {
-      dg_write_datatables_parsed(&writer, dt_ptr);
-    } else if (st_ptr) {
-      dg_write_stringtables_parsed(&writer, st_ptr);
-    } else if (cmd_ptr) {
-      dg_write_consolecmd(&writer, cmd_ptr);
-    } else if (user_ptr) {
-      dg_write_usercmd(&writer, user_ptr);
-    } else if (stop_ptr) {
-      dg_write_stop(&writer, stop_ptr);
-    } else if (sync_ptr) {
-      dg_write_synctick(&writer, sync_ptr);
-    } else if (custom_ptr) {
-      dg_write_customdata(&writer, custom_ptr);
-    } else {
+
+    if (packet_ptr && encoder && needs_encoding(packet_ptr, passthrough)) {
+      dg_bitwriter *bitwriter = encoder->wait_next();
+      if (bitwriter->error) {
+        result.error = true;
+        result.error_message = bitwriter->error_message;
+        break;
+      }
+      dg_packet encoded = packet_ptr->orig;
+      encoded.data = bitwriter->ptr;
+      encoded.size_bytes = bitwriter->bitoffset / 8;
+      dg_write_packet(&writer, &encoded);
+      encoder->commit();
+    } else if (!write_message(&writer, packet, passthrough)) {
       result.error = true;
       result.error_message = "unknown demo packet";
       break;
@@ -190,7 +569,7 @@ dg_parse_result demo_t::write_demo(void *stream, dg_output_interface interface,
   return result;
 }
 
-dg_parse_result demo_t::write_demo(const char *filepath) {
+dg_parse_result demo_t::write_demo(const char *filepath, unsigned thread_count) {
   FILE *file = fopen(filepath, "wb");
   dg_parse_result result;
 
@@ -198,41 +577,34 @@ dg_parse_result demo_t::write_demo(const char *filepath) {
     result.error = true;
     result.error_message = "unable to open file";
   } else {
-    result = write_demo(file, {dg_fstream_write});
+    result = write_demo(file, {dg_fstream_write}, false, thread_count);
     fclose(file);
   }
 
   return result;
 }
 
-dg_datatables_parsed* demo_t::get_datatables() const {
-  for (size_t i = 0; i < packets.size(); ++i) {
-    auto *packet = &packets[i]->packet;
-    dg_datatables_parsed *dt_ptr = std::get_if<dg_datatables_parsed>(packet);
-    if (dt_ptr) {
-      return dt_ptr;
-    }
+dg_datatables_parsed* demo_t::get_datatables() {
+  auto &datatables = get_packets_of_type<dg_datatables_parsed>();
+  if (datatables.empty()) {
+    return nullptr;
   }
-  return nullptr;
+
+  return std::get_if<dg_datatables_parsed>(&packets[datatables.front()]);
 }
 
 static void fix_svc_serverinfo(const char *gamedir, demo_t *demo) {
-  for (size_t i = 0; i < demo->packets.size(); ++i) {
-    packet_parsed *ptr = std::get_if<packet_parsed>(&demo->packets[i]->packet);
-    if (ptr) {
-      for (size_t msg_index = 0; msg_index < ptr->message_count; ++msg_index) {
-        packet_net_message *msg = ptr->messages + msg_index;
-        if (msg->mtype == svc_serverinfo) {
-          size_t len = strlen(gamedir);
-          char *dest = (char *)dg_arena_allocate(&demo->arena, len + 1, 1);
-          memcpy(dest, gamedir, len + 1);
-          msg->message_svc_serverinfo->game_dir = dest;
-          msg->message_svc_serverinfo->network_protocol = demo->header.net_protocol;
-          return;
-        }
-      }
-    }
+  auto &serverinfos = demo->get_netmessages(svc_serverinfo);
+  if (serverinfos.empty()) {
+    return;
   }
+
+  packet_net_message *msg = demo->get_netmessage(serverinfos.front());
+  size_t len = strlen(gamedir);
+  char *dest = (char *)dg_arena_allocate(&demo->arena, len + 1, 1);
+  memcpy(dest, gamedir, len + 1);
+  msg->message_svc_serverinfo->game_dir = dest;
+  msg->message_svc_serverinfo->network_protocol = demo->header.net_protocol;
 }
 
 dg_bitstream freddie::get_start_state(const dg_bitwriter *writer) {
@@ -248,37 +620,32 @@ void freddie::finalize_stream(dg_bitstream *stream, const dg_bitwriter *writer)
   stream->data = writer->ptr;
 }
 
+// Points the message data to the bitwriter, which has to outlive the message
+static void rewrite_packetentities(dg_svc_packet_entities *message, const dg_demver_data *version,
+                                   dg_bitwriter *bitwriter) {
+  write_packetentities_args args;
+  memset(&args, 0, sizeof(args));
+  args.is_delta = message->is_delta;
+  args.version = version;
+  args.data = &message->parsed->data;
+  auto stream = freddie::get_start_state(bitwriter);
+  dg_bitwriter_write_packetentities(bitwriter, args);
+  freddie::finalize_stream(&stream, bitwriter);
+  message->data = stream;
+}
+
 static void fix_packets(demo_t *demo) {
-  for (size_t i = 0; i < demo->packets.size(); ++i) {
-    auto *packet = &demo->packets[i]->packet;
-    packet_parsed *ptr = std::get_if<packet_parsed>(packet);
-
-    if (ptr) {
-      for (size_t msg_index = 0; msg_index < ptr->message_count; ++msg_index) {
-        packet_net_message *msg = ptr->messages + msg_index;
-
-        if (msg->mtype == svc_packet_entities) {
-          write_packetentities_args args;
-          memset(&args, 0, sizeof(args));
-          args.is_delta = msg->message_svc_packet_entities.is_delta;
-          args.version = &demo->demver_data;
-          args.data = &msg->message_svc_packet_entities.parsed->data;
-          uint32_t bits = dg_bitstream_bits_left(&msg->message_svc_packet_entities.data);
-          dg_bitwriter bitwriter;
-          dg_bitwriter_init(&bitwriter, bits);
-          auto stream = freddie::get_start_state(&bitwriter);
-          dg_bitwriter_write_packetentities(&bitwriter, args);
-          freddie::finalize_stream(&stream, &bitwriter);
-          demo->packets[i]->memory.attach(
-              bitwriter.ptr); // transfer the bitwriter memory over to the packet
-          msg->message_svc_packet_entities.data = stream;
-        }
-      }
-    }
+  for (auto location : demo->get_netmessages(svc_packet_entities)) {
+    packet_net_message *msg = demo->get_netmessage(location);
+    uint32_t bits = dg_bitstream_bits_left(&msg->message_svc_packet_entities.data);
+    dg_bitwriter bitwriter;
+    dg_bitwriter_init(&bitwriter, bits);
+    rewrite_packetentities(&msg->message_svc_packet_entities, &demo->demver_data, &bitwriter);
+    demo->memory.attach(bitwriter.ptr); // transfer the bitwriter memory over to the demo
   }
 }
 
-dg_parse_result freddie::convert_demo(const demo_t *example, demo_t *demo) {
+dg_parse_result freddie::convert_demo(demo_t *example, demo_t *demo) {
   dg_parse_result result;
   memset(&result, 0, sizeof(result));
 
@@ -298,9 +665,336 @@ dg_parse_result freddie::convert_demo(const demo_t *example, demo_t *demo) {
 
   fix_packets(demo);
 
+  // Message encodings depend on the demo version, so everything has to be rewritten
+  for (auto index : demo->get_packets_of_type<packet_parsed>()) {
+    std::get_if<packet_parsed>(&demo->packets[index])->modified = true;
+  }
+
+  return result;
+}
+
+namespace {
+// Passes messages from the parser through the transforms to the writer. Everything the parser
+// doesn't keep around is allocated from the message arena, which is cleared once the message has
+// been written.
+struct demo_streamer {
+  const stream_settings *settings;
+  dg_writer writer;
+  dg_arena message_arena;
+  dg_alloc_state message_allocator;
+  std::vector<packet_variant_t> held; // In demo order
+  bool holding;
+  dg_demver_data version;
+  dg_parse_result result;
+  bool header_handled = false;
+
+  demo_streamer(const stream_settings *settings) : settings(settings) {
+    dg_writer_init(&writer);
+    message_arena = dg_arena_create(1 << 17);
+    message_allocator = dg_arena_create_allocator(&message_arena);
+    holding = settings->hold_until_datatables;
+    memset(&version, 0, sizeof(version));
+    memset(&result, 0, sizeof(result));
+  }
+
+  ~demo_streamer() { dg_arena_free(&message_arena); }
+
+  void transform(packet_variant_t *message) {
+    for (size_t i = 0; i < settings->transforms.size() && !result.error; ++i) {
+      result = settings->transforms[i](message, &message_allocator);
+    }
+  }
+
+  void write(packet_variant_t *message) {
+    if (!result.error && !write_message(&writer, message, settings->passthrough_unmodified)) {
+      result.error = true;
+      result.error_message = "unknown demo packet";
+    }
+  }
+
+  void release_held() {
+    for (auto &message : held) {
+      transform(&message);
+      write(&message);
+    }
+    held.clear();
+    holding = false;
+  }
+
+  // The parser keeps going after errors, the remaining messages are dropped
+  void handle(packet_variant_t message) {
+    if (result.error) {
+      return;
+    }
+
+    if (holding && !std::holds_alternative<dg_datatables_parsed>(message)) {
+      held.push_back(message);
+      return;
+    }
+
+    // The datatables go through the transforms before the messages held back in front of them
+    transform(&message);
+    if (holding) {
+      release_held();
+    }
+    write(&message);
+    dg_arena_clear(&message_arena);
+  }
+};
+} // namespace
+
+static void stream_version(parser_state *_state, dg_demver_data data) {
+  demo_streamer *streamer = (demo_streamer *)_state->client_state;
+  if (!streamer->header_handled) {
+    streamer->version = data;
+  } else if (!streamer->result.error) {
+    // Without a version_func the output only follows the input if the header was left alone
+    if (streamer->settings->version_func) {
+      streamer->result = streamer->settings->version_func(&data);
+      streamer->writer.version = data;
+    } else if (!streamer->settings->header_func) {
+      streamer->writer.version = data;
+    }
+  }
+}
+
+static void stream_header(parser_state *_state, struct dg_header *header) {
+  demo_streamer *streamer = (demo_streamer *)_state->client_state;
+  dg_header output = *header;
+  if (streamer->settings->header_func) {
+    streamer->result = streamer->settings->header_func(&output, &streamer->version);
+  }
+
+  if (!streamer->result.error) {
+    streamer->writer.version = streamer->version;
+    dg_write_header(&streamer->writer, &output);
+  }
+  streamer->header_handled = true;
+}
+
+#define STREAM_PACKET(type)                                                                        \
+  static void stream_##type(parser_state *_state, type *packet) {                                  \
+    demo_streamer *streamer = (demo_streamer *)_state->client_state;                               \
+    streamer->handle(*packet);                                                                     \
+  }
+
+STREAM_PACKET(dg_consolecmd);
+STREAM_PACKET(dg_customdata);
+STREAM_PACKET(dg_datatables_parsed);
+STREAM_PACKET(dg_stop);
+STREAM_PACKET(dg_stringtables_parsed);
+STREAM_PACKET(dg_synctick);
+STREAM_PACKET(dg_usercmd);
+STREAM_PACKET(packet_parsed);
+
+dg_parse_result freddie::transform_demo(void *input, dg_input_interface input_interface,
+                                        void *output, dg_output_interface output_interface,
+                                        const stream_settings &settings) {
+  demo_streamer streamer(&settings);
+  dg_writer_open(&streamer.writer, output, output_interface);
+
+  dg_settings parser_settings;
+  dg_settings_init(&parser_settings);
+  // The streamer clears the temp allocator itself, held messages have to stay around
+  parser_settings.temp_alloc_state = streamer.message_allocator;
+  parser_settings.temp_alloc_state.clear = noop;
+  parser_settings.client_state = &streamer;
+  parser_settings.header_handler = stream_header;
+  parser_settings.demo_version_handler = stream_version;
+  parser_settings.consolecmd_handler = stream_dg_consolecmd;
+  parser_settings.customdata_handler = stream_dg_customdata;
+  parser_settings.datatables_parsed_handler = stream_dg_datatables_parsed;
+  parser_settings.stringtables_parsed_handler = stream_dg_stringtables_parsed;
+  parser_settings.packet_parsed_handler = stream_packet_parsed;
+  parser_settings.stop_handler = stream_dg_stop;
+  parser_settings.synctick_handler = stream_dg_synctick;
+  parser_settings.usercmd_handler = stream_dg_usercmd;
+  parser_settings.parse_packetentities = settings.parse_packetentities;
+
+  dg_parse_result result = dg_parse(&parser_settings, input, input_interface);
+  if (streamer.holding) {
+    streamer.release_held();
+  }
+  dg_writer_close(&streamer.writer);
+
+  if (streamer.result.error) {
+    result = streamer.result;
+  } else if (!result.error && streamer.writer.error) {
+    result.error = true;
+    result.error_message = streamer.writer.error_message;
+  }
+
   return result;
 }
 
+dg_parse_result freddie::transform_demo(const char *input_path, const char *output_path,
+                                        const stream_settings &settings) {
+  dg_parse_result result;
+  memset(&result, 0, sizeof(result));
+  FILE *input = fopen(input_path, "rb");
+  FILE *output = input ? fopen(output_path, "wb") : nullptr;
+
+  if (input == nullptr || output == nullptr) {
+    result.error = true;
+    result.error_message = "unable to open file";
+  } else {
+    result = transform_demo(input, {dg_fstream_read, dg_fstream_seek}, output, {dg_fstream_write},
+                            settings);
+  }
+
+  if (input) {
+    fclose(input);
+  }
+  if (output) {
+    fclose(output);
+  }
+
+  return result;
+}
+
+namespace {
+// Converts the messages of a streamed demo as they come in, same as what convert_demo does for a
+// whole demo
+struct stream_converter {
+  demo_t *example;
+  dg_arena arena; // Holds the conversion info
+  std::unique_ptr<datatable_change_info> info;
+  dg_demver_data input_version;
+  // Packet entities can't come before the datatables, so they are never held back and the same
+  // buffer can be used for every packet
+  dg_bitwriter entities_writer;
+  bool initialized = false;
+
+  stream_converter(demo_t *example) : example(example) {
+    memset(&input_version, 0, sizeof(input_version));
+    arena = dg_arena_create(1 << 20);
+    info = std::make_unique<datatable_change_info>(dg_arena_create_allocator(&arena));
+    dg_bitwriter_init(&entities_writer, 1 << 16);
+  }
+
+  ~stream_converter() {
+    info.reset();
+    dg_bitwriter_free(&entities_writer);
+    dg_arena_free(&arena);
+  }
+
+  dg_parse_result convert_header(dg_header *header, dg_demver_data *version) {
+    dg_parse_result result;
+    memset(&result, 0, sizeof(result));
+    input_version = *version;
+    *version = example->demver_data;
+    header->net_protocol = example->header.net_protocol;
+    header->demo_protocol = example->header.demo_protocol;
+    memcpy(header->game_directory, example->header.game_directory, 260);
+
+    return result;
+  }
+
+  dg_parse_result convert_version(dg_demver_data *version) {
+    dg_parse_result result;
+    memset(&result, 0, sizeof(result));
+    input_version = *version;
+    *version = example->demver_data;
+
+    return result;
+  }
+
+  dg_parse_result convert_packet(packet_parsed *packet, dg_alloc_state *allocator) {
+    dg_parse_result result;
+    memset(&result, 0, sizeof(result));
+    info->message_allocator = *allocator;
+
+    for (size_t i = 0; i < packet->message_count; ++i) {
+      packet_net_message *msg = packet->messages + i;
+      if (msg->mtype == svc_serverinfo) {
+        size_t len = strlen(example->header.game_directory);
+        char *dest = (char *)dg_alloc_allocate(allocator, len + 1, 1);
+        memcpy(dest, example->header.game_directory, len + 1);
+        msg->message_svc_serverinfo->game_dir = dest;
+        msg->message_svc_serverinfo->network_protocol = example->header.net_protocol;
+      }
+    }
+
+    result = info->convert_packet(packet);
+
+    for (size_t i = 0; i < packet->message_count && !result.error; ++i) {
+      packet_net_message *msg = packet->messages + i;
+      if (msg->mtype == svc_packet_entities) {
+        entities_writer.bitoffset = 0;
+        rewrite_packetentities(&msg->message_svc_packet_entities, &example->demver_data,
+                               &entities_writer);
+        if (entities_writer.error) {
+          result.error = true;
+          result.error_message = entities_writer.error_message;
+        }
+      }
+    }
+
+    // Message encodings depend on the demo version, so everything has to be rewritten
+    packet->modified = true;
+
+    return result;
+  }
+
+  dg_parse_result convert(packet_variant_t *message, dg_alloc_state *allocator) {
+    dg_parse_result result;
+    memset(&result, 0, sizeof(result));
+    dg_datatables_parsed *dt_ptr = std::get_if<dg_datatables_parsed>(message);
+    packet_parsed *packet_ptr = std::get_if<packet_parsed>(message);
+
+    if (dt_ptr) {
+      if (!initialized) {
+        result = info->init(dt_ptr, &input_version, example->get_datatables(),
+                            &example->demver_data);
+        initialized = !result.error;
+      }
+      if (initialized) {
+        *message = info->target_datatable;
+      }
+    } else if (packet_ptr && !initialized) {
+      result.error = true;
+      result.error_message = "missing datatable";
+    } else if (packet_ptr) {
+      result = convert_packet(packet_ptr, allocator);
+    }
+
+    return result;
+  }
+};
+} // namespace
+
+static stream_settings get_conversion_settings(stream_converter *converter) {
+  stream_settings settings;
+  settings.header_func = [converter](dg_header *header, dg_demver_data *version) {
+    return converter->convert_header(header, version);
+  };
+  settings.version_func = [converter](dg_demver_data *version) {
+    return converter->convert_version(version);
+  };
+  settings.transforms.push_back([converter](packet_variant_t *message, dg_alloc_state *allocator) {
+    return converter->convert(message, allocator);
+  });
+  // Instance baselines are created during signon, which can come before the datatables
+  settings.hold_until_datatables = true;
+  settings.parse_packetentities = true;
+
+  return settings;
+}
+
+dg_parse_result freddie::convert_demo(demo_t *example, void *input,
+                                      dg_input_interface input_interface, void *output,
+                                      dg_output_interface output_interface) {
+  stream_converter converter(example);
+  return transform_demo(input, input_interface, output, output_interface,
+                        get_conversion_settings(&converter));
+}
+
+dg_parse_result freddie::convert_demo(demo_t *example, const char *input_path,
+                                      const char *output_path) {
+  stream_converter converter(example);
+  return transform_demo(input_path, output_path, get_conversion_settings(&converter));
+}
+
 void *memory_stream::get_ptr() {
   std::uint8_t *ptr = (std::uint8_t *)this->buffer;
   return ptr + this->offset;
@@ -1,18 +1,21 @@
 #include "demogobbler/freddie.hpp"
+#include "demogobbler/utils.h"
 #include <algorithm>
 #include <cstdio>
 #include <set>
 #include <string.h>
+#include <string_view>
+#include <unordered_map>
 
 using namespace freddie;
 
-prop_status datatable_change_info::get_prop_status(dg_sendprop *prop) {
-  auto it = this->prop_map.find(prop);
+prop_status datatable_change_info::get_prop_status(uint32_t datatable_id, uint32_t prop_index) {
   prop_status status;
-  if (it == this->prop_map.end()) {
+  if (datatable_id + 1 >= this->prop_offsets.size() ||
+      prop_index >= this->prop_offsets[datatable_id + 1] - this->prop_offsets[datatable_id]) {
     status.exists = false;
   } else {
-    status = it->second;
+    status = this->props[this->prop_offsets[datatable_id] + prop_index];
   }
 
   return status;
@@ -37,8 +40,9 @@ void datatable_change_info::add_datatable(uint32_t new_index, bool props_changed
   this->datatables.push_back(status);
 }
 
-void datatable_change_info::add_prop(dg_sendprop *prop, prop_status status) {
-  this->prop_map[prop] = status;
+void datatable_change_info::add_prop(uint32_t datatable_id, uint32_t prop_index,
+                                     prop_status status) {
+  this->props[this->prop_offsets[datatable_id] + prop_index] = status;
 }
 
 void datatable_change_info::print(bool should_print_props) {
@@ -74,8 +78,8 @@ void datatable_change_info::print_props(uint32_t datatable_id) {
   dg_serverclass_data *data = input_estate.class_datas + datatable_id;
   char name[64];
   for (size_t i = 0; i < data->prop_count; ++i) {
-    dg_sendprop *prop = data->props + i;
-    auto status = get_prop_status(prop);
+    dg_sendprop *prop = data->props[i];
+    auto status = get_prop_status(datatable_id, i);
     bool any_changes = status.flags_changed || !status.exists || status.index != i;
 
     if (any_changes) {
@@ -153,24 +157,25 @@ dg_parse_result datatable_change_info::convert_props(dg_ent_update *update,
                                                      uint32_t new_datatable_id) {
   dg_parse_result result;
   memset(&result, 0, sizeof(result));
-  dg_serverclass_data *data = this->input_estate.class_datas + update->datatable_id;
   dg_serverclass_data *target_data = this->target_estate.class_datas + new_datatable_id;
+  const prop_status *statuses = this->props.data() + this->prop_offsets[update->datatable_id];
+  size_t prop_count = this->prop_offsets[update->datatable_id + 1] -
+                      this->prop_offsets[update->datatable_id];
   for (size_t i = 0; i < update->prop_value_array_size; ++i) {
     auto prop_ptr = update->prop_value_array + i;
-    auto sendprop = data->props + prop_ptr->prop_index;
-    auto status = get_prop_status(sendprop);
 
-    if (!status.exists) {
+    if (prop_ptr->prop_index >= prop_count || !statuses[prop_ptr->prop_index].exists) {
       // Mark deleted props as max value
       prop_ptr->prop_index = UINT32_MAX;
       continue;
     }
 
-    auto newprop = target_data->props + status.index;
+    const prop_status &status = statuses[prop_ptr->prop_index];
+    auto newprop = target_data->props[status.index];
     prop_ptr->prop_index = status.index; // remap the index
     // TODO: add conversion logic for props
     if (status.flags_changed) {
-      init_value(newprop, &prop_ptr->value, &this->allocator);
+      init_value(newprop, &prop_ptr->value, &this->message_allocator);
     }
   }
 
@@ -225,25 +230,38 @@ dg_parse_result datatable_change_info::convert_updates(dg_packetentities_data *d
   return result;
 }
 
-static int32_t get_dt(const estate *state, const char *name, int32_t initial_guess) {
+namespace {
+// Props are looked up by table and prop name without building the qualified name
+struct prop_name {
+  std::string_view table;
+  std::string_view name;
+  bool operator==(const prop_name &rhs) const { return table == rhs.table && name == rhs.name; }
+};
+
+struct prop_name_hash {
+  size_t operator()(const prop_name &key) const {
+    return std::hash<std::string_view>()(key.table) * 31 + std::hash<std::string_view>()(key.name);
+  }
+};
+
+typedef std::unordered_map<std::string_view, int32_t> dt_name_map;
+typedef std::unordered_map<prop_name, int, prop_name_hash> prop_name_map;
+} // namespace
+
+static int32_t get_dt(const estate *state, const dt_name_map &lookup, const char *name,
+                      int32_t initial_guess) {
   if ((int32_t)state->serverclass_count > initial_guess &&
-      strcmp(state->class_datas[initial_guess].dt_name, name) == 0) {
+      dt_name_equal(state->class_datas[initial_guess].dt_name, name)) {
     return initial_guess;
   } else {
-    for (int32_t i = 0; i < (int32_t)state->serverclass_count; ++i) {
-      if (strcmp(name, state->class_datas[i].dt_name) == 0) {
-        return i;
-      }
-    }
-    return -1;
+    auto it = lookup.find(name);
+    return it != lookup.end() ? it->second : -1;
   }
 }
 
-static bool prop_equal(const dg_sendprop *prop1, const char *prop_name) {
-  char prop1_name[64];
-  dg_sendprop_name(prop1_name, sizeof(prop1_name), prop1);
-
-  return strcmp(prop1_name, prop_name) == 0;
+static bool prop_equal(const dg_sendprop *prop1, const dg_sendprop *prop2) {
+  return dt_name_equal(prop1->name, prop2->name) &&
+         dt_name_equal(prop1->baseclass->name, prop2->baseclass->name);
 }
 
 static bool prop_attributes_equal(const dg_sendprop *prop1, const dg_sendprop *prop2) {
@@ -277,33 +295,38 @@ static bool prop_attributes_equal(const dg_sendprop *prop1, const dg_sendprop *p
   return equal;
 }
 
-static dg_sendprop *find_prop(const dg_serverclass_data *data, const char *name,
-                              size_t initial_index) {
-  if (initial_index < data->prop_count) {
-    if (prop_equal(data->props + initial_index, name)) {
-      return data->props + initial_index;
-    }
+// Returns the index of the prop or -1 if not found. The lookup is filled on the first miss, most
+// props are found at the same index.
+static int find_prop(const estate *state, uint32_t datatable_id, const dg_sendprop *prop,
+                     size_t initial_index, prop_name_map *lookup) {
+  const dg_serverclass_data *data = state->class_datas + datatable_id;
+  if (initial_index < data->prop_count && prop_equal(data->props[initial_index], prop)) {
+    return initial_index;
   }
 
-  for (size_t i = 0; i < data->prop_count; ++i) {
-    if (prop_equal(data->props + i, name))
-      return data->props + i;
+  if (lookup->empty()) {
+    // Same as dg_estate_find_prop, the first prop with the name wins
+    for (size_t i = 0; i < data->prop_count; ++i) {
+      lookup->emplace(prop_name{data->props[i]->baseclass->name, data->props[i]->name}, i);
+    }
   }
 
-  return nullptr;
+  auto it = lookup->find(prop_name{prop->baseclass->name, prop->name});
+  return it != lookup->end() ? it->second : -1;
 }
 
-static bool compare_sendtable_props(freddie::datatable_change_info *info,
-                                    const dg_serverclass_data *data1,
-                                    const dg_serverclass_data *data2) {
-  char buffer[64];
+static bool compare_sendtable_props(freddie::datatable_change_info *info, uint32_t datatable_id,
+                                    const dg_serverclass_data *data1, const estate *target_state,
+                                    uint32_t target_datatable_id) {
+  const dg_serverclass_data *data2 = target_state->class_datas + target_datatable_id;
+  prop_name_map lookup;
   bool changes = false;
   for (size_t i = 0; i < data1->prop_count; ++i) {
-    dg_sendprop *first_prop = data1->props + i;
-    dg_sendprop_name(buffer, sizeof(buffer), first_prop);
-    dg_sendprop *prop = find_prop(data2, buffer, i);
+    dg_sendprop *first_prop = data1->props[i];
+    int found_index = find_prop(target_state, target_datatable_id, first_prop, i, &lookup);
+    dg_sendprop *prop = found_index != -1 ? data2->props[found_index] : nullptr;
     freddie::prop_status status;
-    size_t index = prop ? prop - data2->props : 0;
+    size_t index = prop ? found_index : 0;
 
     if (!prop) {
       status.flags_changed = true;
@@ -318,7 +341,7 @@ static bool compare_sendtable_props(freddie::datatable_change_info *info,
     }
 
     changes = status.flags_changed || status.index != i || changes;
-    info->add_prop(first_prop, status);
+    info->add_prop(datatable_id, i, status);
   }
 
   return changes;
@@ -326,14 +349,29 @@ static bool compare_sendtable_props(freddie::datatable_change_info *info,
 
 static void compare_sendtables(freddie::datatable_change_info *info, const estate *input_state,
                                const estate *target_state) {
+  dt_name_map lookup;
+  for (int32_t i = 0; i < (int32_t)target_state->serverclass_count; ++i) {
+    lookup.emplace(target_state->class_datas[i].dt_name, i);
+  }
+
+  // Deleted classes keep their props marked as deleted
+  freddie::prop_status deleted;
+  deleted.exists = false;
+  info->prop_offsets.assign(input_state->serverclass_count + 1, 0);
+  for (size_t i = 0; i < input_state->serverclass_count; ++i) {
+    info->prop_offsets[i + 1] = info->prop_offsets[i] + input_state->class_datas[i].prop_count;
+  }
+  info->props.assign(info->prop_offsets.back(), deleted);
+  info->datatables.reserve(input_state->serverclass_count);
+
   for (int32_t i = 0; i < (int32_t)input_state->serverclass_count; ++i) {
     const char *name = input_state->class_datas[i].dt_name;
-    auto dt = get_dt(target_state, name, i);
+    auto dt = get_dt(target_state, lookup, name, i);
     if (dt == -1) {
       info->add_datatable(0, true, false);
     } else {
-      bool changes = compare_sendtable_props(info, input_state->class_datas + i,
-                                             target_state->class_datas + dt);
+      bool changes =
+          compare_sendtable_props(info, i, input_state->class_datas + i, target_state, dt);
       info->add_datatable((uint32_t)dt, changes, true);
     }
   }
@@ -348,7 +386,7 @@ void dg_init_baseline(dg_ent_update *baseline, const dg_serverclass_data *target
   baseline->prop_value_array_size = target_datatable->prop_count;
   baseline->new_way = false;
   for (size_t i = 0; i < target_datatable->prop_count; ++i) {
-    dg_sendprop *prop = target_datatable->props + i;
+    dg_sendprop *prop = target_datatable->props[i];
     prop_value *value = baseline->prop_value_array + i;
     value->prop_index = i;
 
@@ -356,31 +394,40 @@ void dg_init_baseline(dg_ent_update *baseline, const dg_serverclass_data *target
   }
 }
 
+dg_parse_result datatable_change_info::convert_packet(packet_parsed *packet_ptr) {
+  dg_parse_result result;
+  memset(&result, 0, sizeof(result));
+
+  for (size_t msg_index = 0; msg_index < packet_ptr->message_count && !result.error; ++msg_index) {
+    auto *netmsg = packet_ptr->messages + msg_index;
+    if (netmsg->mtype == svc_packet_entities) {
+      result = convert_updates(&netmsg->message_svc_packet_entities.parsed->data);
+      break;
+    } else if(netmsg->mtype == svc_create_stringtable && 
+    strcmp("instancebaseline", netmsg->message_svc_create_stringtable.name) == 0) {
+      auto msg = &netmsg->message_svc_create_stringtable;
+      result = convert_instancebaselines(&msg->stringtable, &msg->data);
+    } else if (netmsg->mtype == svc_update_stringtable && 
+    netmsg->message_svc_update_stringtable.table_id == 5) {
+      auto msg = &netmsg->message_svc_update_stringtable;
+      result = convert_instancebaselines(&msg->parsed_sentry, &msg->data);
+    }
+  }
+
+  return result;
+}
+
 dg_parse_result datatable_change_info::convert_demo(freddie::demo_t *input) {
   dg_parse_result result;
   memset(&result, 0, sizeof(result));
 
   for (size_t i = 0; i < input->packets.size() && !result.error; ++i) {
-    packet_parsed *packet_ptr = std::get_if<packet_parsed>(&input->packets[i]->packet);
-    dg_datatables_parsed *dt_ptr = std::get_if<dg_datatables_parsed>(&input->packets[i]->packet);
+    packet_parsed *packet_ptr = std::get_if<packet_parsed>(&input->packets[i]);
+    dg_datatables_parsed *dt_ptr = std::get_if<dg_datatables_parsed>(&input->packets[i]);
     if (packet_ptr) {
-      for (size_t msg_index = 0; msg_index < packet_ptr->message_count; ++msg_index) {
-        auto *netmsg = packet_ptr->messages + msg_index;
-        if (netmsg->mtype == svc_packet_entities) {
-          result = convert_updates(&netmsg->message_svc_packet_entities.parsed->data);
-          break;
-        } else if(netmsg->mtype == svc_create_stringtable && 
-        strcmp("instancebaseline", netmsg->message_svc_create_stringtable.name) == 0) {
-          auto msg = &netmsg->message_svc_create_stringtable;
-          result = convert_instancebaselines(&msg->stringtable, &msg->data);
-        } else if (netmsg->mtype == svc_update_stringtable && 
-        netmsg->message_svc_update_stringtable.table_id == 5) {
-          auto msg = &netmsg->message_svc_update_stringtable;
-          result = convert_instancebaselines(&msg->parsed_sentry, &msg->data);
-        }
-      }
+      result = convert_packet(packet_ptr);
     } else if (dt_ptr) {
-      input->packets[i]->packet = this->target_datatable;
+      input->packets[i] = this->target_datatable;
     }
   }
 
@@ -389,6 +436,7 @@ dg_parse_result datatable_change_info::convert_demo(freddie::demo_t *input) {
 
 datatable_change_info::datatable_change_info(dg_alloc_state allocator) {
   this->allocator = allocator;
+  this->message_allocator = allocator;
   memset(&input_estate, 0, sizeof(input_estate));
   memset(&target_estate, 0, sizeof(target_estate));
   baselines = NULL;
@@ -401,11 +449,17 @@ datatable_change_info::~datatable_change_info() {
   dg_estate_free(&target_estate);
 }
 
-dg_parse_result datatable_change_info::init(freddie::demo_t *input, const freddie::demo_t *target) {
+dg_parse_result datatable_change_info::init(freddie::demo_t *input, freddie::demo_t *target) {
+  return init(input->get_datatables(), &input->demver_data, target->get_datatables(),
+              &target->demver_data);
+}
+
+dg_parse_result datatable_change_info::init(dg_datatables_parsed *datatable1,
+                                            const dg_demver_data *input_version,
+                                            dg_datatables_parsed *datatable2,
+                                            const dg_demver_data *target_version) {
   dg_parse_result result;
   memset(&result, 0, sizeof(result));
-  dg_datatables_parsed *datatable1 = input->get_datatables();
-  dg_datatables_parsed *datatable2 = target->get_datatables();
 
   if (datatable1 == nullptr) {
     result.error = true;
@@ -424,17 +478,19 @@ dg_parse_result datatable_change_info::init(freddie::demo_t *input, const freddi
   args2.allocator = args1.allocator = &allocator;
   args2.flatten_datatables = args1.flatten_datatables = true;
   args2.should_store_props = args1.should_store_props = false;
+  // Props are matched with the lookups built while comparing the tables
+  args2.build_prop_lookup = args1.build_prop_lookup = false;
   args1.message = datatable1;
-  args1.version_data = &input->demver_data;
+  args1.version_data = input_version;
   args2.message = datatable2;
-  args2.version_data = &target->demver_data;
+  args2.version_data = target_version;
 
   dg_estate_init(&input_estate, args1);
   dg_estate_init(&target_estate, args2);
 
   compare_sendtables(this, &input_estate, &target_estate);
   this->target_datatable = *datatable2; // TODO: memory management outta wazoo
-  this->target_demver = target->demver_data;
+  this->target_demver = *target_version;
 
 end:
   return result;
@@ -442,6 +498,7 @@ end:
 
 struct baseline_conversion_args {
   dg_alloc_state* allocator;
+  dg_alloc_state* permanent_allocator;
   estate* input_estate;
   const dg_demver_data* target_demver;
   dg_sentry_value* value;
@@ -454,7 +511,8 @@ static dg_parse_result convert_baseline(baseline_conversion_args* args, datatabl
   dg_ent_update update;
 
   dg_instancebaseline_args parse_args;
-  parse_args.permanent_allocator = parse_args.allocator = args->allocator;
+  parse_args.allocator = args->allocator;
+  parse_args.permanent_allocator = args->permanent_allocator;
   parse_args.datatable_id = std::atoi(args->value->stored_string);
   parse_args.demver_data = args->target_demver;
   parse_args.estate_ptr = args->input_estate;
@@ -464,7 +522,7 @@ static dg_parse_result convert_baseline(baseline_conversion_args* args, datatabl
   dg_parse_instancebaseline(&parse_args);
 
   auto status = info->get_datatable_status(parse_args.datatable_id);
-  auto data = dg_estate_serverclass_data(&info->target_estate, &info->target_demver, args->allocator, status.index);
+  auto data = dg_estate_serverclass_data(&info->target_estate, &info->target_demver, args->permanent_allocator, status.index);
 
   if(status.index != parse_args.datatable_id) {
     char BUFFER[4];
@@ -497,7 +555,8 @@ dg_parse_result datatable_change_info::convert_instancebaselines(dg_sentry* stri
   }
 
   baseline_conversion_args args;
-  args.allocator = &this->allocator;
+  args.allocator = &this->message_allocator;
+  args.permanent_allocator = &this->allocator;
   args.target_demver = &target_demver;
   args.input_estate = &input_estate;
 
@@ -534,7 +593,7 @@ dg_parse_result datatable_change_info::convert_instancebaselines(dg_sentry* stri
   }
 
   *data = dg_bitstream_create(writer.ptr, writer.bitoffset);
-  dg_alloc_attach(&this->allocator, writer.ptr, writer.bitsize / 8);
+  dg_alloc_attach(&this->message_allocator, writer.ptr, writer.bitsize / 8);
 
   return result;
 }
\ No newline at end of file
@@ -4,78 +4,245 @@
 #include <stdlib.h>
 #include <string.h>
 
-static uint32_t get_hash(const char *str) {
-  // The length here is computed unnecessarily, could grab it when we parse the string
-  return XXH32(str, strlen(str), 0);
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DG_HASHTABLE_SSE2
+#include <emmintrin.h>
+#endif
+
+enum { GROUP_WIDTH = 16, CTRL_EMPTY = 0x80, MIN_CAPACITY = GROUP_WIDTH };
+
+// Control bytes are either CTRL_EMPTY or the low 7 bits of the hash. Nothing is ever erased so
+// there are no tombstones. The first group of control bytes is mirrored after the last slot so
+// that a group can be loaded from any position without wrapping.
+
+static uint32_t h1(uint32_t hash) { return hash >> 7; }
+
+static uint8_t h2(uint32_t hash) { return hash & 0x7F; }
+
+#ifdef DG_HASHTABLE_SSE2
+static uint32_t group_match(const uint8_t *ctrl, uint8_t value) {
+  __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)value)));
+}
+
+static uint32_t group_match_empty(const uint8_t *ctrl) {
+  // Only empty slots have the high bit set
+  return _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)ctrl));
+}
+#else
+static uint32_t group_match(const uint8_t *ctrl, uint8_t value) {
+  uint32_t mask = 0;
+  for (uint32_t i = 0; i < GROUP_WIDTH; ++i) {
+    mask |= (uint32_t)(ctrl[i] == value) << i;
+  }
+  return mask;
+}
+
+static uint32_t group_match_empty(const uint8_t *ctrl) { return group_match(ctrl, CTRL_EMPTY); }
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+static uint32_t lowest_bit(uint32_t mask) {
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return index;
+}
+#else
+static uint32_t lowest_bit(uint32_t mask) { return __builtin_ctz(mask); }
+#endif
+
+static void set_ctrl(dg_hashtable *thisptr, size_t index, uint8_t value) {
+  thisptr->ctrl[index] = value;
+  if (index < GROUP_WIDTH) {
+    thisptr->ctrl[thisptr->max_items + index] = value;
+  }
+}
+
+static void allocate_table(dg_hashtable *thisptr, size_t capacity) {
+  const size_t slot_bytes = capacity * sizeof(dg_hashtable_slot);
+  // Slots and control bytes share an allocation
+  thisptr->arr = malloc(slot_bytes + capacity + GROUP_WIDTH);
+  thisptr->ctrl = (uint8_t *)thisptr->arr + slot_bytes;
+  thisptr->max_items = capacity;
+  thisptr->item_count = 0;
+  memset(thisptr->ctrl, CTRL_EMPTY, capacity + GROUP_WIDTH);
+}
+
+// Finds the first empty slot for this hash, assumes the table is not full
+static size_t find_empty(const dg_hashtable *thisptr, uint32_t hash) {
+  const size_t mask = thisptr->max_items - 1;
+  size_t pos = h1(hash) & mask;
+  size_t step = 0;
+
+  for (;;) {
+    uint32_t empty = group_match_empty(thisptr->ctrl + pos);
+    if (empty) {
+      return (pos + lowest_bit(empty)) & mask;
+    }
+    step += GROUP_WIDTH;
+    pos = (pos + step) & mask;
+  }
+}
+
+static void grow(dg_hashtable *thisptr) {
+  dg_hashtable old = *thisptr;
+  allocate_table(thisptr, old.max_items * 2);
+
+  for (size_t i = 0; i < old.max_items; ++i) {
+    if (old.ctrl[i] != CTRL_EMPTY) {
+      dg_hashtable_slot *slot = old.arr + i;
+      size_t index = find_empty(thisptr, slot->hash);
+      thisptr->arr[index] = *slot;
+      set_ctrl(thisptr, index, h2(slot->hash));
+    }
+  }
+
+  thisptr->item_count = old.item_count;
+  free(old.arr);
+}
+
+uint32_t dg_hashtable_hash(const char *str, size_t length) {
+  return (uint32_t)XXH3_64bits(str, length);
 }
 
 dg_hashtable dg_hashtable_create(size_t max_items) {
   dg_hashtable table;
   memset(&table, 0, sizeof(table));
+  size_t capacity = MIN_CAPACITY;
 
-  table.max_items = 1; // User power of two sizes;
-
-  while (table.max_items - 1 < max_items)
-    table.max_items <<= 1;
+  // Keep the load factor under 7/8
+  while (capacity - capacity / 8 < max_items)
+    capacity <<= 1;
 
-  const size_t array_size_bytes = table.max_items * sizeof(dg_hashtable_entry);
-  table.arr = malloc(array_size_bytes);
-  memset(table.arr, 0, array_size_bytes);
+  allocate_table(&table, capacity);
 
   return table;
 }
 
-dg_hashtable_entry dg_hashtable_get(dg_hashtable *thisptr, const char *str) {
-  uint32_t hash = get_hash(str);
-  size_t i = hash & (thisptr->max_items - 1);
-  while (thisptr->arr[i].str) {
-    if (strcmp(thisptr->arr[i].str, str) == 0) {
-      return thisptr->arr[i];
+// Returns the matching slot or NULL, empty_index is set to the first empty slot in the probe
+// sequence which is where the string would be inserted
+static dg_hashtable_slot *find_slot(const dg_hashtable *thisptr, const char *str, size_t length,
+                                    uint32_t hash, size_t *empty_index) {
+  const size_t mask = thisptr->max_items - 1;
+  const uint8_t tag = h2(hash);
+  size_t pos = h1(hash) & mask;
+  size_t step = 0;
+
+  for (;;) {
+    const uint8_t *group = thisptr->ctrl + pos;
+    uint32_t matches = group_match(group, tag);
+
+    while (matches) {
+      uint32_t bit = lowest_bit(matches);
+      dg_hashtable_slot *slot = thisptr->arr + ((pos + bit) & mask);
+      if (slot->hash == hash && slot->length == length && memcmp(slot->str, str, length) == 0) {
+        return slot;
+      }
+      matches &= matches - 1;
     }
-    i += 1;
-    if (i == thisptr->max_items)
-      i = 0;
+
+    uint32_t empty = group_match_empty(group);
+    if (empty) {
+      *empty_index = (pos + lowest_bit(empty)) & mask;
+      return NULL;
+    }
+
+    step += GROUP_WIDTH;
+    pos = (pos + step) & mask;
+  }
+}
+
+dg_hashtable_entry dg_hashtable_get_hashed(dg_hashtable *thisptr, const char *str, size_t length,
+                                          uint32_t hash) {
+  dg_hashtable_entry out;
+  size_t empty_index;
+  dg_hashtable_slot *slot = find_slot(thisptr, str, length, hash, &empty_index);
+
+  if (slot) {
+    out.str = slot->str;
+    out.value = slot->value;
+  } else {
+    memset(&out, 0, sizeof(out));
   }
 
-  dg_hashtable_entry not_found;
-  memset(&not_found, 0, sizeof(not_found));
-  return not_found;
+  return out;
 }
 
-bool dg_hashtable_insert(dg_hashtable *thisptr, dg_hashtable_entry entry) {
-  if (thisptr->item_count == thisptr->max_items - 1) {
-    return false; // Hash table is not resizable
+dg_hashtable_entry dg_hashtable_get(dg_hashtable *thisptr, const char *str) {
+  size_t length = strlen(str);
+  return dg_hashtable_get_hashed(thisptr, str, length, dg_hashtable_hash(str, length));
+}
+
+bool dg_hashtable_insert_hashed(dg_hashtable *thisptr, dg_hashtable_entry entry, size_t length,
+                                uint32_t hash) {
+  size_t index;
+  if (find_slot(thisptr, entry.str, length, hash, &index)) {
+    return false;
   }
 
-  ++thisptr->item_count;
-  uint32_t hash = get_hash(entry.str);
-  size_t initial_index = hash & (thisptr->max_items - 1);
-  size_t i = initial_index;
-  while (thisptr->arr[i].str) {
-    if (strcmp(thisptr->arr[i].str, entry.str) == 0) {
-      return false;
-    }
-    i += 1;
-    if (i == thisptr->max_items)
-      i = 0;
+  if (thisptr->item_count + 1 > thisptr->max_items - thisptr->max_items / 8) {
+    grow(thisptr);
+    index = find_empty(thisptr, hash);
   }
 
-  thisptr->arr[i] = entry;
+  dg_hashtable_slot *slot = thisptr->arr + index;
+  slot->str = entry.str;
+  slot->value = entry.value;
+  slot->hash = hash;
+  slot->length = length;
+  set_ctrl(thisptr, index, h2(hash));
+  ++thisptr->item_count;
 
   return true;
 }
 
+bool dg_hashtable_insert(dg_hashtable *thisptr, dg_hashtable_entry entry) {
+  size_t length = strlen(entry.str);
+  return dg_hashtable_insert_hashed(thisptr, entry, length, dg_hashtable_hash(entry.str, length));
+}
+
 void dg_hashtable_clear(dg_hashtable *thisptr) {
-  const size_t array_size_bytes = thisptr->max_items * sizeof(dg_hashtable_entry);
   thisptr->item_count = 0;
-  memset(thisptr->arr, 0, array_size_bytes);
+  memset(thisptr->ctrl, CTRL_EMPTY, thisptr->max_items + GROUP_WIDTH);
 }
 
 void dg_hashtable_free(dg_hashtable *thisptr) {
   free(thisptr->arr);
   thisptr->arr = NULL;
+  thisptr->ctrl = NULL;
+}
+
+dg_string_pool dg_string_pool_create(dg_alloc_state *allocator, size_t size_hint) {
+  dg_string_pool pool;
+  pool.table = dg_hashtable_create(size_hint);
+  pool.allocator = allocator;
+  return pool;
 }
 
+const char *dg_string_pool_intern(dg_string_pool *thisptr, const char *str, size_t length,
+                                  uint32_t hash) {
+  size_t index;
+  dg_hashtable_slot *slot = find_slot(&thisptr->table, str, length, hash, &index);
+
+  if (slot) {
+    return slot->str;
+  }
+
+  char *copy = dg_alloc_allocate(thisptr->allocator, length + 1, 1);
+  memcpy(copy, str, length);
+  copy[length] = '\0';
+
+  dg_hashtable_entry entry;
+  entry.str = copy;
+  entry.value = 0;
+  dg_hashtable_insert_hashed(&thisptr->table, entry, length, hash);
+
+  return copy;
+}
+
+void dg_string_pool_free(dg_string_pool *thisptr) { dg_hashtable_free(&thisptr->table); }
+
 dg_pes dg_pes_create(size_t max_items) {
   dg_pes set;
   memset(&set, 0, sizeof(set));
@@ -91,18 +258,21 @@ dg_pes dg_pes_create(size_t max_items) {
   return set;
 }
 
+// Datatable strings are interned when parsing, so the excluded props can be hashed and compared
+// by pointer
+
 static uint32_t get_hash_prop(dg_sendprop *prop) {
   // Only hash the prop name, dt name will likely match
-  return XXH32(prop->name, strlen(prop->name), 0);
+  uint64_t value = (uintptr_t)prop->name;
+  return (uint32_t)((value * 0x9E3779B97F4A7C15ull) >> 32);
 }
 
 static bool match(dg_sendprop *exclude, dg_sendtable *table, dg_sendprop *prop) {
-  return strcmp(exclude->exclude_name, table->name) == 0 && strcmp(exclude->name, prop->name) == 0;
+  return exclude->exclude_name == table->name && exclude->name == prop->name;
 }
 
 static bool match_excludes(dg_sendprop *exclude1, dg_sendprop *exclude2) {
-  return strcmp(exclude1->name, exclude2->name) == 0 &&
-         strcmp(exclude1->dtname, exclude2->dtname) == 0;
+  return exclude1->name == exclude2->name && exclude1->dtname == exclude2->dtname;
 }
 
 bool dg_pes_has(dg_pes *thisptr, dg_sendtable *table, dg_sendprop *prop) {
@@ -1,6 +1,7 @@
 #include "demogobbler/parser.h"
 #include "demogobbler/alignof_wrapper.h"
 #include "demogobbler/allocator.h"
+#include "demogobbler/datatable_registry.h"
 #include "demogobbler/streams.h"
 #include "demogobbler.h"
 #include "demogobbler/filereader.h"
@@ -48,21 +49,19 @@ static void set_allocator_funcs(dg_alloc_state* state)
     state->realloc = (func_dg_realloc)dg_arena_reallocate;
 }
 
-dg_parse_result dg_parse(dg_settings *settings, void *stream, dg_input_interface dg_input_interface) {
-  const uint32_t INITIAL_SIZE = 1 << 17;
-  dg_arena temp_arena = dg_arena_create(INITIAL_SIZE);
-  dg_arena permanent_arena = dg_arena_create(INITIAL_SIZE);
-
+static dg_parse_result parse_with_arenas(dg_parser_context *context, dg_settings *settings,
+                                         void *stream, dg_input_interface dg_input_interface,
+                                         dg_arena *permanent_arena, dg_arena *temp_arena) {
   if(settings->permanent_alloc_state.allocator == NULL)
   {
-    settings->permanent_alloc_state.allocator = &permanent_arena;
+    settings->permanent_alloc_state.allocator = permanent_arena;
   }
 
   set_allocator_funcs(&settings->permanent_alloc_state);
 
   if(settings->temp_alloc_state.allocator == NULL)
   {
-    settings->temp_alloc_state.allocator = &temp_arena;
+    settings->temp_alloc_state.allocator = temp_arena;
   }
 
   set_allocator_funcs(&settings->temp_alloc_state);
@@ -71,17 +70,68 @@ dg_parse_result dg_parse(dg_settings *settings, void *stream, dg_input_interface
   memset(&out, 0, sizeof(out));
   dg_parser dg_parser;
   dg_parser_init(&dg_parser, settings);
+  if (context) {
+    dg_parser.context = context;
+    dg_parser.state.entity_state.scrap = context->scrap;
+    memset(&context->scrap, 0, sizeof(context->scrap));
+  }
   dg_parser_parse(&dg_parser, stream, dg_input_interface);
   out.error = dg_parser.error;
   out.error_message = dg_parser.error_message;
 
+  return out;
+}
+
+dg_parse_result dg_parse(dg_settings *settings, void *stream, dg_input_interface dg_input_interface) {
+  const uint32_t INITIAL_SIZE = 1 << 17;
+  dg_arena temp_arena = dg_arena_create(INITIAL_SIZE);
+  dg_arena permanent_arena = dg_arena_create(INITIAL_SIZE);
+
+  dg_parse_result out =
+      parse_with_arenas(NULL, settings, stream, dg_input_interface, &permanent_arena, &temp_arena);
+
   dg_arena_free(&permanent_arena);
   dg_arena_free(&temp_arena);
 
   return out;
 }
 
-dg_parse_result dg_parse_file(dg_settings *settings, const char *filepath) {
+dg_parser_context dg_parser_context_create(void) {
+  const uint32_t INITIAL_SIZE = 1 << 17;
+  dg_parser_context context;
+  memset(&context, 0, sizeof(context));
+  context.permanent_arena = dg_arena_create(INITIAL_SIZE);
+  context.temp_arena = dg_arena_create(INITIAL_SIZE);
+
+  return context;
+}
+
+void dg_parser_context_reset(dg_parser_context *context) {
+  dg_arena_clear(&context->permanent_arena);
+  dg_arena_clear(&context->temp_arena);
+}
+
+void dg_parser_context_free(dg_parser_context *context) {
+  dg_arena_free(&context->permanent_arena);
+  dg_arena_free(&context->temp_arena);
+  dg_hashtable_free(&context->scrap.dt_hashtable);
+  dg_hashtable_free(&context->scrap.dts_with_excludes);
+  dg_pes_free(&context->scrap.excluded_props);
+  dg_va_free(&context->scrap.flattened_props);
+}
+
+dg_parse_result dg_parse_with_context(dg_parser_context *context, dg_settings *settings,
+                                      void *stream, dg_input_interface dg_input_interface) {
+  // Settings are copied so that they don't keep pointing at the context's arenas afterwards
+  dg_settings copy = *settings;
+  dg_parser_context_reset(context);
+
+  return parse_with_arenas(context, &copy, stream, dg_input_interface, &context->permanent_arena,
+                           &context->temp_arena);
+}
+
+static dg_parse_result parse_file(dg_parser_context *context, dg_settings *settings,
+                                  const char *filepath) {
   dg_parse_result out;
   memset(&out, 0, sizeof(out));
   FILE *file = fopen(filepath, "rb");
@@ -91,7 +141,11 @@ dg_parse_result dg_parse_file(dg_settings *settings, const char *filepath) {
     input.read = dg_fstream_read;
     input.seek = dg_fstream_seek;
 
-    out = dg_parse(settings, file, input);
+    if (context) {
+      out = dg_parse_with_context(context, settings, file, input);
+    } else {
+      out = dg_parse(settings, file, input);
+    }
 
     fclose(file);
   } else {
@@ -102,7 +156,8 @@ dg_parse_result dg_parse_file(dg_settings *settings, const char *filepath) {
   return out;
 }
 
-dg_parse_result dg_parse_buffer(dg_settings *settings, void *buffer, size_t size) {
+static dg_parse_result parse_buffer(dg_parser_context *context, dg_settings *settings,
+                                    void *buffer, size_t size) {
   dg_parse_result out;
   memset(&out, 0, sizeof(out));
 
@@ -113,7 +168,12 @@ dg_parse_result dg_parse_buffer(dg_settings *settings, void *buffer, size_t size
 
     buffer_stream stream;
     dg_buffer_stream_init(&stream, buffer, size);
-    out = dg_parse(settings, &stream, input);
+
+    if (context) {
+      out = dg_parse_with_context(context, settings, &stream, input);
+    } else {
+      out = dg_parse(settings, &stream, input);
+    }
   } else {
     out.error = true;
     out.error_message = "Buffer was NULL";
@@ -122,6 +182,24 @@ dg_parse_result dg_parse_buffer(dg_settings *settings, void *buffer, size_t size
   return out;
 }
 
+dg_parse_result dg_parse_file(dg_settings *settings, const char *filepath) {
+  return parse_file(NULL, settings, filepath);
+}
+
+dg_parse_result dg_parse_buffer(dg_settings *settings, void *buffer, size_t size) {
+  return parse_buffer(NULL, settings, buffer, size);
+}
+
+dg_parse_result dg_parse_file_with_context(dg_parser_context *context, dg_settings *settings,
+                                           const char *filepath) {
+  return parse_file(context, settings, filepath);
+}
+
+dg_parse_result dg_parse_buffer_with_context(dg_parser_context *context, dg_settings *settings,
+                                             void *buffer, size_t size) {
+  return parse_buffer(context, settings, buffer, size);
+}
+
 void dg_settings_init(dg_settings *settings) { memset(settings, 0, sizeof(dg_settings)); }
 
 dg_alloc_state* dg_parser_temp_allocator(dg_parser *thisptr)
@@ -298,7 +376,17 @@ bool _parse_anymessage(dg_parser *thisptr) {
 }
 
 static void parser_free_state(dg_parser *thisptr) {
+  if (thisptr->context) {
+    // Hand the hashtables back to the context so the next parse can reuse them
+    thisptr->context->scrap = thisptr->state.entity_state.scrap;
+    memset(&thisptr->state.entity_state.scrap, 0, sizeof(entity_parse_scrap));
+  }
   dg_estate_free(&thisptr->state.entity_state);
+  if (thisptr->shared_datatables) {
+    dg_datatable_registry_release(thisptr->m_settings.datatable_registry,
+                                  thisptr->shared_datatables);
+    thisptr->shared_datatables = NULL;
+  }
 }
 
 #define PARSE_PREAMBLE()                                                                           \
@@ -329,7 +417,12 @@ void _parser_mainloop(dg_parser *thisptr) {
   NULL_CHECK(usercmd);
   NULL_CHECK(flattened_props);
 
-  if (settings->parse_packetentities || settings->packetentities_parsed_handler) {
+  if (settings->changed_props_handler || settings->history_ticks) {
+    settings->store_props = true;
+  }
+
+  if (settings->parse_packetentities || settings->packetentities_parsed_handler ||
+      settings->store_props) {
     settings->parse_packetentities = true; // Entity state init handler => we should store ents
     should_parse = true;
     thisptr->parse_netmessages = true;
@@ -339,7 +432,9 @@ void _parser_mainloop(dg_parser *thisptr) {
     should_parse = true;
   }
 
-  if (settings->packet_parsed_handler) {
+  if (settings->packet_parsed_handler || settings->game_event_handler ||
+      settings->game_event_list_handler || settings->user_message_handler ||
+      settings->temp_entities_parsed_handler) {
     should_parse = true;
     thisptr->parse_netmessages = true;
   }
@@ -421,7 +516,8 @@ void _parse_datatables(dg_parser *thisptr) {
   bool has_datatable_handler = thisptr->m_settings.datatables_handler ||
                                thisptr->m_settings.datatables_parsed_handler ||
                                thisptr->m_settings.parse_packetentities ||
-                               thisptr->m_settings.flattened_props_handler;
+                               thisptr->m_settings.flattened_props_handler ||
+                               thisptr->m_settings.temp_entities_parsed_handler;
 
   if (has_datatable_handler && message.size_bytes > 0) {
     dg_alloc_state* a = dg_parser_packet_allocator(thisptr);
@@ -432,7 +528,7 @@ void _parse_datatables(dg_parser *thisptr) {
       if (thisptr->m_settings.datatables_handler)
         thisptr->m_settings.datatables_handler(&thisptr->state, &message);
 
-      if (thisptr->m_settings.datatables_parsed_handler || thisptr->m_settings.parse_packetentities || thisptr->m_settings.flattened_props_handler)
+      if (thisptr->m_settings.datatables_parsed_handler || thisptr->m_settings.parse_packetentities || thisptr->m_settings.flattened_props_handler || thisptr->m_settings.temp_entities_parsed_handler)
         parse_datatables(thisptr, &message);
     }
   } else {
@@ -441,9 +537,7 @@ void _parse_datatables(dg_parser *thisptr) {
 }
 
 static void _parse_cmdinfo(dg_parser *thisptr, dg_packet *packet, size_t i) {
-  bool should_parse_netmessages =
-      !thisptr->demo_version.l4d2_version_finalized || thisptr->parse_netmessages;
-  if (thisptr->m_settings.packet_handler || should_parse_netmessages) {
+  if (thisptr->m_settings.packet_handler || thisptr->parse_netmessages) {
     dg_filereader_readdata(thisreader, packet->cmdinfo_raw[i].data,
                            sizeof(packet->cmdinfo_raw[i].data));
   } else {
@@ -456,8 +550,15 @@ void _parse_packet(dg_parser *thisptr, enum dg_type type) {
   message.preamble.type = message.preamble.converted_type = type;
   PARSE_PREAMBLE();
   message.cmdinfo_size = thisptr->demo_version.cmdinfo_size;
-  bool should_parse_netmessages =
-      !thisptr->demo_version.l4d2_version_finalized || thisptr->parse_netmessages;
+
+  // The build gets printed during signon, if we haven't seen it by now it's not coming
+  if (!thisptr->demo_version.l4d2_version_finalized && type == dg_type_packet) {
+    dg_parser_update_l4d2_version(thisptr, thisptr->demo_version.l4d2_version);
+  }
+
+  bool should_sniff_version =
+      !thisptr->demo_version.l4d2_version_finalized && !thisptr->parse_netmessages;
+  bool should_parse_netmessages = thisptr->parse_netmessages;
 
   for (int i = 0; i < message.cmdinfo_size; ++i) {
     _parse_cmdinfo(thisptr, &message, i);
@@ -467,11 +568,15 @@ void _parse_packet(dg_parser *thisptr, enum dg_type type) {
   message.out_sequence = dg_filereader_readint32(thisreader);
   message.size_bytes = _parser_read_length(thisptr);
 
-  if ((thisptr->m_settings.packet_handler || should_parse_netmessages) && message.size_bytes > 0) {
+  if ((thisptr->m_settings.packet_handler || should_parse_netmessages || should_sniff_version) &&
+      message.size_bytes > 0) {
     dg_alloc_state* a = dg_parser_packet_allocator(thisptr);
     void *block = dg_alloc_allocate(a, message.size_bytes, 1);
     READ_MESSAGE_DATA();
     if (!thisptr->error) {
+      if (should_sniff_version && !sniff_l4d2_version(thisptr, &message)) {
+        should_parse_netmessages = true;
+      }
 
       if (thisptr->m_settings.packet_handler) {
         thisptr->m_settings.packet_handler(&thisptr->state, &message);
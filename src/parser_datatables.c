@@ -4,15 +4,19 @@
 #include "demogobbler.h"
 #include "demogobbler/bitstream.h"
 #include "demogobbler/bitwriter.h"
+#include "demogobbler/datatable_registry.h"
 #include "demogobbler/datatable_types.h"
+#include "demogobbler/hashtable.h"
 #include "parser_entity_state.h"
 #include "demogobbler/utils.h"
+#include "writer.h"
 #include <string.h>
 
 typedef dg_datatables_parsed datatables;
 
 typedef struct {
   dg_demver_data *demo_version;
+  dg_string_pool *pool;
   bool error;
   const char *error_message;
 } datatable_parser;
@@ -72,21 +76,31 @@ static dg_sendproptype raw_to_sendproptype(datatable_parser *thisptr, unsigned i
   return sendproptype_invalid;
 }
 
-static char *parse_cstring(dg_alloc_state *a, dg_bitstream *stream) {
+static const char *parse_cstring_hashed(datatable_parser *thisptr, dg_bitstream *stream,
+                                        size_t *length, uint32_t *hash) {
   char STRINGBUF[1024];
   size_t size = dg_bitstream_read_cstring(stream, STRINGBUF, sizeof(STRINGBUF));
-  char *rval = NULL;
+  const char *rval = NULL;
+  *length = 0;
+  *hash = 0;
 
   if (size == 0) {
     stream->overflow = true;
   } else if (!stream->overflow) {
-    rval = dg_alloc_allocate(a, size, 1);
-    memcpy(rval, STRINGBUF, size);
+    *length = size - 1;
+    *hash = dg_hashtable_hash(STRINGBUF, *length);
+    rval = dg_string_pool_intern(thisptr->pool, STRINGBUF, *length, *hash);
   }
 
   return rval;
 }
 
+static const char *parse_cstring(datatable_parser *thisptr, dg_bitstream *stream) {
+  size_t length;
+  uint32_t hash;
+  return parse_cstring_hashed(thisptr, stream, &length, &hash);
+}
+
 static unsigned get_flags_from_sendprop(writer *thisptr, dg_sendprop *prop) {
   unsigned flags = 0;
   // hopefully the compiler wizards can generate branchless code from this
@@ -204,7 +218,7 @@ static void parse_sendprop(datatable_parser *thisptr, dg_alloc_state *a, dg_bits
     return;
   }
 
-  prop->name = parse_cstring(a, stream);
+  prop->name = parse_cstring(thisptr, stream);
   unsigned flags = dg_bitstream_read_uint(stream, thisptr->demo_version->sendprop_flag_bits);
   get_sendprop_flags(thisptr, prop, flags);
 
@@ -213,9 +227,9 @@ static void parse_sendprop(datatable_parser *thisptr, dg_alloc_state *a, dg_bits
   }
 
   if (prop->proptype == sendproptype_datatable) {
-    prop->dtname = parse_cstring(a, stream);
+    prop->dtname = parse_cstring(thisptr, stream);
   } else if (prop->flag_exclude) {
-    prop->exclude_name = parse_cstring(a, stream);
+    prop->exclude_name = parse_cstring(thisptr, stream);
   } else if (prop->proptype == sendproptype_array) {
     prop->baseclass = table;
     prop->array_num_elements = dg_bitstream_read_uint(stream, 10);
@@ -250,7 +264,9 @@ static void parse_sendtable(datatable_parser *thisptr, dg_alloc_state *a, dg_bit
                             dg_sendtable *ptable) {
   memset(ptable, 0, sizeof(dg_sendtable));
   ptable->needs_decoder = dg_bitstream_read_bit(stream);
-  ptable->name = parse_cstring(a, stream);
+  size_t name_length;
+  uint32_t name_hash;
+  ptable->name = parse_cstring_hashed(thisptr, stream, &name_length, &name_hash);
 
   if (ptable->name == NULL) {
     thisptr->error = true;
@@ -258,6 +274,10 @@ static void parse_sendtable(datatable_parser *thisptr, dg_alloc_state *a, dg_bit
     return;
   }
 
+  // The flattening code looks tables up by name a lot
+  ptable->name_length = name_length;
+  ptable->name_hash = name_hash;
+
   ptable->prop_count = dg_bitstream_read_uint(stream, thisptr->demo_version->datatable_propcount_bits);
   ptable->props =
       dg_alloc_allocate(a, ptable->prop_count * sizeof(dg_sendprop), alignof(dg_sendprop));
@@ -277,8 +297,8 @@ static void parse_serverclass(datatable_parser *thisptr, dg_alloc_state *a, dg_b
                               dg_serverclass *pclass) {
   memset(pclass, 0, sizeof(dg_serverclass));
   pclass->serverclass_id = dg_bitstream_read_uint(stream, 16);
-  pclass->serverclass_name = parse_cstring(a, stream);
-  pclass->datatable_name = parse_cstring(a, stream);
+  pclass->serverclass_name = parse_cstring(thisptr, stream);
+  pclass->datatable_name = parse_cstring(thisptr, stream);
 }
 
 #undef ERROR_SET
@@ -323,8 +343,8 @@ void dg_write_datatables_parsed(writer *thisptr, dg_datatables_parsed *datatable
 
   if (!thisptr->error) {
     dg_write_preamble(thisptr, datatables->preamble);
-    thisptr->output_funcs.write(thisptr->_stream, &bytes, 4);
-    thisptr->output_funcs.write(thisptr->_stream, writer.ptr, bytes);
+    dg_write_int32(thisptr, bytes);
+    dg_write_data(thisptr, writer.ptr, bytes);
   }
 
   dg_bitwriter_free(&writer);
@@ -332,12 +352,25 @@ void dg_write_datatables_parsed(writer *thisptr, dg_datatables_parsed *datatable
 
 dg_datatables_parsed_rval dg_parse_datatables(dg_demver_data *version_data,
                                               dg_alloc_state *allocator, dg_datatables *input) {
+  dg_string_pool pool = dg_string_pool_create(allocator, 4096);
+  dg_datatables_parsed_rval rval =
+      dg_parse_datatables_with_pool(version_data, allocator, input, &pool);
+  dg_string_pool_free(&pool);
+
+  return rval;
+}
+
+dg_datatables_parsed_rval dg_parse_datatables_with_pool(dg_demver_data *version_data,
+                                                        dg_alloc_state *allocator,
+                                                        dg_datatables *input,
+                                                        dg_string_pool *pool) {
   datatable_parser dparser;
   datatables output;
   memset(&dparser, 0, sizeof(dparser));
   memset(&output, 0, sizeof(output));
 
   dparser.demo_version = version_data;
+  dparser.pool = pool;
   output.preamble = input->preamble;
   output._raw_buffer = input->data;
   output._raw_buffer_bytes = input->size_bytes;
@@ -345,18 +378,23 @@ dg_datatables_parsed_rval dg_parse_datatables(dg_demver_data *version_data,
   dg_bitstream stream = dg_bitstream_create(input->data, input->size_bytes * 8);
 
   size_t array_size = 1024; // a guess at what the array size could be
-  output.sendtables = malloc(array_size * sizeof(dg_sendtable));
+  // Allocated from the arena instead of being attached to it, so that arenas that are reused for
+  // many demos don't grow with every parse
+  output.sendtables = dg_alloc_allocate(allocator, array_size * sizeof(dg_sendtable),
+                                        alignof(dg_sendtable));
 
   while (dg_bitstream_read_bit(&stream)) {
     if (output.sendtable_count >= array_size) {
+      output.sendtables = dg_alloc_reallocate(allocator, output.sendtables,
+                                              array_size * sizeof(dg_sendtable),
+                                              2 * array_size * sizeof(dg_sendtable),
+                                              alignof(dg_sendtable));
       array_size <<= 1;
-      output.sendtables = realloc(output.sendtables, array_size * sizeof(dg_sendtable));
     }
     parse_sendtable(&dparser, allocator, &stream, output.sendtables + output.sendtable_count);
     ++output.sendtable_count;
   }
   //printf("sendtable count %lu\n", output.sendtable_count);
-  dg_alloc_attach(allocator, output.sendtables, array_size * sizeof(dg_sendtable));
 
   output.serverclass_count = dg_bitstream_read_uint(&stream, 16);
   output.serverclasses = dg_alloc_allocate(
@@ -384,10 +422,34 @@ dg_datatables_parsed_rval dg_parse_datatables(dg_demver_data *version_data,
   return rval;
 }
 
+static void attach_shared_datatables(dg_parser *thisptr, dg_datatables *input) {
+  const char *error_message = NULL;
+  const dg_shared_datatables *shared = dg_datatable_registry_acquire(
+      thisptr->m_settings.datatable_registry, &thisptr->demo_version, input, &error_message);
+
+  if (shared == NULL) {
+    thisptr->error = true;
+    thisptr->error_message = error_message;
+    return;
+  }
+
+  thisptr->shared_datatables = shared;
+
+  if (thisptr->m_settings.datatables_parsed_handler) {
+    // The shared copy was parsed from another demo, give the handler this demo's message
+    dg_datatables_parsed message = shared->datatables;
+    message.preamble = input->preamble;
+    message.orig = *input;
+    thisptr->m_settings.datatables_parsed_handler(&thisptr->state, &message);
+  }
+
+  dg_parser_attach_estate(thisptr, shared);
+}
+
 void parse_datatables(dg_parser *thisptr, dg_datatables *input) {
   dg_alloc_state* allocator;
   bool init_entity_state;
-  if (thisptr->state.entity_state.edicts == NULL && (thisptr->m_settings.parse_packetentities || thisptr->m_settings.flattened_props_handler)) {
+  if (thisptr->state.entity_state.edicts == NULL && (thisptr->m_settings.parse_packetentities || thisptr->m_settings.flattened_props_handler || thisptr->m_settings.temp_entities_parsed_handler)) {
     allocator = dg_parser_perm_allocator(thisptr);
     init_entity_state = false;
   } else {
@@ -395,8 +457,18 @@ void parse_datatables(dg_parser *thisptr, dg_datatables *input) {
     init_entity_state = true;
   }
 
-  dg_datatables_parsed_rval value =
-      dg_parse_datatables(&thisptr->demo_version, allocator, input);
+  if (!init_entity_state && thisptr->m_settings.datatable_registry) {
+    attach_shared_datatables(thisptr, input);
+    return;
+  }
+
+  dg_datatables_parsed_rval value;
+  if (thisptr->m_settings.string_pool) {
+    value = dg_parse_datatables_with_pool(&thisptr->demo_version, allocator, input,
+                                          thisptr->m_settings.string_pool);
+  } else {
+    value = dg_parse_datatables(&thisptr->demo_version, allocator, input);
+  }
 
   if (!value.error) {
     if (thisptr->m_settings.datatables_parsed_handler)
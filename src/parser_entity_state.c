@@ -1,9 +1,11 @@
 #include "parser_entity_state.h"
 #include "demogobbler/alignof_wrapper.h"
 #include "demogobbler/allocator.h"
+#include "demogobbler/datatable_registry.h"
 #include "demogobbler.h"
 #include "demogobbler/hashtable.h"
 #include "demogobbler/utils.h"
+#include "parser_packetentities.h"
 #include <string.h>
 
 static void free_inner_value(dg_prop_value_inner *value, dg_sendprop *prop);
@@ -121,7 +123,7 @@ static void dg_eproplist_freeprops(dg_eproplist *thisptr, dg_serverclass_data *d
 
   while (node) {
     temp = node->next;
-    dg_sendprop *prop = data->props + node->index;
+    dg_sendprop *prop = data->props[node->index];
     free_inner_value(&node->value, prop);
     free(node);
     node = temp;
@@ -133,7 +135,7 @@ static void dg_eproparr_freeprops(dg_eproparr *thisptr, dg_serverclass_data *dat
 
   while (value) {
     size_t index = value - thisptr->values;
-    dg_sendprop *prop = data->props + index;
+    dg_sendprop *prop = data->props[index];
     dg_prop_value_inner *next = dg_eproparr_next(thisptr, value);
     free_inner_value(value, prop);
     value = next;
@@ -152,15 +154,10 @@ void dg_eproplist_free(dg_eproplist *thisptr) {
 }
 
 typedef struct {
-  size_t max_props;
   dg_pes excluded_props;
   dg_hashtable dts_with_excludes;
+  dg_vector_array *flattened_props;
   size_t dt_index;
-  size_t serverclass_index;
-  size_t flattenedprop_index;
-  uint16_t baseclass_array[1024];
-  size_t baseclass_count;
-  size_t baseclass_index;
 } propdata;
 
 typedef struct {
@@ -172,36 +169,19 @@ typedef struct {
   bool error;
 } estate_init_state;
 
-static void add_baseclass(propdata *data, size_t dt_index) {
-  ++data->baseclass_count;
-
-  if (data->baseclass_count > 1024) {
-    abort();
-  }
-
-  memmove(data->baseclass_array + data->baseclass_index + 1,
-          data->baseclass_array + data->baseclass_index,
-          sizeof(size_t) * data->baseclass_count - data->baseclass_index);
-  data->baseclass_array[data->baseclass_index] = dt_index;
-}
-
-static uint16_t get_baseclass_from_array(propdata *data, size_t index) {
-  return data->baseclass_array[index];
-}
-
-// Returns true if either dg_hashtable gets completely full
+// Returns true if the exclude set gets completely full
 static bool add_exclude(propdata *data, dg_sendprop *prop) {
   dg_pes_insert(&data->excluded_props, prop);
   dg_hashtable_entry entry;
   entry.str = prop->exclude_name;
   entry.value = 0;
   dg_hashtable_insert(&data->dts_with_excludes, entry);
-  return data->excluded_props.item_count != data->excluded_props.max_items &&
-         data->dts_with_excludes.item_count != data->dts_with_excludes.max_items;
+  return data->excluded_props.item_count != data->excluded_props.max_items;
 }
 
 static bool does_datatable_have_excludes(propdata *data, dg_sendtable *table) {
-  dg_hashtable_entry entry = dg_hashtable_get(&data->dts_with_excludes, table->name);
+  dg_hashtable_entry entry = dg_hashtable_get_hashed(&data->dts_with_excludes, table->name,
+                                                     table->name_length, table->name_hash);
   return entry.str != NULL;
 }
 
@@ -212,13 +192,11 @@ static bool is_prop_excluded(propdata *data, dg_sendtable *table, dg_sendprop *p
 static void create_dt_hashtable(estate_init_state *thisptr) {
   dg_sendtable *sendtables = thisptr->entity_state->sendtables;
   const size_t sendtable_count = thisptr->entity_state->sendtable_count;
-  const float FILL_RATE = 0.9f;
-  const size_t buckets = (size_t)(sendtable_count / FILL_RATE);
 
   if (thisptr->ent_scrap->dt_hashtable.arr != NULL) {
     dg_hashtable_clear(&thisptr->ent_scrap->dt_hashtable);
   } else {
-    thisptr->ent_scrap->dt_hashtable = dg_hashtable_create(buckets);
+    thisptr->ent_scrap->dt_hashtable = dg_hashtable_create(sendtable_count);
   }
 
   for (size_t i = 0; i < sendtable_count && !thisptr->error; ++i) {
@@ -226,9 +204,10 @@ static void create_dt_hashtable(estate_init_state *thisptr) {
     entry.str = sendtables[i].name;
     entry.value = i;
 
-    if (!dg_hashtable_insert(&thisptr->ent_scrap->dt_hashtable, entry)) {
+    if (!dg_hashtable_insert_hashed(&thisptr->ent_scrap->dt_hashtable, entry,
+                                    sendtables[i].name_length, sendtables[i].name_hash)) {
       thisptr->error = true;
-      thisptr->error_message = "Hashtable collision with datatable names or ran out of space";
+      thisptr->error_message = "Duplicate datatable name";
     }
   }
 }
@@ -271,36 +250,71 @@ static void gather_excludes(estate_init_state *thisptr, propdata *data, size_t d
   }
 }
 
-static void gather_propdata(estate_init_state *thisptr, propdata *data, size_t datatable_index) {
+static void add_prop(estate_init_state *thisptr, propdata *data, dg_sendprop *prop) {
+  dg_sendprop **dest = dg_va_push_back_empty(data->flattened_props);
+
+  if (dest == NULL) {
+    thisptr->error = true;
+    thisptr->error_message = "Was unable to allocate memory for flattened props";
+    return;
+  }
+
+  *dest = prop;
+}
+
+// Props of collapsible datatables are emitted as if they were part of the table itself
+static void emit_props(estate_init_state *thisptr, propdata *data, dg_sendtable *table) {
+  bool table_has_excludes = does_datatable_have_excludes(data, table);
+  for (size_t prop_index = 0; prop_index < table->prop_count && !thisptr->error; ++prop_index) {
+    dg_sendprop *prop = table->props + prop_index;
+    if (prop->proptype == sendproptype_datatable) {
+      if (prop->flag_collapsible)
+        emit_props(thisptr, data, prop->baseclass);
+    } else if (!prop->flag_exclude && !prop->flag_insidearray) {
+      bool prop_excluded = table_has_excludes && is_prop_excluded(data, table, prop);
+      if (!prop_excluded) {
+        add_prop(thisptr, data, prop);
+      }
+    }
+  }
+}
+
+static void flatten_table(estate_init_state *thisptr, propdata *data, dg_sendtable *table);
+
+// Non-collapsible datatables are flattened before the table that contains them, in depth first
+// order
+static void flatten_baseclasses(estate_init_state *thisptr, propdata *data, dg_sendtable *table) {
   dg_sendtable *sendtables = thisptr->entity_state->sendtables;
-  dg_sendtable *table = sendtables + datatable_index;
   bool table_has_excludes = does_datatable_have_excludes(data, table);
 
   for (size_t prop_index = 0; prop_index < table->prop_count; ++prop_index) {
     dg_sendprop *prop = table->props + prop_index;
-    bool prop_excluded = table_has_excludes && is_prop_excluded(data, table, prop);
-    if (prop_excluded)
+    if (prop->proptype != sendproptype_datatable ||
+        (table_has_excludes && is_prop_excluded(data, table, prop)))
       continue;
 
-    if (prop->proptype == sendproptype_datatable) {
-      size_t baseclass_index = get_baseclass(thisptr, data, prop);
+    size_t baseclass_index = get_baseclass(thisptr, data, prop);
 
-      if (thisptr->error)
-        return;
+    if (thisptr->error)
+      return;
 
-      if (!prop->flag_collapsible) {
-        add_baseclass(data, baseclass_index);
-        gather_propdata(thisptr, data, baseclass_index);
-        ++data->baseclass_index;
-      } else {
-        gather_propdata(thisptr, data, baseclass_index);
-      }
-    } else if (!prop->flag_insidearray && !prop->flag_exclude) {
-      ++data->max_props;
+    if (prop->flag_collapsible) {
+      flatten_baseclasses(thisptr, data, sendtables + baseclass_index);
+    } else {
+      flatten_table(thisptr, data, sendtables + baseclass_index);
     }
+
+    if (thisptr->error)
+      return;
   }
 }
 
+static void flatten_table(estate_init_state *thisptr, propdata *data, dg_sendtable *table) {
+  flatten_baseclasses(thisptr, data, table);
+  if (!thisptr->error)
+    emit_props(thisptr, data, table);
+}
+
 static uint8_t get_priority_protocol4(dg_sendprop *prop) {
   if (prop->priority >= 64 && prop->flag_changesoften)
     return 64;
@@ -308,32 +322,38 @@ static uint8_t get_priority_protocol4(dg_sendprop *prop) {
     return prop->priority;
 }
 
+static void swap_props(dg_sendprop **a, dg_sendprop **b) {
+  dg_sendprop *temp = *a;
+  *a = *b;
+  *b = temp;
+}
+
+// The engine moves props to the front by swapping, so the order within a priority is not stable.
+// The prop indices on the wire depend on this, so the swaps are replicated exactly.
 static void sort_props(estate_init_state *thisptr, dg_serverclass_data *class_data) {
   if (thisptr->args.version_data->demo_protocol >= 4 && thisptr->args.version_data->game != l4d) {
-    bool priorities[256];
-    memset(priorities, 0, sizeof(priorities));
+    size_t counts[256];
+    memset(counts, 0, sizeof(counts));
 
-    for (int i = 0; i < class_data->prop_count; ++i) {
-      size_t prio = get_priority_protocol4(class_data->props + i);
-      priorities[prio] = true;
+    for (size_t i = 0; i < class_data->prop_count; ++i) {
+      ++counts[get_priority_protocol4(class_data->props[i])];
     }
 
     size_t start = 0;
 
     for (size_t current_prio = 0; current_prio < 256; ++current_prio) {
-      if (priorities[current_prio] == false)
-        continue;
-
-      for (size_t i = start; i < class_data->prop_count; ++i) {
-        dg_sendprop *prop = class_data->props + i;
-        uint8_t prio = get_priority_protocol4(prop);
-
-        if (prio == current_prio) {
-          dg_sendprop *dest = class_data->props + start;
-          dg_sendprop temp = *dest;
-          *dest = *prop;
-          *prop = temp;
+      size_t remaining = counts[current_prio];
+
+      // Once only one priority is left everything is already in place
+      if (start + remaining == class_data->prop_count)
+        break;
+
+      // The scan can stop as soon as every prop with this priority has been moved
+      for (size_t i = start; remaining > 0; ++i) {
+        if (get_priority_protocol4(class_data->props[i]) == current_prio) {
+          swap_props(class_data->props + start, class_data->props + i);
           ++start;
+          --remaining;
         }
       }
     }
@@ -341,48 +361,86 @@ static void sort_props(estate_init_state *thisptr, dg_serverclass_data *class_da
     size_t start = 0;
 
     for (size_t i = start; i < class_data->prop_count; ++i) {
-      dg_sendprop *prop = class_data->props + i;
-      if (prop->flag_changesoften) {
-        dg_sendprop *dest = class_data->props + start;
-        dg_sendprop temp = *dest;
-        *dest = *prop;
-        *prop = temp;
+      if (class_data->props[i]->flag_changesoften) {
+        swap_props(class_data->props + start, class_data->props + i);
         ++start;
       }
     }
   }
 }
 
-static void iterate_props(estate_init_state *thisptr, propdata *data, dg_sendtable *table) {
-  bool table_has_excludes = does_datatable_have_excludes(data, table);
-  for (size_t prop_index = 0; prop_index < table->prop_count; ++prop_index) {
-    dg_sendprop *prop = table->props + prop_index;
-    if (prop->proptype == sendproptype_datatable) {
-      if (prop->flag_collapsible)
-        iterate_props(thisptr, data, prop->baseclass);
-    } else if (!prop->flag_exclude && !prop->flag_insidearray) {
-      bool prop_excluded = table_has_excludes && is_prop_excluded(data, table, prop);
-      if (!prop_excluded) {
-        size_t flattenedprop_index =
-            thisptr->entity_state->class_datas[data->serverclass_index].prop_count;
-        dg_sendprop *dest =
-            thisptr->entity_state->class_datas[data->serverclass_index].props + flattenedprop_index;
-        memcpy(dest, prop, sizeof(dg_sendprop));
-        ++thisptr->entity_state->class_datas[data->serverclass_index].prop_count;
+#define PROP_LOOKUP_QUALIFIED 0x80000000u
+
+static uint32_t qualified_prop_hash(uint32_t table_hash, uint32_t prop_hash) {
+  return table_hash ^ (prop_hash * 0x9E3779B1u);
+}
+
+static bool prop_name_matches(const dg_sendprop *prop, const char *table_name,
+                              size_t table_name_length, const char *prop_name) {
+  if (strcmp(prop->name, prop_name) != 0) {
+    return false;
+  } else if (table_name == NULL) {
+    return true;
+  } else {
+    return prop->baseclass->name_length == table_name_length &&
+           memcmp(prop->baseclass->name, table_name, table_name_length) == 0;
+  }
+}
+
+// Table name is NULL for unqualified lookups
+static int find_prop_in_lookup(const dg_serverclass_data *data, uint32_t hash,
+                               const char *table_name, size_t table_name_length,
+                               const char *prop_name) {
+  const uint32_t qualified = table_name ? PROP_LOOKUP_QUALIFIED : 0;
+
+  for (uint32_t i = hash & data->lookup_mask;; i = (i + 1) & data->lookup_mask) {
+    const dg_prop_lookup_slot *slot = data->lookup + i;
+
+    if (slot->value == 0) {
+      return -1;
+    } else if (slot->hash == hash && (slot->value & PROP_LOOKUP_QUALIFIED) == qualified) {
+      int index = (int)(slot->value & ~PROP_LOOKUP_QUALIFIED) - 1;
+      if (prop_name_matches(data->props[index], table_name, table_name_length, prop_name)) {
+        return index;
       }
     }
   }
 }
 
-static void gather_props(estate_init_state *thisptr, propdata *data) {
-  dg_sendtable *sendtables = thisptr->entity_state->sendtables;
-  for (size_t i = 0; i < data->baseclass_count; ++i) {
-    uint16_t baseclass_index = get_baseclass_from_array(data, i);
-    dg_sendtable *table = sendtables + baseclass_index;
-    iterate_props(thisptr, data, table);
+static void insert_into_lookup(dg_serverclass_data *data, uint32_t hash, uint32_t value) {
+  uint32_t i = hash & data->lookup_mask;
+  while (data->lookup[i].value != 0) {
+    i = (i + 1) & data->lookup_mask;
   }
+  data->lookup[i].hash = hash;
+  data->lookup[i].value = value;
+}
 
-  iterate_props(thisptr, data, sendtables + data->dt_index);
+// Every prop goes in twice, once with the table name and once without
+static void build_prop_lookup(estate_init_state *thisptr, dg_serverclass_data *data) {
+  size_t capacity = 16;
+  while (capacity < data->prop_count * 4) {
+    capacity <<= 1;
+  }
+
+  data->lookup = dg_alloc_allocate(thisptr->allocator, sizeof(dg_prop_lookup_slot) * capacity,
+                                   alignof(dg_prop_lookup_slot));
+  memset(data->lookup, 0, sizeof(dg_prop_lookup_slot) * capacity);
+  data->lookup_mask = capacity - 1;
+
+  for (size_t i = 0; i < data->prop_count; ++i) {
+    const dg_sendprop *prop = data->props[i];
+    uint32_t prop_hash = dg_hashtable_hash(prop->name, strlen(prop->name));
+    uint32_t value = i + 1;
+
+    insert_into_lookup(data, qualified_prop_hash(prop->baseclass->name_hash, prop_hash),
+                       value | PROP_LOOKUP_QUALIFIED);
+
+    // Unqualified lookups return the first prop with the name
+    if (find_prop_in_lookup(data, prop_hash, NULL, 0, prop->name) == -1) {
+      insert_into_lookup(data, prop_hash, value);
+    }
+  }
 }
 
 #define CHECK_ERR()                                                                                \
@@ -395,7 +453,8 @@ static void parse_serverclass(estate_init_state *thisptr, size_t i) {
   memset(&data, 0, sizeof(propdata));
   data.excluded_props = thisptr->ent_scrap->excluded_props;
   data.dts_with_excludes = thisptr->ent_scrap->dts_with_excludes;
-  data.serverclass_index = i;
+  data.flattened_props = &thisptr->ent_scrap->flattened_props;
+  dg_va_clear(data.flattened_props);
 
   dg_serverclass *cls = thisptr->entity_state->serverclasses + i;
   dg_hashtable_entry entry =
@@ -408,25 +467,36 @@ static void parse_serverclass(estate_init_state *thisptr, size_t i) {
     goto end;
   }
 
-  data.dts_with_excludes.item_count = 0;
+  dg_hashtable_clear(&data.dts_with_excludes);
   dg_pes_clear(&data.excluded_props);
   gather_excludes(thisptr, &data, data.dt_index);
   CHECK_ERR();
-  gather_propdata(thisptr, &data, data.dt_index);
+  flatten_table(thisptr, &data, thisptr->entity_state->sendtables + data.dt_index);
   CHECK_ERR();
 
-  thisptr->entity_state->class_datas[i].props =
-      dg_alloc_allocate(thisptr->allocator, sizeof(dg_sendprop) * data.max_props,
-                        alignof(dg_sendprop));
-  thisptr->entity_state->class_datas[i].prop_count = 0;
-  thisptr->entity_state->class_datas[i].dt_name =
-      (thisptr->entity_state->sendtables + data.dt_index)->name;
+  dg_serverclass_data *class_data = thisptr->entity_state->class_datas + i;
+  size_t prop_count = data.flattened_props->count_elements;
+  class_data->props = dg_alloc_allocate(thisptr->allocator, sizeof(dg_sendprop *) * prop_count,
+                                        alignof(dg_sendprop *));
+  memcpy(class_data->props, data.flattened_props->ptr, sizeof(dg_sendprop *) * prop_count);
+  class_data->prop_count = prop_count;
+  class_data->dt_name = (thisptr->entity_state->sendtables + data.dt_index)->name;
 
-  gather_props(thisptr, &data);
-  CHECK_ERR();
-  sort_props(thisptr, thisptr->entity_state->class_datas + i);
+  sort_props(thisptr, class_data);
+
+  class_data->flatprops = dg_alloc_allocate(thisptr->allocator, sizeof(dg_flatprop) * prop_count,
+                                            alignof(dg_flatprop));
+  for (size_t prop_index = 0; prop_index < prop_count; ++prop_index) {
+    dg_flatprop_init(class_data->flatprops + prop_index, class_data->props[prop_index]);
+  }
+
+  if (thisptr->entity_state->build_prop_lookup) {
+    build_prop_lookup(thisptr, class_data);
+  }
   CHECK_ERR();
-end:;
+end:
+  // The hashtable may have grown while gathering excludes
+  thisptr->ent_scrap->dts_with_excludes = data.dts_with_excludes;
 }
 
 dg_parse_result dg_estate_init(estate *thisptr, estate_init_args args) {
@@ -437,8 +507,12 @@ dg_parse_result dg_estate_init(estate *thisptr, estate_init_args args) {
     return result;
   }
 
+  // Scrap may have been handed over by a parser context, keep it around for reuse
+  entity_parse_scrap scrap = thisptr->scrap;
   memset(thisptr, 0, sizeof(*thisptr));
+  thisptr->scrap = scrap;
   thisptr->should_store_props = args.should_store_props;
+  thisptr->build_prop_lookup = args.build_prop_lookup;
   thisptr->sendtables = args.message->sendtables;
   thisptr->serverclasses = args.message->serverclasses;
   thisptr->serverclass_count = args.message->serverclass_count;
@@ -446,6 +520,8 @@ dg_parse_result dg_estate_init(estate *thisptr, estate_init_args args) {
   thisptr->edicts =
       dg_alloc_allocate(args.allocator, sizeof(dg_edict) * MAX_EDICTS, alignof(dg_edict));
   memset(thisptr->edicts, 0, sizeof(dg_edict) * MAX_EDICTS);
+  thisptr->changed_edicts =
+      dg_alloc_allocate(args.allocator, sizeof(uint16_t) * MAX_EDICTS, alignof(uint16_t));
 
   estate_init_state state;
   memset(&state, 0, sizeof(state));
@@ -462,6 +538,13 @@ dg_parse_result dg_estate_init(estate *thisptr, estate_init_args args) {
     }
     if (thisptr->scrap.dts_with_excludes.arr == NULL) {
       thisptr->scrap.dts_with_excludes = dg_hashtable_create(256);
+    } else {
+      // Entries from a previous demo point to memory that has been reused
+      dg_hashtable_clear(&thisptr->scrap.dts_with_excludes);
+    }
+    if (thisptr->scrap.flattened_props.bytes_per_element == 0) {
+      thisptr->scrap.flattened_props =
+          dg_va_create_(NULL, 0, sizeof(dg_sendprop *), alignof(dg_sendprop *));
     }
     size_t array_size = sizeof(dg_serverclass_data) * thisptr->serverclass_count;
     thisptr->class_datas =
@@ -503,6 +586,7 @@ static void free_inner_value(dg_prop_value_inner *value, dg_sendprop *prop) {
 static void free_props(dg_edict *ent, dg_serverclass_data *data) {
   if (ent->exists) {
     dg_eproplist_freeprops(&ent->props, data);
+    free(ent->changed_props);
   }
 }
 #else
@@ -510,11 +594,17 @@ static void free_props(dg_edict *ent, dg_serverclass_data *data) {
   if (ent->exists) {
     dg_eproparr_freeprops(&ent->props, data);
     dg_eproparr_free(&ent->props);
+    free(ent->changed_props);
   }
 }
 #endif
 
+static void snapshot_free_all(estate *entity_state);
+
 void dg_estate_free(estate *thisptr) {
+  snapshot_free_all(thisptr);
+  dg_estate_history_free(thisptr);
+
   if (thisptr->should_store_props) {
     for (size_t i = 0; i < MAX_EDICTS; ++i) {
       dg_edict *ent = thisptr->edicts + i;
@@ -525,12 +615,40 @@ void dg_estate_free(estate *thisptr) {
   dg_hashtable_free(&thisptr->scrap.dt_hashtable);
   dg_hashtable_free(&thisptr->scrap.dts_with_excludes);
   dg_pes_free(&thisptr->scrap.excluded_props);
+  dg_va_free(&thisptr->scrap.flattened_props);
+}
+
+static void estate_ready(dg_parser *thisptr, dg_alloc_state *allocator) {
+  if (!thisptr->error && thisptr->m_settings.temp_entity_filter) {
+    estate *entity_state = &thisptr->state.entity_state;
+    thisptr->temp_entity_classes =
+        dg_alloc_allocate(allocator, sizeof(bool) * entity_state->serverclass_count, 1);
+    for (size_t i = 0; i < entity_state->serverclass_count; ++i) {
+      thisptr->temp_entity_classes[i] =
+          thisptr->m_settings.temp_entity_filter(&thisptr->state, entity_state->serverclasses + i);
+    }
+  }
+
+  thisptr->state.entity_state.instancebaselines = &thisptr->state.instancebaselines;
+  thisptr->state.entity_state.track_changed_props = thisptr->m_settings.changed_props_handler != NULL;
+  if (thisptr->m_settings.history_ticks) {
+    dg_estate_history_create(&thisptr->state.entity_state, thisptr->m_settings.history_ticks);
+  }
+  // Baselines that arrived before the datatables could not be decoded yet
+  if (!thisptr->error && thisptr->m_settings.parse_packetentities) {
+    dg_parser_decode_instancebaselines(thisptr);
+  }
+
+  if (!thisptr->error && thisptr->m_settings.flattened_props_handler) {
+    thisptr->m_settings.flattened_props_handler(&thisptr->state);
+  }
 }
 
 void dg_parser_init_estate(dg_parser *thisptr, dg_datatables_parsed *message) {
   estate_init_args args;
-  args.should_store_props = false;
+  args.should_store_props = thisptr->m_settings.store_props;
   args.flatten_datatables = thisptr->m_settings.flattened_props_handler != NULL;
+  args.build_prop_lookup = thisptr->m_settings.build_prop_lookup;
   args.message = message;
   args.version_data = &thisptr->demo_version;
   args.allocator = dg_parser_perm_allocator(thisptr);
@@ -542,9 +660,30 @@ void dg_parser_init_estate(dg_parser *thisptr, dg_datatables_parsed *message) {
     thisptr->error_message = result.error_message;
   }
 
-  if (!thisptr->error && thisptr->m_settings.flattened_props_handler) {
-    thisptr->m_settings.flattened_props_handler(&thisptr->state);
-  }
+  estate_ready(thisptr, args.allocator);
+}
+
+void dg_parser_attach_estate(dg_parser *thisptr, const dg_shared_datatables *shared) {
+  estate *entity_state = &thisptr->state.entity_state;
+  dg_alloc_state *allocator = dg_parser_perm_allocator(thisptr);
+
+  // Class datas are read-only from here on, only the edicts belong to this parser
+  entity_parse_scrap scrap = entity_state->scrap;
+  memset(entity_state, 0, sizeof(*entity_state));
+  entity_state->scrap = scrap;
+  entity_state->sendtables = shared->datatables.sendtables;
+  entity_state->serverclasses = shared->datatables.serverclasses;
+  entity_state->serverclass_count = shared->datatables.serverclass_count;
+  entity_state->sendtable_count = shared->datatables.sendtable_count;
+  entity_state->class_datas = shared->class_datas;
+  entity_state->should_store_props = thisptr->m_settings.store_props;
+  entity_state->edicts =
+      dg_alloc_allocate(allocator, sizeof(dg_edict) * MAX_EDICTS, alignof(dg_edict));
+  memset(entity_state->edicts, 0, sizeof(dg_edict) * MAX_EDICTS);
+  entity_state->changed_edicts =
+      dg_alloc_allocate(allocator, sizeof(uint16_t) * MAX_EDICTS, alignof(uint16_t));
+
+  estate_ready(thisptr, allocator);
 }
 
 dg_serverclass_data *dg_estate_serverclass_data(estate *thisptr, const dg_demver_data* demver_data, dg_alloc_state* allocator, size_t index) {
@@ -562,6 +701,52 @@ dg_serverclass_data *dg_estate_serverclass_data(estate *thisptr, const dg_demver
   return state.entity_state->class_datas + index;
 }
 
+static int find_prop_linear(const dg_serverclass_data *data, const char *table_name,
+                            size_t table_name_length, const char *prop_name) {
+  for (size_t i = 0; i < data->prop_count; ++i) {
+    if (prop_name_matches(data->props[i], table_name, table_name_length, prop_name)) {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+static int find_prop(const dg_serverclass_data *data, const char *table_name,
+                     size_t table_name_length, const char *prop_name) {
+  if (data->lookup == NULL) {
+    return find_prop_linear(data, table_name, table_name_length, prop_name);
+  }
+
+  uint32_t hash = dg_hashtable_hash(prop_name, strlen(prop_name));
+  if (table_name) {
+    hash = qualified_prop_hash(dg_hashtable_hash(table_name, table_name_length), hash);
+  }
+
+  return find_prop_in_lookup(data, hash, table_name, table_name_length, prop_name);
+}
+
+int dg_estate_find_prop(const estate *thisptr, size_t class_id, const char *name) {
+  if (class_id >= thisptr->serverclass_count || thisptr->class_datas == NULL) {
+    return -1;
+  }
+
+  const dg_serverclass_data *data = thisptr->class_datas + class_id;
+  const char *dot = strchr(name, '.');
+  int index = -1;
+
+  if (dot) {
+    index = find_prop(data, name, dot - name, dot + 1);
+  }
+
+  // Prop names can contain dots as well
+  if (index == -1) {
+    index = find_prop(data, NULL, 0, name);
+  }
+
+  return index;
+}
+
 static void copy_into_inner_value(dg_prop_value_inner *dest, const dg_prop_value_inner *src,
                                   dg_sendproptype prop_type) {
   if (prop_type == sendproptype_vector3) {
@@ -579,25 +764,96 @@ static void copy_into_inner_value(dg_prop_value_inner *dest, const dg_prop_value
       if (current_len < value_len) {
         // If new value too large, realloc the string
         // Also works in the null pointer case
-        dest->str_val->str = realloc(dest->str_val->str, value_len);
-        dest->str_val->len = value_len;
-        current_len = value_len;
+        dest->str_val->str = realloc(dest->str_val->str, value_len + 1);
       }
-      strncpy(dest->str_val->str, src->str_val->str, current_len);
+      // Length has to match the value so that changes can be detected by comparing
+      memcpy(dest->str_val->str, src->str_val->str, value_len);
+      dest->str_val->str[value_len] = '\0';
+      dest->str_val->len = value_len;
     }
   } else {
     memcpy(dest, src, sizeof(dg_prop_value_inner));
   }
 }
 
-static void copy_into_prop(dg_prop_value_inner *dest, const prop_value *value, const dg_sendprop* prop) {
+static bool scalar_value_equal(const dg_prop_value_inner *a, const dg_prop_value_inner *b) {
+  if (a->type != b->type) {
+    return false;
+  }
+
+  switch (b->type) {
+  case dg_float_bitcoord:
+    return a->bitcoord_val.exists == b->bitcoord_val.exists &&
+           a->bitcoord_val.has_int == b->bitcoord_val.has_int &&
+           a->bitcoord_val.has_frac == b->bitcoord_val.has_frac &&
+           a->bitcoord_val.sign == b->bitcoord_val.sign &&
+           a->bitcoord_val.int_value == b->bitcoord_val.int_value &&
+           a->bitcoord_val.frac_value == b->bitcoord_val.frac_value;
+  case dg_float_bitcoordmp:
+  case dg_float_bitcoordmplp:
+  case dg_float_bitcoordmpint:
+    return a->bitcoordmp_val.int_val == b->bitcoordmp_val.int_val &&
+           a->bitcoordmp_val.frac_val == b->bitcoordmp_val.frac_val &&
+           a->bitcoordmp_val.inbounds == b->bitcoordmp_val.inbounds &&
+           a->bitcoordmp_val.int_has_val == b->bitcoordmp_val.int_has_val &&
+           a->bitcoordmp_val.sign == b->bitcoordmp_val.sign;
+  case dg_float_bitnormal:
+    return a->bitnormal_val.frac == b->bitnormal_val.frac &&
+           a->bitnormal_val.sign == b->bitnormal_val.sign;
+  case dg_float_bitcellcoord:
+  case dg_float_bitcellcoordlp:
+  case dg_float_bitcellcoordint:
+    return a->bitcellcoord_val.int_val == b->bitcellcoord_val.int_val &&
+           a->bitcellcoord_val.fract_val == b->bitcellcoord_val.fract_val;
+  default:
+    // Ints and the remaining floats fit in 32 bits, noscale floats are compared bitwise
+    return a->unsigned_val == b->unsigned_val;
+  }
+}
+
+static bool inner_value_equal(const dg_prop_value_inner *a, const dg_prop_value_inner *b,
+                              dg_sendproptype prop_type) {
+  if (prop_type == sendproptype_vector3) {
+    return scalar_value_equal(&a->v3_val->x, &b->v3_val->x) &&
+           scalar_value_equal(&a->v3_val->y, &b->v3_val->y) &&
+           scalar_value_equal(&a->v3_val->z, &b->v3_val->z) &&
+           a->v3_val->_sign == b->v3_val->_sign;
+  } else if (prop_type == sendproptype_vector2) {
+    return scalar_value_equal(&a->v2_val->x, &b->v2_val->x) &&
+           scalar_value_equal(&a->v2_val->y, &b->v2_val->y);
+  } else if (prop_type == sendproptype_string) {
+    return a->str_val->len == b->str_val->len &&
+           (b->str_val->len == 0 || memcmp(a->str_val->str, b->str_val->str, b->str_val->len) == 0);
+  } else {
+    return scalar_value_equal(a, b);
+  }
+}
+
+static bool prop_value_equal(const dg_prop_value_inner *dest, const dg_prop_value_inner *value,
+                             const dg_sendprop *prop) {
+  if (prop->proptype != sendproptype_array) {
+    return inner_value_equal(dest, value, prop->proptype);
+  }
+
+  for (size_t i = 0; i < value->arr_val->array_size; ++i) {
+    if (!inner_value_equal(dest->arr_val->values + i, value->arr_val->values + i,
+                           prop->array_prop->proptype)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static void copy_into_prop(dg_prop_value_inner *dest, const dg_prop_value_inner *value,
+                           const dg_sendprop *prop) {
   dg_sendproptype prop_type = prop->proptype;
   if (prop_type != sendproptype_array) {
-    copy_into_inner_value(dest, &value->value, prop_type);
+    copy_into_inner_value(dest, value, prop_type);
   } else {
     dg_sendproptype array_prop_type = prop->array_prop->proptype;
-    for (size_t i = 0; i < value->value.arr_val->array_size; ++i) {
-      copy_into_inner_value(dest->arr_val->values + i, value->value.arr_val->values + i,
+    for (size_t i = 0; i < value->arr_val->array_size; ++i) {
+      copy_into_inner_value(dest->arr_val->values + i, value->arr_val->values + i,
                             array_prop_type);
     }
   }
@@ -634,8 +890,469 @@ size_t number_of_props(dg_eproplist *thisptr) {
   return i;
 }
 
+static void mark_changed(estate *entity_state, dg_edict *ent, uint32_t prop_index) {
+  ent->changed_props[prop_index / 64] |= 1ull << (prop_index % 64);
+  if (!ent->changed) {
+    ent->changed = true;
+    entity_state->changed_edicts[entity_state->changed_edicts_count++] = ent - entity_state->edicts;
+  }
+}
+
+static void clear_changed(estate *entity_state) {
+  for (uint32_t i = 0; i < entity_state->changed_edicts_count; ++i) {
+    dg_edict *ent = entity_state->edicts + entity_state->changed_edicts[i];
+    // Deleted edicts no longer have props
+    if (ent->changed_props) {
+      size_t prop_count = entity_state->class_datas[ent->datatable_id].prop_count;
+      memset(ent->changed_props, 0, sizeof(uint64_t) * ((prop_count + 63) / 64));
+    }
+    ent->changed = false;
+  }
+  entity_state->changed_edicts_count = 0;
+}
+
+bool dg_edict_prop_changed(const dg_edict *ent, uint32_t prop_index) {
+  return ent->changed_props && (ent->changed_props[prop_index / 64] & (1ull << (prop_index % 64)));
+}
+
+// Edicts stay in the changed list until the next update even if they are deleted
+static void clear_edict(dg_edict *ent) {
+  bool changed = ent->changed;
+  memset(ent, 0, sizeof(dg_edict));
+  ent->changed = changed;
+}
+
+typedef struct {
+  dg_eproparr props; // Values at the time of the snapshot, only for props written since then
+  int datatable_id;
+  int handle;
+  bool touched;
+  bool exists;
+  bool in_pvs;
+  bool recreated; // Deleted or replaced since the snapshot, props are no longer compared
+} snapshot_edict;
+
+struct dg_estate_snapshot {
+  dg_estate_snapshot *next;
+  snapshot_edict edicts[MAX_EDICTS];
+  uint16_t touched[MAX_EDICTS];
+  uint32_t touched_count;
+};
+
+// Remembers what the edict looked like before the first update that touches it
+static void snapshot_touch(estate *entity_state, uint16_t ent_index) {
+  const dg_edict *ent = entity_state->edicts + ent_index;
+  for (dg_estate_snapshot *snapshot = entity_state->snapshots; snapshot; snapshot = snapshot->next) {
+    snapshot_edict *record = snapshot->edicts + ent_index;
+    if (record->touched) {
+      continue;
+    }
+
+    record->touched = true;
+    record->exists = ent->exists;
+    record->in_pvs = ent->in_pvs;
+    record->datatable_id = ent->datatable_id;
+    record->handle = ent->handle;
+    if (ent->exists) {
+      record->props = dg_eproparr_init(entity_state->class_datas[ent->datatable_id].prop_count);
+    }
+    snapshot->touched[snapshot->touched_count++] = ent_index;
+  }
+}
+
+static void snapshot_recreate(estate *entity_state, uint16_t ent_index) {
+  for (dg_estate_snapshot *snapshot = entity_state->snapshots; snapshot; snapshot = snapshot->next) {
+    snapshot->edicts[ent_index].recreated = true;
+  }
+}
+
+// Copy on first write, props that did not exist at the snapshot are saved as empty values
+static void snapshot_save_prop(estate *entity_state, const dg_edict *ent, uint16_t prop_index,
+                               const dg_prop_value_inner *current, bool newprop) {
+  uint16_t ent_index = ent - entity_state->edicts;
+  for (dg_estate_snapshot *snapshot = entity_state->snapshots; snapshot; snapshot = snapshot->next) {
+    snapshot_edict *record = snapshot->edicts + ent_index;
+    if (!record->exists || record->recreated) {
+      continue;
+    }
+
+    bool first_write;
+    dg_prop_value_inner *saved = dg_eproparr_get(&record->props, prop_index, &first_write);
+    if (first_write) {
+      dg_sendprop *prop = entity_state->class_datas[record->datatable_id].props[prop_index];
+      alloc_inner_value(saved, prop);
+      if (!newprop) {
+        copy_into_prop(saved, current, prop);
+      }
+    }
+  }
+}
+
+static void snapshot_clear(estate *entity_state, dg_estate_snapshot *snapshot) {
+  for (uint32_t i = 0; i < snapshot->touched_count; ++i) {
+    snapshot_edict *record = snapshot->edicts + snapshot->touched[i];
+    if (record->exists) {
+      dg_eproparr_freeprops(&record->props, entity_state->class_datas + record->datatable_id);
+      dg_eproparr_free(&record->props);
+    }
+    memset(record, 0, sizeof(*record));
+  }
+  snapshot->touched_count = 0;
+}
+
+dg_estate_snapshot *dg_estate_snapshot_create(estate *thisptr) {
+  if (!thisptr->should_store_props || thisptr->edicts == NULL) {
+    return NULL;
+  }
+
+  dg_estate_snapshot *snapshot = calloc(1, sizeof(dg_estate_snapshot));
+  snapshot->next = thisptr->snapshots;
+  thisptr->snapshots = snapshot;
+  return snapshot;
+}
+
+void dg_estate_snapshot_reset(estate *thisptr, dg_estate_snapshot *snapshot) {
+  snapshot_clear(thisptr, snapshot);
+}
+
+void dg_estate_snapshot_free(estate *thisptr, dg_estate_snapshot *snapshot) {
+  dg_estate_snapshot **link = &thisptr->snapshots;
+  while (*link && *link != snapshot) {
+    link = &(*link)->next;
+  }
+  if (*link) {
+    *link = snapshot->next;
+  }
+
+  snapshot_clear(thisptr, snapshot);
+  free(snapshot);
+}
+
+static void snapshot_free_all(estate *entity_state) {
+  while (entity_state->snapshots) {
+    dg_estate_snapshot *snapshot = entity_state->snapshots;
+    entity_state->snapshots = snapshot->next;
+    snapshot_clear(entity_state, snapshot);
+    free(snapshot);
+  }
+}
+
+// Writes the indices of the props that differ from the snapshot to output if it is not NULL
+static uint32_t collect_changed_props(const estate *entity_state, const snapshot_edict *record,
+                                      const dg_edict *ent, bool created, uint16_t *output) {
+  uint32_t count = 0;
+  if (created) {
+    for (dg_prop_value_inner *value = dg_eproparr_next(&ent->props, NULL); value;
+         value = dg_eproparr_next(&ent->props, value)) {
+      if (output) {
+        output[count] = value - ent->props.values;
+      }
+      ++count;
+    }
+  } else {
+    const dg_serverclass_data *data = entity_state->class_datas + ent->datatable_id;
+    for (dg_prop_value_inner *saved = dg_eproparr_next(&record->props, NULL); saved;
+         saved = dg_eproparr_next(&record->props, saved)) {
+      size_t index = saved - record->props.values;
+      if (!prop_value_equal(saved, ent->props.values + index, data->props[index])) {
+        if (output) {
+          output[count] = index;
+        }
+        ++count;
+      }
+    }
+  }
+
+  return count;
+}
+
+dg_estate_diff dg_estate_snapshot_diff(const estate *thisptr, const dg_estate_snapshot *snapshot,
+                                       dg_alloc_state *allocator) {
+  dg_estate_diff diff;
+  diff.entities_count = 0;
+  diff.entities = dg_alloc_allocate(allocator, sizeof(dg_entity_diff) * snapshot->touched_count,
+                                    alignof(dg_entity_diff));
+
+  for (uint32_t i = 0; i < snapshot->touched_count; ++i) {
+    uint16_t ent_index = snapshot->touched[i];
+    const snapshot_edict *record = snapshot->edicts + ent_index;
+    const dg_edict *ent = thisptr->edicts + ent_index;
+    bool created = ent->exists && (!record->exists || record->recreated);
+    bool deleted = record->exists && (!ent->exists || record->recreated);
+
+    uint32_t flags = 0;
+    if (created) {
+      flags |= dg_entity_diff_created;
+    }
+    if (deleted) {
+      flags |= dg_entity_diff_deleted;
+    }
+    if (!created && !deleted && ent->exists && record->in_pvs != ent->in_pvs) {
+      flags |= ent->in_pvs ? dg_entity_diff_entered_pvs : dg_entity_diff_left_pvs;
+    }
+
+    uint32_t changed_count = 0;
+    if (ent->exists) {
+      changed_count = collect_changed_props(thisptr, record, ent, created, NULL);
+    }
+
+    if (flags == 0 && changed_count == 0) {
+      continue;
+    }
+
+    dg_entity_diff *entity = diff.entities + diff.entities_count++;
+    entity->ent_index = ent_index;
+    entity->flags = flags;
+    entity->changed_props_count = changed_count;
+    entity->changed_props = NULL;
+    if (changed_count > 0) {
+      entity->changed_props =
+          dg_alloc_allocate(allocator, sizeof(uint16_t) * changed_count, alignof(uint16_t));
+      collect_changed_props(thisptr, record, ent, created, entity->changed_props);
+    }
+  }
+
+  return diff;
+}
+
+typedef struct {
+  dg_prop_value_inner value; // Value before the change, only set if the prop existed
+  dg_sendprop *prop;
+  uint64_t prev; // Previous record of the same edict, not valid once it is older than the ring
+  int32_t tick;
+  uint16_t ent_index;
+  uint16_t prop_index;
+  bool existed;
+} history_record;
+
+// Undo log of prop changes, records live in a ring indexed by sequence number. Sequence numbers
+// start at 1 so that 0 is never a valid record.
+struct dg_estate_history {
+  history_record *records;
+  uint64_t records_first; // Oldest record still in the ring
+  uint64_t records_end;
+  size_t records_mask; // Capacity is a power of two
+  int32_t *ticks;      // Ring of the ticks that have records, oldest first
+  uint64_t *tick_first_record;
+  uint32_t max_ticks;
+  uint32_t ticks_start;
+  uint32_t ticks_count;
+  int32_t oldest_tick; // Values are known from the end of this tick onwards
+  uint64_t last_record[MAX_EDICTS];
+};
+
+static history_record *history_get_record(const dg_estate_history *history, uint64_t seq) {
+  return history->records + (seq & history->records_mask);
+}
+
+static void history_evict_tick(dg_estate_history *history) {
+  uint64_t end = history->ticks_count > 1
+                     ? history->tick_first_record[(history->ticks_start + 1) % history->max_ticks]
+                     : history->records_end;
+  for (uint64_t seq = history->records_first; seq < end; ++seq) {
+    history_record *record = history_get_record(history, seq);
+    if (record->existed) {
+      free_inner_value(&record->value, record->prop);
+    }
+  }
+
+  history->oldest_tick = history->ticks[history->ticks_start];
+  history->records_first = end;
+  history->ticks_start = (history->ticks_start + 1) % history->max_ticks;
+  --history->ticks_count;
+}
+
+static history_record *history_push_record(dg_estate_history *history, int32_t tick) {
+  uint32_t newest = (history->ticks_start + history->ticks_count - 1) % history->max_ticks;
+  // Ticks that go backwards are recorded at the newest tick so that the log stays ordered
+  if (history->ticks_count > 0 && tick <= history->ticks[newest]) {
+    tick = history->ticks[newest];
+  } else {
+    if (history->ticks_count == history->max_ticks) {
+      history_evict_tick(history);
+    }
+    uint32_t index = (history->ticks_start + history->ticks_count) % history->max_ticks;
+    history->ticks[index] = tick;
+    history->tick_first_record[index] = history->records_end;
+    ++history->ticks_count;
+  }
+
+  size_t capacity = history->records_mask + 1;
+  if (history->records_end - history->records_first == capacity) {
+    history_record *records = malloc(sizeof(history_record) * capacity * 2);
+    for (uint64_t seq = history->records_first; seq < history->records_end; ++seq) {
+      records[seq & (capacity * 2 - 1)] = *history_get_record(history, seq);
+    }
+    free(history->records);
+    history->records = records;
+    history->records_mask = capacity * 2 - 1;
+  }
+
+  history_record *record = history_get_record(history, history->records_end++);
+  record->tick = tick;
+  return record;
+}
+
+static void history_save_prop(estate *entity_state, const dg_edict *ent, uint16_t prop_index,
+                              const dg_prop_value_inner *current, bool newprop) {
+  dg_estate_history *history = entity_state->history;
+  uint16_t ent_index = ent - entity_state->edicts;
+  history_record *record = history_push_record(history, entity_state->tick);
+  record->prop = entity_state->class_datas[ent->datatable_id].props[prop_index];
+  record->ent_index = ent_index;
+  record->prop_index = prop_index;
+  record->existed = !newprop;
+  record->prev = history->last_record[ent_index];
+  history->last_record[ent_index] = history->records_end - 1;
+
+  if (!newprop) {
+    alloc_inner_value(&record->value, record->prop);
+    copy_into_prop(&record->value, current, record->prop);
+  }
+}
+
+// Called before the props of an edict are freed
+static void history_save_edict(estate *entity_state, const dg_edict *ent) {
+  if (!ent->exists) {
+    return;
+  }
+
+  for (dg_prop_value_inner *value = dg_eproparr_next(&ent->props, NULL); value;
+       value = dg_eproparr_next(&ent->props, value)) {
+    history_save_prop(entity_state, ent, value - ent->props.values, value, false);
+  }
+}
+
+dg_estate_history *dg_estate_history_create(estate *thisptr, uint32_t max_ticks) {
+  dg_estate_history_free(thisptr);
+  if (!thisptr->should_store_props || thisptr->edicts == NULL || max_ticks == 0) {
+    return NULL;
+  }
+
+  dg_estate_history *history = calloc(1, sizeof(dg_estate_history));
+  const size_t initial_capacity = 256;
+  history->records = malloc(sizeof(history_record) * initial_capacity);
+  history->records_mask = initial_capacity - 1;
+  history->records_first = history->records_end = 1;
+  history->ticks = malloc(sizeof(int32_t) * max_ticks);
+  history->tick_first_record = malloc(sizeof(uint64_t) * max_ticks);
+  history->max_ticks = max_ticks;
+  history->oldest_tick = thisptr->tick;
+  thisptr->history = history;
+  return history;
+}
+
+void dg_estate_history_free(estate *thisptr) {
+  dg_estate_history *history = thisptr->history;
+  if (history == NULL) {
+    return;
+  }
+
+  while (history->ticks_count > 0) {
+    history_evict_tick(history);
+  }
+  free(history->records);
+  free(history->ticks);
+  free(history->tick_first_record);
+  free(history);
+  thisptr->history = NULL;
+}
+
+static const dg_prop_value_inner *current_value(const estate *entity_state, uint32_t ent_index,
+                                                uint32_t prop_index) {
+  const dg_edict *ent = entity_state->edicts + ent_index;
+  if (!ent->exists || prop_index >= ent->props.prop_count || !ent->props.next_prop_indices ||
+      ent->props.next_prop_indices[prop_index + 1] == 0) {
+    return NULL;
+  }
+  return ent->props.values + prop_index;
+}
+
+static const dg_prop_value_inner *record_value(const history_record *record) {
+  return record->existed ? &record->value : NULL;
+}
+
+const dg_prop_value_inner *dg_estate_history_get(const estate *thisptr, uint32_t ent_index,
+                                                 uint32_t prop_index, int32_t tick) {
+  const dg_estate_history *history = thisptr->history;
+  if (history == NULL || ent_index >= MAX_EDICTS || tick < history->oldest_tick) {
+    return NULL;
+  }
+
+  // The first change after the tick has the value it had at the end of the tick
+  const history_record *found = NULL;
+  for (uint64_t seq = history->last_record[ent_index]; seq >= history->records_first;) {
+    const history_record *record = history_get_record(history, seq);
+    if (record->tick <= tick) {
+      break;
+    }
+    if (record->prop_index == prop_index) {
+      found = record;
+    }
+    seq = record->prev;
+  }
+
+  return found ? record_value(found) : current_value(thisptr, ent_index, prop_index);
+}
+
+dg_prop_history dg_estate_history_range(const estate *thisptr, uint32_t ent_index,
+                                        uint32_t prop_index, int32_t first_tick,
+                                        int32_t last_tick, dg_alloc_state *allocator) {
+  dg_prop_history output;
+  memset(&output, 0, sizeof(output));
+  const dg_estate_history *history = thisptr->history;
+  if (history == NULL || ent_index >= MAX_EDICTS || first_tick < history->oldest_tick ||
+      last_tick < first_tick) {
+    return output;
+  }
+
+  size_t count = 0;
+  for (uint64_t seq = history->last_record[ent_index]; seq >= history->records_first;) {
+    const history_record *record = history_get_record(history, seq);
+    if (record->tick <= first_tick) {
+      break;
+    }
+    count += record->prop_index == prop_index;
+    seq = record->prev;
+  }
+
+  // Changes of the prop after first_tick, oldest first
+  const history_record **changes =
+      dg_alloc_allocate(allocator, sizeof(history_record *) * (count + 1), alignof(history_record *));
+  size_t index = count;
+  for (uint64_t seq = history->last_record[ent_index]; index > 0;) {
+    const history_record *record = history_get_record(history, seq);
+    if (record->prop_index == prop_index) {
+      changes[--index] = record;
+    }
+    seq = record->prev;
+  }
+
+  output.entries = dg_alloc_allocate(allocator, sizeof(dg_prop_history_entry) * (count + 1),
+                                     alignof(dg_prop_history_entry));
+  output.entries[0].tick = first_tick;
+  output.entries[0].value =
+      count > 0 ? record_value(changes[0]) : current_value(thisptr, ent_index, prop_index);
+  output.entries_count = 1;
+
+  for (size_t i = 0; i < count && changes[i]->tick <= last_tick;) {
+    int32_t tick = changes[i]->tick;
+    // Only the first change within a tick has the value from before the tick
+    while (i < count && changes[i]->tick == tick) {
+      ++i;
+    }
+
+    dg_prop_history_entry *entry = output.entries + output.entries_count++;
+    entry->tick = tick;
+    entry->value = i < count ? record_value(changes[i]) : current_value(thisptr, ent_index, prop_index);
+  }
+
+  return output;
+}
+
 #ifdef DEMOGOBBLER_USE_LINKED_LIST_PROPS
-static void update_props(dg_edict *ent, const dg_ent_update *update, dg_serverclass_data *data) {
+static void update_props(estate *entity_state, dg_edict *ent, const dg_ent_update *update,
+                         dg_serverclass_data *data) {
   dg_epropnode *node = NULL;
   for (size_t i = 0; i < update->prop_value_array_size; ++i) {
     const prop_value *value = update->prop_value_array + i;
@@ -659,23 +1376,73 @@ static void update_props(dg_edict *ent, const dg_ent_update *update, dg_servercl
   }
 }
 #else
-static dg_prop_value_inner *getinsert_prop(dg_edict *ent, uint16_t index, dg_sendprop *prop) {
-  bool newprop;
-  dg_prop_value_inner *value = dg_eproparr_get(&ent->props, index, &newprop);
+static dg_prop_value_inner *getinsert_prop(dg_edict *ent, uint16_t index, dg_sendprop *prop,
+                                           bool *newprop) {
+  dg_prop_value_inner *value = dg_eproparr_get(&ent->props, index, newprop);
 
-  if (newprop) {
+  if (*newprop) {
     alloc_inner_value(value, prop);
   }
 
   return value;
 }
 
-static void update_props(dg_edict *ent, const dg_ent_update *update, dg_serverclass_data *data) {
+static void update_prop(estate *entity_state, dg_edict *ent, const prop_value *value,
+                        dg_serverclass_data *data) {
+  const bool track_changes = ent->changed_props != NULL;
+  dg_sendprop *prop = data->props[value->prop_index];
+  bool newprop;
+  dg_prop_value_inner *dest = getinsert_prop(ent, value->prop_index, prop, &newprop);
+  if (track_changes || entity_state->history) {
+    if (newprop || !prop_value_equal(dest, &value->value, prop)) {
+      if (track_changes) {
+        mark_changed(entity_state, ent, value->prop_index);
+      }
+      if (entity_state->history) {
+        history_save_prop(entity_state, ent, value->prop_index, dest, newprop);
+      }
+    }
+  }
+  if (entity_state->snapshots) {
+    snapshot_save_prop(entity_state, ent, value->prop_index, dest, newprop);
+  }
+  copy_into_prop(dest, &value->value, prop);
+}
+
+static void update_props(estate *entity_state, dg_edict *ent, const dg_ent_update *update,
+                         dg_serverclass_data *data) {
   for (size_t i = 0; i < update->prop_value_array_size; ++i) {
-    const prop_value *value = update->prop_value_array + i;
-    dg_sendprop* prop = data->props + value->prop_index;
-    dg_prop_value_inner *dest = getinsert_prop(ent, prop - data->props, prop);
-    copy_into_prop(dest, value, prop);
+    update_prop(entity_state, ent, update->prop_value_array + i, data);
+  }
+}
+
+// Applies the baseline with the update on top of it in one pass, so that every prop is compared
+// against the value it had before the message. Both arrays are sorted by prop index.
+static void update_props_with_baseline(estate *entity_state, dg_edict *ent,
+                                       const dg_ent_update *baseline, const dg_ent_update *update,
+                                       dg_serverclass_data *data) {
+  size_t baseline_i = 0;
+  size_t update_i = 0;
+  while (baseline_i < baseline->prop_value_array_size ||
+         update_i < update->prop_value_array_size) {
+    const prop_value *baseline_value = NULL;
+    const prop_value *update_value = NULL;
+    if (baseline_i < baseline->prop_value_array_size)
+      baseline_value = baseline->prop_value_array + baseline_i;
+    if (update_i < update->prop_value_array_size)
+      update_value = update->prop_value_array + update_i;
+
+    if (update_value == NULL ||
+        (baseline_value && baseline_value->prop_index < update_value->prop_index)) {
+      update_prop(entity_state, ent, baseline_value, data);
+      ++baseline_i;
+    } else {
+      if (baseline_value && baseline_value->prop_index == update_value->prop_index) {
+        ++baseline_i; // The update overrides the baseline value
+      }
+      update_prop(entity_state, ent, update_value, data);
+      ++update_i;
+    }
   }
 }
 #endif
@@ -683,6 +1450,11 @@ static void update_props(dg_edict *ent, const dg_ent_update *update, dg_servercl
 dg_parse_result dg_estate_update(estate *entity_state, const dg_packetentities_data *data) {
   dg_parse_result result = {0};
   bool should_store_props = entity_state->should_store_props;
+  bool track_changes = should_store_props && entity_state->track_changed_props;
+
+  if (track_changes) {
+    clear_changed(entity_state);
+  }
 
   for (size_t i = 0; i < data->ent_updates_count; ++i) {
     const dg_ent_update *update = data->ent_updates + i;
@@ -694,25 +1466,38 @@ dg_parse_result dg_estate_update(estate *entity_state, const dg_packetentities_d
     }
 
     dg_edict *ent = entity_state->edicts + update->ent_index;
+    if (entity_state->snapshots) {
+      snapshot_touch(entity_state, update->ent_index);
+    }
+
     if (update->update_type == 2) {
       dg_serverclass_data *data = entity_state->class_datas + update->datatable_id;
       if (should_store_props) {
         bool init_props = false;
         if (ent->exists && ent->datatable_id != update->datatable_id) {
           // game pulled a fast one, existing entity enters pvs with a new datatable???
+          if (entity_state->history) {
+            history_save_edict(entity_state, ent);
+          }
           free_props(ent, entity_state->class_datas + ent->datatable_id);
-          memset(ent, 0, sizeof(dg_edict));
+          clear_edict(ent);
           init_props = true;
         } else if (!ent->exists) {
           init_props = true;
         }
 
         if (init_props) {
+          if (entity_state->snapshots) {
+            snapshot_recreate(entity_state, update->ent_index);
+          }
 #ifdef DEMOGOBBLER_USE_LINKED_LIST_PROPS
           ent->props = dg_eproplist_init();
 #else
           ent->props = dg_eproparr_init(data->prop_count);
 #endif
+          if (track_changes) {
+            ent->changed_props = calloc((data->prop_count + 63) / 64, sizeof(uint64_t));
+          }
         }
       }
 
@@ -724,31 +1509,54 @@ dg_parse_result dg_estate_update(estate *entity_state, const dg_packetentities_d
       ent->in_pvs = true;
 
       if (should_store_props) {
-        update_props(ent, update, data);
+        // The delta in the update is relative to the baseline of the class
+        const dg_ent_update *baseline =
+            dg_baseline_cache_get(entity_state->instancebaselines, update->datatable_id);
+#ifdef DEMOGOBBLER_USE_LINKED_LIST_PROPS
+        if (baseline) {
+          update_props(entity_state, ent, baseline, data);
+        }
+        update_props(entity_state, ent, update, data);
+#else
+        if (baseline) {
+          update_props_with_baseline(entity_state, ent, baseline, update, data);
+        } else {
+          update_props(entity_state, ent, update, data);
+        }
+#endif
       }
     } else if (update->update_type == 0) {
       // Delta
       if (should_store_props) {
-        update_props(ent, update, entity_state->class_datas + ent->datatable_id);
+        update_props(entity_state, ent, update, entity_state->class_datas + ent->datatable_id);
       }
     } else if (update->update_type == 1) {
       // Leave PVS
       ent->in_pvs = false;
     } else if (update->update_type == 3) {
       if (should_store_props) {
+        if (entity_state->history) {
+          history_save_edict(entity_state, ent);
+        }
         free_props(ent, entity_state->class_datas + ent->datatable_id);
       }
-      memset(ent, 0, sizeof(dg_edict));
+      clear_edict(ent);
     }
   }
 
   for (size_t i = 0; i < data->explicit_deletes_count; ++i) {
     dg_edict *ent = entity_state->edicts + data->explicit_deletes[i];
+    if (entity_state->snapshots) {
+      snapshot_touch(entity_state, data->explicit_deletes[i]);
+    }
     dg_serverclass_data *data = entity_state->class_datas + ent->datatable_id;
     if (should_store_props) {
+      if (entity_state->history) {
+        history_save_edict(entity_state, ent);
+      }
       free_props(ent, data);
     }
-    memset(ent, 0, sizeof(dg_edict));
+    clear_edict(ent);
     ent->explicitly_deleted = true;
   }
 
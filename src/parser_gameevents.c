@@ -0,0 +1,245 @@
+#include "parser_gameevents.h"
+#include "demogobbler/alignof_wrapper.h"
+#include "demogobbler/allocator.h"
+#include "demogobbler/hashtable.h"
+#include <string.h>
+
+enum { GAME_EVENT_ID_BITS = 9, GAME_EVENT_KEY_TYPE_BITS = 3, GAME_EVENT_STRING_MAX = 1024 };
+
+static void skip_descriptor(dg_bitstream *stream, uint32_t *event_id, size_t *key_count) {
+  char buffer[GAME_EVENT_STRING_MAX];
+  *event_id = dg_bitstream_read_uint(stream, GAME_EVENT_ID_BITS);
+  dg_bitstream_read_cstring(stream, buffer, sizeof(buffer));
+
+  *key_count = 0;
+  while (dg_bitstream_read_uint(stream, GAME_EVENT_KEY_TYPE_BITS) != dg_gekey_local &&
+         !stream->overflow) {
+    dg_bitstream_read_cstring(stream, buffer, sizeof(buffer));
+    ++*key_count;
+  }
+}
+
+static const char *copy_string(dg_alloc_state *allocator, const char *str, size_t bytes) {
+  char *dest = dg_alloc_allocate(allocator, bytes, 1);
+  memcpy(dest, str, bytes);
+  return dest;
+}
+
+static const char *intern_string(dg_hashtable *table, dg_alloc_state *allocator, const char *str,
+                                 size_t bytes) {
+  dg_hashtable_entry entry = dg_hashtable_get(table, str);
+  if (entry.str == NULL) {
+    entry.str = copy_string(allocator, str, bytes);
+    dg_hashtable_insert(table, entry);
+  }
+  return entry.str;
+}
+
+dg_parse_result dg_parse_game_event_list(dg_game_event_list *out,
+                                         const dg_game_event_list_parse_args *args) {
+  dg_parse_result result;
+  memset(&result, 0, sizeof(result));
+  memset(out, 0, sizeof(*out));
+
+  // First pass figures out how much memory the compiled list needs so that all descriptors and
+  // keys end up in two flat arrays
+  dg_bitstream stream = args->stream;
+  size_t total_keys = 0;
+  uint32_t max_event_id = 0;
+
+  for (uint32_t i = 0; i < args->events && !stream.overflow; ++i) {
+    uint32_t event_id;
+    size_t key_count;
+    skip_descriptor(&stream, &event_id, &key_count);
+    total_keys += key_count;
+    if (event_id > max_event_id)
+      max_event_id = event_id;
+  }
+
+  if (stream.overflow) {
+    result.error = true;
+    result.error_message = "Overflowed during game event list parsing";
+    return result;
+  }
+
+  out->descriptor_count = args->events > 0 ? max_event_id + 1 : 0;
+  out->descriptors =
+      dg_alloc_allocate(args->allocator, out->descriptor_count * sizeof(dg_game_event_descriptor),
+                        alignof(dg_game_event_descriptor));
+  memset(out->descriptors, 0, out->descriptor_count * sizeof(dg_game_event_descriptor));
+  dg_game_event_descriptor_key *keys =
+      dg_alloc_allocate(args->allocator, total_keys * sizeof(dg_game_event_descriptor_key),
+                        alignof(dg_game_event_descriptor_key));
+
+  // Many events share key names like "userid", intern them so comparing names is a pointer compare
+  dg_hashtable interned = dg_hashtable_create(total_keys);
+  char buffer[GAME_EVENT_STRING_MAX];
+  stream = args->stream;
+
+  for (uint32_t i = 0; i < args->events; ++i) {
+    uint32_t event_id = dg_bitstream_read_uint(&stream, GAME_EVENT_ID_BITS);
+    dg_game_event_descriptor *descriptor = out->descriptors + event_id;
+    size_t bytes = dg_bitstream_read_cstring(&stream, buffer, sizeof(buffer));
+
+    descriptor->event_id = event_id;
+    descriptor->name = copy_string(args->allocator, buffer, bytes);
+    descriptor->keys = keys;
+    descriptor->key_count = 0;
+    descriptor->subscribed = true;
+
+    uint32_t type;
+    while ((type = dg_bitstream_read_uint(&stream, GAME_EVENT_KEY_TYPE_BITS)) != dg_gekey_local) {
+      bytes = dg_bitstream_read_cstring(&stream, buffer, sizeof(buffer));
+      keys->type = type;
+      keys->key_value = intern_string(&interned, args->allocator, buffer, bytes);
+      ++keys;
+      ++descriptor->key_count;
+    }
+  }
+
+  dg_hashtable_free(&interned);
+
+  return result;
+}
+
+dg_parse_result dg_parse_game_event(dg_game_event_parsed *out,
+                                    const dg_game_event_parse_args *args) {
+  dg_parse_result result;
+  memset(&result, 0, sizeof(result));
+  memset(out, 0, sizeof(*out));
+
+  dg_bitstream stream = args->stream;
+  uint32_t event_id = dg_bitstream_read_uint(&stream, GAME_EVENT_ID_BITS);
+
+  // Servers can send events that are missing from the list, those are skipped instead of failing
+  // the whole demo
+  if (event_id >= args->list->descriptor_count ||
+      args->list->descriptors[event_id].name == NULL) {
+    return result;
+  }
+
+  const dg_game_event_descriptor *descriptor = args->list->descriptors + event_id;
+  out->descriptor = descriptor;
+
+  if (!descriptor->subscribed) {
+    return result;
+  }
+
+  // Strings can't be longer than what's left in the stream, so values and strings share a single
+  // allocation
+  const size_t values_bytes = descriptor->key_count * sizeof(dg_game_event_value);
+  const size_t strings_bytes = dg_bitstream_bits_left(&stream) / 8 + 1;
+  out->values = dg_alloc_allocate(args->allocator, values_bytes + strings_bytes,
+                                  alignof(dg_game_event_value));
+  char *strings = (char *)out->values + values_bytes;
+  size_t strings_left = strings_bytes;
+
+  for (size_t i = 0; i < descriptor->key_count; ++i) {
+    dg_game_event_value *value = out->values + i;
+    switch (descriptor->keys[i].type) {
+    case dg_gekey_string: {
+      size_t bytes = dg_bitstream_read_cstring(&stream, strings, strings_left);
+      value->str_val = strings;
+      strings += bytes;
+      strings_left -= bytes;
+      break;
+    }
+    case dg_gekey_float:
+      value->float_val = dg_bitstream_read_float(&stream);
+      break;
+    case dg_gekey_long:
+      value->int_val = dg_bitstream_read_sint32(&stream);
+      break;
+    case dg_gekey_short:
+      value->int_val = dg_bitstream_read_sint(&stream, 16);
+      break;
+    case dg_gekey_byte:
+      value->int_val = dg_bitstream_read_uint(&stream, 8);
+      break;
+    case dg_gekey_bool:
+      value->bool_val = dg_bitstream_read_bit(&stream);
+      break;
+    case dg_gekey_uint64:
+      value->uint64_val = dg_bitstream_read_uint(&stream, 64);
+      break;
+    default:
+      memset(value, 0, sizeof(*value));
+      break;
+    }
+  }
+
+  if (stream.overflow) {
+    result.error = true;
+    result.error_message = "Overflowed during game event parsing";
+  }
+
+  return result;
+}
+
+const dg_game_event_descriptor *dg_game_event_list_find(const dg_game_event_list *list,
+                                                        const char *name) {
+  for (uint32_t i = 0; i < list->descriptor_count; ++i) {
+    const dg_game_event_descriptor *descriptor = list->descriptors + i;
+    if (descriptor->name && strcmp(descriptor->name, name) == 0) {
+      return descriptor;
+    }
+  }
+
+  return NULL;
+}
+
+int dg_game_event_find_key(const dg_game_event_descriptor *descriptor, const char *name) {
+  for (size_t i = 0; i < descriptor->key_count; ++i) {
+    if (strcmp(descriptor->keys[i].key_value, name) == 0) {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+void dg_parser_handle_game_event_list(dg_parser *thisptr, struct dg_svc_game_event_list *message) {
+  dg_game_event_list_parse_args args;
+  args.allocator = dg_parser_perm_allocator(thisptr);
+  args.stream = message->data;
+  args.events = message->events;
+
+  dg_parse_result result = dg_parse_game_event_list(&thisptr->game_events, &args);
+
+  if (result.error) {
+    thisptr->error = true;
+    thisptr->error_message = result.error_message;
+  } else {
+    message->parsed = &thisptr->game_events;
+    if (thisptr->m_settings.game_event_list_handler) {
+      thisptr->m_settings.game_event_list_handler(&thisptr->state, &thisptr->game_events);
+    }
+  }
+}
+
+void dg_parser_handle_game_event(dg_parser *thisptr, struct dg_svc_game_event *message) {
+  // Can't decode anything before the event list has been seen
+  if (thisptr->game_events.descriptors == NULL) {
+    return;
+  }
+
+  dg_game_event_parse_args args;
+  args.allocator = dg_parser_packet_allocator(thisptr);
+  args.list = &thisptr->game_events;
+  args.stream = message->data;
+
+  dg_game_event_parsed parsed;
+  dg_parse_result result = dg_parse_game_event(&parsed, &args);
+
+  if (result.error) {
+    thisptr->error = true;
+    thisptr->error_message = result.error_message;
+  } else if (parsed.values) {
+    message->parsed =
+        dg_alloc_allocate(args.allocator, sizeof(parsed), alignof(dg_game_event_parsed));
+    *message->parsed = parsed;
+    if (thisptr->m_settings.game_event_handler) {
+      thisptr->m_settings.game_event_handler(&thisptr->state, message->parsed);
+    }
+  }
+}
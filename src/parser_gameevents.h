@@ -0,0 +1,7 @@
+#pragma once
+
+#include "demogobbler.h"
+#include "demogobbler/parser.h"
+
+void dg_parser_handle_game_event_list(dg_parser *thisptr, struct dg_svc_game_event_list *message);
+void dg_parser_handle_game_event(dg_parser *thisptr, struct dg_svc_game_event *message);
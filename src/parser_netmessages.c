@@ -2,7 +2,9 @@
 #include "demogobbler/allocator.h"
 #include "demogobbler/bitstream.h"
 #include "demogobbler/bitwriter.h"
+#include "parser_gameevents.h"
 #include "parser_packetentities.h"
+#include "parser_usermessages.h"
 #include "demogobbler/utils.h"
 #include "demogobbler/vector_array.h"
 #include "demogobbler/version_utils.h"
@@ -425,6 +427,12 @@ static void handle_svc_create_stringtable(dg_parser *thisptr, dg_bitstream *stre
   thisptr->error = result.error;
   thisptr->error_message = result.error_message;
 
+  if (!result.error && thisptr->m_settings.parse_packetentities &&
+      strcmp(ptr->name, "instancebaseline") == 0) {
+    dg_parser_create_instancebaselines(thisptr, thisptr->state.stringtables_count - 1,
+                                       &ptr->stringtable);
+  }
+
   SEND_MESSAGE();
 }
 
@@ -493,6 +501,11 @@ static void handle_svc_update_stringtable(dg_parser *thisptr, dg_bitstream *stre
     dg_parse_result result = dg_parse_stringtable_entry(&args, &ptr->parsed_sentry);
     thisptr->error = result.error;
     thisptr->error_message = result.error_message;
+
+    const dg_baseline_cache *baselines = &thisptr->state.instancebaselines;
+    if (!result.error && baselines->exists && baselines->table_id == ptr->table_id) {
+      dg_parser_update_instancebaselines(thisptr, &ptr->parsed_sentry);
+    }
   }
 
   SEND_MESSAGE();
@@ -676,6 +689,10 @@ static void handle_svc_user_message(dg_parser *thisptr, dg_bitstream *stream,
   ptr->msg_type = dg_bitstream_read_uint(stream, 8);
   ptr->length = dg_bitstream_read_uint(stream, thisptr->demo_version.svc_user_message_bits);
   ptr->data = dg_bitstream_fork_and_advance(stream, ptr->length);
+
+  if (thisptr->m_settings.user_message_handler) {
+    dg_parser_handle_user_message(thisptr, ptr);
+  }
   SEND_MESSAGE();
 }
 
@@ -712,6 +729,10 @@ static void handle_svc_game_event(dg_parser *thisptr, dg_bitstream *stream,
   ptr->length = dg_bitstream_read_uint(stream, 11);
   ptr->data = dg_bitstream_fork_and_advance(stream, ptr->length);
 
+  if (thisptr->m_settings.game_event_handler) {
+    dg_parser_handle_game_event(thisptr, ptr);
+  }
+
   SEND_MESSAGE();
 }
 
@@ -778,6 +799,10 @@ static void handle_svc_temp_entities(dg_parser *thisptr, dg_bitstream *stream,
   }
   ptr->data = dg_bitstream_fork_and_advance(stream, data_length);
 
+  if (thisptr->m_settings.temp_entities_parsed_handler) {
+    dg_parser_handle_temp_entities(thisptr, ptr);
+  }
+
   SEND_MESSAGE();
 }
 
@@ -831,6 +856,10 @@ static void handle_svc_game_event_list(dg_parser *thisptr, dg_bitstream *stream,
   ptr->events = dg_bitstream_read_uint(stream, 9);
   ptr->length = dg_bitstream_read_uint(stream, 20);
   ptr->data = dg_bitstream_fork_and_advance(stream, ptr->length);
+
+  if (thisptr->m_settings.game_event_handler || thisptr->m_settings.game_event_list_handler) {
+    dg_parser_handle_game_event_list(thisptr, ptr);
+  }
   SEND_MESSAGE();
 }
 
@@ -931,15 +960,9 @@ static net_message_type version_get_message_type(dg_parser *thisptr, unsigned in
 
 void dg_bitwriter_write_netmessage(dg_bitwriter *writer, dg_demver_data *version,
                                    packet_net_message *message) {
-  int type_out = -1;
   // Don't use the type index directly, we want to support writing to different protocols than the
   // demo was read
-  for (int i = 0; i < version->netmessage_count; ++i) {
-    if (version->netmessage_array[i] == message->mtype) {
-      type_out = i;
-      break;
-    }
-  }
+  int type_out = message->mtype < svc_invalid ? version->netmessage_ids[message->mtype] : -1;
 
 #define DECLARE_SWITCH_STATEMENT(message_type)                                                     \
   case message_type:                                                                               \
@@ -961,6 +984,57 @@ void dg_bitwriter_write_netmessage(dg_bitwriter *writer, dg_demver_data *version
 #undef DECLARE_SWITCH_STATEMENT
 }
 
+bool sniff_l4d2_version(dg_parser *thisptr, dg_packet *packet) {
+  dg_bitstream stream = dg_bitstream_create(packet->data, packet->size_bytes * 8);
+  dg_alloc_state *arena = dg_parser_packet_allocator(thisptr);
+  blk scrap_blk;
+  scrap_blk.address = dg_alloc_allocate(arena, packet->size_bytes, 1);
+  scrap_blk.size = packet->size_bytes;
+  unsigned int bits = thisptr->demo_version.netmessage_type_bits;
+
+  if (scrap_blk.address == NULL) {
+    return false;
+  }
+
+  // The build is printed by the server before any of the heavier signon messages, so only the
+  // cheap messages that can come before it are read through
+  while (dg_bitstream_bits_left(&stream) > bits && !thisptr->error && !stream.overflow) {
+    unsigned int type_index = dg_bitstream_read_uint(&stream, bits);
+    net_message_type type = version_get_message_type(thisptr, type_index);
+    packet_net_message message;
+    memset(&message, 0, sizeof(message));
+    message.mtype = type;
+
+    switch (type) {
+    case net_nop:
+      break;
+    case net_tick:
+      handle_net_tick(thisptr, &stream, &message, &scrap_blk);
+      break;
+    case net_stringcmd:
+      handle_net_stringcmd(thisptr, &stream, &message, &scrap_blk);
+      break;
+    case net_setconvar:
+      handle_net_setconvar(thisptr, &stream, &message, &scrap_blk);
+      break;
+    case net_signonstate:
+      handle_net_signonstate(thisptr, &stream, &message, &scrap_blk);
+      break;
+    case svc_print:
+      handle_svc_print(thisptr, &stream, &message, &scrap_blk);
+      // Only the first print has the build in it
+      if (!stream.overflow && !thisptr->demo_version.l4d2_version_finalized) {
+        dg_parser_update_l4d2_version(thisptr, thisptr->demo_version.l4d2_version);
+      }
+      return !stream.overflow;
+    default:
+      return false;
+    }
+  }
+
+  return false;
+}
+
 void parse_netmessages(dg_parser *thisptr, dg_packet *packet) {
 #ifdef DEBUG
 #define MAX_HISTORY 256
@@ -972,6 +1046,7 @@ void parse_netmessages(dg_parser *thisptr, dg_packet *packet) {
   size_t size = packet->size_bytes;
   dg_bitstream stream = dg_bitstream_create(data, size * 8);
   // fprintf(stderr, "packet start:\n");
+  thisptr->state.entity_state.tick = packet->preamble.tick;
 
   // We allocate a single scrap buffer for the duration of parsing the packet that is as large as
   // the whole packet. Should never run out of space as long as we don't make things larger as we
@@ -3,3 +3,6 @@
 #include "demogobbler/parser.h"
 
 void parse_netmessages(dg_parser *thisptr, dg_packet *packet);
+// Looks for the build number of protocol 2042 L4D2 demos without decoding the whole packet.
+// Returns false if the packet had to be parsed fully to find it.
+bool sniff_l4d2_version(dg_parser *thisptr, dg_packet *packet);
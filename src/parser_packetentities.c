@@ -7,6 +7,7 @@
 #include "parser_entity_state.h"
 #include "demogobbler/utils.h"
 #include "demogobbler/vector_array.h"
+#include <stdio.h>
 #include <string.h>
 
 #ifdef DEBUG_BREAK_PROP
@@ -24,129 +25,166 @@ struct prop_parse_state {
   dg_vector_array prop_array;
   const char* error_message;
   bool error;
+  bool skip_props; // Read through the props without storing them
 };
 
 typedef struct prop_parse_state prop_parse_state;
 
-static prop_value read_prop(prop_parse_state *state, dg_sendprop *props, dg_sendprop* prop);
+static void read_value(prop_parse_state *state, const dg_flatprop *prop,
+                       const dg_sendprop *sendprop, dg_prop_value_inner *value);
 static void write_prop(dg_bitwriter *writer, dg_prop_value_inner value);
 
-static void write_int(dg_bitwriter *thisptr, dg_prop_value_inner value) {
-  if (value.type == dg_int_varuint32) {
-    dg_bitwriter_write_varuint32(thisptr, value.unsigned_val);
-  } else if (value.type == dg_int_unsigned) {
-    dg_bitwriter_write_uint(thisptr, value.unsigned_val, value.prop_numbits);
+// Encoding of int and float values only depends on the type resolved from the sendprop flags
+// when the serverclass was flattened, so each type gets its own writer instead of branching on
+// the flags again for every value
+typedef void (*scalar_writer)(dg_bitwriter *thisptr, dg_prop_value_inner value);
+
+static void write_int_varuint32(dg_bitwriter *thisptr, dg_prop_value_inner value) {
+  dg_bitwriter_write_varuint32(thisptr, value.unsigned_val);
+}
+
+static void write_uint(dg_bitwriter *thisptr, dg_prop_value_inner value) {
+  dg_bitwriter_write_uint(thisptr, value.unsigned_val, value.prop_numbits);
+}
+
+static void write_int_signed(dg_bitwriter *thisptr, dg_prop_value_inner value) {
+  dg_bitwriter_write_sint(thisptr, value.signed_val, value.prop_numbits);
+}
+
+static void write_float_bitcoord(dg_bitwriter *thisptr, dg_prop_value_inner value) {
+  dg_bitwriter_write_bitcoord(thisptr, value.bitcoord_val);
+}
+
+static void write_float_bitcoordmp(dg_bitwriter *thisptr, dg_prop_value_inner value) {
+  dg_bitwriter_write_bitcoordmp(thisptr, value.bitcoordmp_val, false, false);
+}
+
+static void write_float_bitcoordmplp(dg_bitwriter *thisptr, dg_prop_value_inner value) {
+  dg_bitwriter_write_bitcoordmp(thisptr, value.bitcoordmp_val, false, true);
+}
+
+static void write_float_bitcoordmpint(dg_bitwriter *thisptr, dg_prop_value_inner value) {
+  dg_bitwriter_write_bitcoordmp(thisptr, value.bitcoordmp_val, true, false);
+}
+
+static void write_float_noscale(dg_bitwriter *thisptr, dg_prop_value_inner value) {
+  dg_bitwriter_write_float(thisptr, value.float_val);
+}
+
+static void write_float_bitnormal(dg_bitwriter *thisptr, dg_prop_value_inner value) {
+  dg_bitwriter_write_bitnormal(thisptr, value.bitnormal_val);
+}
+
+static void write_float_bitcellcoord(dg_bitwriter *thisptr, dg_prop_value_inner value) {
+  dg_bitwriter_write_bitcellcoord(thisptr, value.bitcellcoord_val, false, false,
+                                  value.prop_numbits);
+}
+
+static void write_float_bitcellcoordlp(dg_bitwriter *thisptr, dg_prop_value_inner value) {
+  dg_bitwriter_write_bitcellcoord(thisptr, value.bitcellcoord_val, false, true,
+                                  value.prop_numbits);
+}
+
+static void write_float_bitcellcoordint(dg_bitwriter *thisptr, dg_prop_value_inner value) {
+  dg_bitwriter_write_bitcellcoord(thisptr, value.bitcellcoord_val, true, false,
+                                  value.prop_numbits);
+}
+
+static const scalar_writer scalar_writers[] = {
+    [dg_float_bitcoord] = write_float_bitcoord,
+    [dg_float_bitcoordmp] = write_float_bitcoordmp,
+    [dg_float_bitcellcoord] = write_float_bitcellcoord,
+    [dg_float_bitnormal] = write_float_bitnormal,
+    [dg_float_noscale] = write_float_noscale,
+    [dg_float_bitcoordmplp] = write_float_bitcoordmplp,
+    [dg_float_bitcoordmpint] = write_float_bitcoordmpint,
+    [dg_float_bitcellcoordlp] = write_float_bitcellcoordlp,
+    [dg_float_bitcellcoordint] = write_float_bitcellcoordint,
+    [dg_float_unsigned] = write_uint,
+    [dg_int_varuint32] = write_int_varuint32,
+    [dg_int_unsigned] = write_uint,
+    [dg_int_signed] = write_int_signed,
+};
+
+static void write_scalar(dg_bitwriter *thisptr, dg_prop_value_inner value) {
+  if (value.type < ARRAYSIZE(scalar_writers)) {
+    scalar_writers[value.type](thisptr, value);
   } else {
-    dg_bitwriter_write_sint(thisptr, value.signed_val, value.prop_numbits);
+    thisptr->error = true;
+    thisptr->error_message = "Unknown value type for write_prop";
   }
 }
 
-static void read_int(prop_parse_state *state, dg_sendprop *prop, dg_prop_value_inner *value) {
+static void read_int(prop_parse_state *state, const dg_flatprop *prop, dg_prop_value_inner *value) {
   value->prop_numbits = prop->prop_numbits;
-  if (prop->flag_normal) {
-    value->type = dg_int_varuint32;
+  value->type = prop->type;
+  if (prop->type == dg_int_varuint32) {
     value->unsigned_val = dg_bitstream_read_varuint32(state->stream);
-  } else if (prop->flag_unsigned) {
-    value->type = dg_int_unsigned;
+  } else if (prop->type == dg_int_unsigned) {
     value->unsigned_val = dg_bitstream_read_uint(state->stream, prop->prop_numbits);
   } else {
-    value->type = dg_int_signed;
     value->signed_val = dg_bitstream_read_sint(state->stream, prop->prop_numbits);
   }
 }
 
-static void write_float(dg_bitwriter *thisptr, dg_prop_value_inner value) {
-  switch(value.type)
-  {
-    case dg_float_bitcoord:
-      dg_bitwriter_write_bitcoord(thisptr, value.bitcoord_val);
-      break;
-    case dg_float_bitcoordmp:
-      dg_bitwriter_write_bitcoordmp(thisptr, value.bitcoordmp_val, false, false);
-      break;
-    case dg_float_bitcoordmplp:
-      dg_bitwriter_write_bitcoordmp(thisptr, value.bitcoordmp_val, false, true);
-      break;
-    case dg_float_bitcoordmpint:
-      dg_bitwriter_write_bitcoordmp(thisptr, value.bitcoordmp_val, true, false);
-      break;
-    case dg_float_noscale:
-      dg_bitwriter_write_float(thisptr, value.float_val);
-      break;
-    case dg_float_bitnormal:
-      dg_bitwriter_write_bitnormal(thisptr, value.bitnormal_val);
-      break;
-    case dg_float_bitcellcoord:
-      dg_bitwriter_write_bitcellcoord(thisptr, value.bitcellcoord_val, false, false,
-                                      value.prop_numbits);
-      break;
-    case dg_float_bitcellcoordlp:
-      dg_bitwriter_write_bitcellcoord(thisptr, value.bitcellcoord_val, false, true,
-                                    value.prop_numbits);
-      break;
-    case dg_float_bitcellcoordint:
-      dg_bitwriter_write_bitcellcoord(thisptr, value.bitcellcoord_val, true, false,
-                                    value.prop_numbits);
-      break;
-    case dg_float_unsigned:
-      dg_bitwriter_write_uint(thisptr, value.unsigned_val, value.prop_numbits);
-      break;
-
-  }
-}
-
-static void read_float(prop_parse_state *state, dg_sendprop *prop, dg_prop_value_inner *value) {
+static void read_float(prop_parse_state *state, const dg_flatprop *prop,
+                       dg_prop_value_inner *value) {
   dg_bitstream *stream = state->stream;
   value->prop_numbits = prop->prop_numbits;
-  if (prop->flag_coord) {
-    value->type = dg_float_bitcoord;
+  value->type = prop->type;
+
+  switch (prop->type) {
+  case dg_float_bitcoord:
     value->bitcoord_val = dg_bitstream_read_bitcoord(stream);
-  } else if (prop->flag_coordmp) {
-    value->type = dg_float_bitcoordmp;
+    break;
+  case dg_float_bitcoordmp:
     value->bitcoordmp_val = dg_bitstream_read_bitcoordmp(stream, false, false);
-  } else if (prop->flag_coordmplp) {
-    value->type = dg_float_bitcoordmplp;
+    break;
+  case dg_float_bitcoordmplp:
     value->bitcoordmp_val = dg_bitstream_read_bitcoordmp(stream, false, true);
-  } else if (prop->flag_coordmpint) {
-    value->type = dg_float_bitcoordmpint;
+    break;
+  case dg_float_bitcoordmpint:
     value->bitcoordmp_val = dg_bitstream_read_bitcoordmp(stream, true, false);
-  } else if (prop->flag_noscale) {
-    value->type = dg_float_noscale;
+    break;
+  case dg_float_noscale:
     value->float_val = dg_bitstream_read_float(stream);
-  } else if (prop->flag_normal) {
-    value->type = dg_float_bitnormal;
+    break;
+  case dg_float_bitnormal:
     value->bitnormal_val = dg_bitstream_read_bitnormal(stream);
-  } else if (prop->flag_cellcoord) {
-    value->type = dg_float_bitcellcoord;
+    break;
+  case dg_float_bitcellcoord:
     value->bitcellcoord_val =
         dg_bitstream_read_bitcellcoord(stream, false, false, prop->prop_numbits);
-  } else if (prop->flag_cellcoordlp) {
-    value->type = dg_float_bitcellcoordlp;
+    break;
+  case dg_float_bitcellcoordlp:
     value->bitcellcoord_val =
         dg_bitstream_read_bitcellcoord(stream, false, true, prop->prop_numbits);
-  } else if (prop->flag_cellcoordint) {
-    value->type = dg_float_bitcellcoordint;
+    break;
+  case dg_float_bitcellcoordint:
     value->bitcellcoord_val =
         dg_bitstream_read_bitcellcoord(stream, true, false, prop->prop_numbits);
-  } else {
+    break;
+  default:
     value->type = dg_float_unsigned;
     value->unsigned_val = dg_bitstream_read_uint(stream, prop->prop_numbits);
+    break;
   }
 }
 
 static void write_vector3(dg_bitwriter *thisptr, dg_prop_value_inner value) {
-  write_float(thisptr, value.v3_val->x);
-  write_float(thisptr, value.v3_val->y);
+  write_scalar(thisptr, value.v3_val->x);
+  write_scalar(thisptr, value.v3_val->y);
 
   if (value.v3_val->_sign != dg_vector3_sign_no) {
     bool sign = value.v3_val->_sign == dg_vector3_sign_pos;
     dg_bitwriter_write_bit(thisptr, sign);
   } else {
-    write_float(thisptr, value.v3_val->z);
+    write_scalar(thisptr, value.v3_val->z);
   }
 }
 
-static void read_vector3(prop_parse_state *state, dg_sendprop *prop, dg_prop_value_inner *value) {
+static void read_vector3(prop_parse_state *state, const dg_flatprop *prop,
+                         dg_prop_value_inner *value) {
   value->v3_val = dg_alloc_allocate(state->allocator, sizeof(dg_vector3_value), alignof(dg_vector3_value));
   memset(value->v3_val, 0, sizeof(dg_vector3_value));
 
@@ -162,11 +200,12 @@ static void read_vector3(prop_parse_state *state, dg_sendprop *prop, dg_prop_val
 }
 
 static void write_vector2(dg_bitwriter *thisptr, dg_prop_value_inner value) {
-  write_float(thisptr, value.v2_val->x);
-  write_float(thisptr, value.v2_val->y);
+  write_scalar(thisptr, value.v2_val->x);
+  write_scalar(thisptr, value.v2_val->y);
 }
 
-static void read_vector2(prop_parse_state *state, dg_sendprop *prop, dg_prop_value_inner *value) {
+static void read_vector2(prop_parse_state *state, const dg_flatprop *prop,
+                         dg_prop_value_inner *value) {
   value->v2_val = dg_alloc_allocate(state->allocator, sizeof(dg_vector2_value), alignof(dg_vector2_value));
   memset(value->v2_val, 0, sizeof(dg_vector2_value));
 
@@ -181,7 +220,8 @@ static void write_string(dg_bitwriter *thisptr, dg_prop_value_inner value) {
   dg_bitwriter_write_bits(thisptr, value.str_val->str, 8 * value.str_val->len);
 }
 
-static void read_string(prop_parse_state *state, dg_sendprop *prop, dg_prop_value_inner *value) {
+static void read_string(prop_parse_state *state, const dg_flatprop *prop,
+                        dg_prop_value_inner *value) {
   value->str_val = dg_alloc_allocate(state->allocator, sizeof(dg_string_value), alignof(dg_string_value));
   size_t len = value->str_val->len = dg_bitstream_read_uint(state->stream, dt_max_string_bits);
   value->str_val->str = dg_alloc_allocate(state->allocator, len + 1, 1);
@@ -199,8 +239,11 @@ static void write_array(dg_bitwriter *thisptr, dg_prop_value_inner value) {
   }
 }
 
-static void read_array(prop_parse_state *state, dg_sendprop *props, uint32_t prop_index, dg_prop_value_inner *value) {
-  dg_sendprop* prop = props + prop_index;
+static void read_array(prop_parse_state *state, const dg_flatprop *prop,
+                       const dg_sendprop *sendprop, dg_prop_value_inner *value) {
+  // Array elements are not flattened, their decoding info comes from the sendprop
+  dg_flatprop element;
+  dg_flatprop_init(&element, sendprop->array_prop);
   value->array_num_elements = prop->array_num_elements;
   value->arr_val = dg_alloc_allocate(state->allocator, sizeof(dg_array_value), alignof(dg_array_value));
   value->arr_val->array_size =
@@ -210,70 +253,74 @@ static void read_array(prop_parse_state *state, dg_sendprop *props, uint32_t pro
                         alignof(dg_prop_value_inner));
 
   for (size_t i = 0; i < value->arr_val->array_size; ++i) {
-    prop_value temp = read_prop(state, props, prop->array_prop);
-    value->arr_val->values[i] = temp.value;
+    dg_prop_value_inner *element_value = value->arr_val->values + i;
+    memset(element_value, 0, sizeof(*element_value));
+    read_value(state, &element, sendprop->array_prop, element_value);
   }
 }
 
+typedef void (*prop_writer)(dg_bitwriter *thisptr, dg_prop_value_inner value);
+
+static const prop_writer prop_writers[] = {
+    [sendproptype_int] = write_scalar,      [sendproptype_float] = write_scalar,
+    [sendproptype_vector3] = write_vector3, [sendproptype_vector2] = write_vector2,
+    [sendproptype_string] = write_string,   [sendproptype_array] = write_array,
+};
+
 static void write_prop(dg_bitwriter *thisptr, dg_prop_value_inner value) {
-  dg_sendproptype type = value.proptype;
-  switch (type) {
+  if (value.proptype < ARRAYSIZE(prop_writers) && prop_writers[value.proptype]) {
+    prop_writers[value.proptype](thisptr, value);
+  } else {
+    thisptr->error = true;
+    thisptr->error_message = "Unknown sendproptype for write_prop";
+  }
+}
+
+static void read_value(prop_parse_state *state, const dg_flatprop *prop,
+                       const dg_sendprop *sendprop, dg_prop_value_inner *value) {
+#ifdef DEBUG_BREAK_PROP
+  ++DG_CURRENT_DEBUG_INDEX;
+#endif
+
+#ifdef DEBUG_BREAK_PROP
+  if (BREAK_INDEX == DG_CURRENT_DEBUG_INDEX) {
+    ; // Set a breakpoint here
+  }
+#endif
+
+  value->proptype = prop->proptype;
+  switch (prop->proptype) {
   case sendproptype_array:
-    write_array(thisptr, value);
+    read_array(state, prop, sendprop, value);
     break;
   case sendproptype_vector3:
-    write_vector3(thisptr, value);
+    read_vector3(state, prop, value);
     break;
   case sendproptype_vector2:
-    write_vector2(thisptr, value);
+    read_vector2(state, prop, value);
     break;
   case sendproptype_float:
-    write_float(thisptr, value);
+    read_float(state, prop, value);
     break;
   case sendproptype_string:
-    write_string(thisptr, value);
+    read_string(state, prop, value);
     break;
   case sendproptype_int:
-    write_int(thisptr, value);
+    read_int(state, prop, value);
     break;
   default:
-    thisptr->error = true;
-    thisptr->error_message = "Unknown sendproptype for write_prop";
+    state->error = true;
+    state->error_message = "Got an unknown prop type in read_prop";
     break;
   }
 }
 
-static prop_value read_prop(prop_parse_state *state, dg_sendprop *props, dg_sendprop *prop) {
-#ifdef DEBUG_BREAK_PROP
-  ++DG_CURRENT_DEBUG_INDEX;
-#endif
-
-#ifdef DEBUG_BREAK_PROP
-  if (BREAK_INDEX == DG_CURRENT_DEBUG_INDEX) {
-    ; // Set a breakpoint here
-  }
-#endif
-
+static prop_value read_prop(prop_parse_state *state, const dg_serverclass_data *data,
+                            uint32_t prop_index) {
   prop_value value;
   memset(&value, 0, sizeof(value));
-  value.prop_index = prop - props;
-  value.value.proptype = prop->proptype;
-  if (prop->proptype == sendproptype_array) {
-    read_array(state, props, value.prop_index, &value.value);
-  } else if (prop->proptype == sendproptype_vector3) {
-    read_vector3(state, prop, &value.value);
-  } else if (prop->proptype == sendproptype_vector2) {
-    read_vector2(state, prop, &value.value);
-  } else if (prop->proptype == sendproptype_float) {
-    read_float(state, prop, &value.value);
-  } else if (prop->proptype == sendproptype_string) {
-    read_string(state, prop, &value.value);
-  } else if (prop->proptype == sendproptype_int) {
-    read_int(state, prop, &value.value);
-  } else {
-    state->error = true;
-    state->error_message = "Got an unknown prop type in read_prop";
-  }
+  value.prop_index = prop_index;
+  read_value(state, data->flatprops + prop_index, data->props[prop_index], &value.value);
 
   return value;
 }
@@ -313,7 +360,7 @@ static void parse_props_prot4(prop_parse_state *state) {
     if (i == -1 || state->error || stream->overflow)
       break;
 
-    prop_value value = read_prop(state, datas->props, datas->props + i);
+    prop_value value = read_prop(state, datas, i);
     dg_va_push_back(&state->prop_array, &value);
   }
 }
@@ -346,7 +393,7 @@ static void parse_props_old(prop_parse_state *state) {
     if (i == -1 || state->error || state->stream->overflow)
       break;
 
-    prop_value value = read_prop(state, data->props, data->props + i);
+    prop_value value = read_prop(state, data, i);
     dg_va_push_back(&state->prop_array, &value);
     //printf("parse prop %d.%d (datatable_id %u) : %u offset\n", state->update->ent_index, i, state->update->datatable_id, state->stream->bitoffset);
   }
@@ -368,7 +415,7 @@ static void parse_props(prop_parse_state *state) {
     parse_props_old(state);
   }
 
-  if (state->prop_array.count_elements > 0) {
+  if (state->prop_array.count_elements > 0 && !state->skip_props) {
     state->update->prop_value_array_size = state->prop_array.count_elements;
     size_t bytes = sizeof(prop_value) * state->prop_array.count_elements;
     state->update->prop_value_array = dg_alloc_allocate(state->allocator, bytes, alignof(prop_value));
@@ -589,6 +636,31 @@ end:;
   return result;
 }
 
+static void report_changed_props(dg_parser *thisptr, dg_alloc_state *allocator) {
+  const estate *entity_state = &thisptr->state.entity_state;
+  dg_changed_props changes;
+  changes.entities_count = 0;
+  changes.entities =
+      dg_alloc_allocate(allocator, sizeof(dg_changed_entity) * entity_state->changed_edicts_count,
+                        alignof(dg_changed_entity));
+
+  for (uint32_t i = 0; i < entity_state->changed_edicts_count; ++i) {
+    uint16_t ent_index = entity_state->changed_edicts[i];
+    const dg_edict *ent = entity_state->edicts + ent_index;
+    // Entities deleted later in the same message are not reported
+    if (ent->exists && ent->changed_props) {
+      dg_changed_entity *entity = changes.entities + changes.entities_count++;
+      entity->ent = ent;
+      entity->ent_index = ent_index;
+      entity->changed_props = ent->changed_props;
+    }
+  }
+
+  if (changes.entities_count > 0) {
+    thisptr->m_settings.changed_props_handler(&thisptr->state, &changes);
+  }
+}
+
 void dg_parser_handle_packetentities(dg_parser *thisptr, struct dg_svc_packet_entities *message) {
   dg_packetentities_data output;
   dg_packetentities_parse_args args;
@@ -616,6 +688,123 @@ void dg_parser_handle_packetentities(dg_parser *thisptr, struct dg_svc_packet_en
     }
 
     dg_estate_update(&thisptr->state.entity_state, &output);
+    if (thisptr->m_settings.changed_props_handler) {
+      report_changed_props(thisptr, args.allocator);
+    }
+  } else {
+    thisptr->error = result.error;
+    thisptr->error_message = result.error_message;
+  }
+}
+
+dg_parse_result dg_parse_temp_entities(dg_temp_entities_parse_args *args) {
+  dg_parse_result result;
+  memset(&result, 0, sizeof(result));
+  memset(args->output, 0, sizeof(*args->output));
+  args->output->orig = args->message;
+
+  if (!args->entity_state->class_datas) {
+    result.error = true;
+    result.error_message = "Tried to parse temp entities with no flattened props";
+    return result;
+  }
+
+  dg_bitstream stream = args->message->data;
+  prop_parse_state state;
+  memset(&state, 0, sizeof(state));
+  state.allocator = args->allocator;
+  state.stream = &stream;
+  state.permanent_allocator = args->permanent_allocator;
+  state.entity_state = args->entity_state;
+  state.demver_data = args->demver_data;
+
+  // Zero entries means a single reliable temp entity
+  size_t entries = args->message->num_entries == 0 ? 1 : args->message->num_entries;
+  args->output->entities =
+      dg_alloc_allocate(state.allocator, sizeof(dg_temp_entity) * entries, alignof(dg_temp_entity));
+
+  prop_value props_array[64];
+  state.prop_array = dg_va_create(props_array, prop_value);
+
+  uint32_t serverclass_bits = Q_log2(args->entity_state->serverclass_count) + 1;
+  int datatable_id = -1;
+
+  for (size_t i = 0; i < entries && !state.error && !stream.overflow; ++i) {
+    dg_temp_entity *entity = args->output->entities + args->output->entities_count;
+    memset(entity, 0, sizeof(*entity));
+
+    if (dg_bitstream_read_bit(&stream)) {
+      entity->delay = dg_bitstream_read_sint(&stream, 8) / 100.0f;
+    }
+
+    entity->new_class = dg_bitstream_read_bit(&stream);
+
+    if (entity->new_class) {
+      // Class ids are sent off by one
+      uint32_t class_id = dg_bitstream_read_uint(&stream, serverclass_bits);
+      if (class_id == 0 || class_id > args->entity_state->serverclass_count) {
+        state.error = true;
+        state.error_message = "Invalid class ID in svc_temp_entities";
+        break;
+      }
+      datatable_id = class_id - 1;
+      state.skip_props = args->class_filter && !args->class_filter[datatable_id];
+    } else if (datatable_id == -1) {
+      state.error = true;
+      state.error_message = "Temp entity delta had no class to delta from";
+      break;
+    }
+
+    entity->update.ent_index = -1;
+    entity->update.datatable_id = datatable_id;
+    entity->update.update_type = entity->new_class ? 2 : 0;
+    state.update = &entity->update;
+    parse_props(&state);
+
+    if (!state.skip_props) {
+      ++args->output->entities_count;
+    }
+  }
+
+  dg_va_free(&state.prop_array);
+
+  result.error = state.error;
+  result.error_message = state.error_message;
+
+  if (stream.overflow && !result.error) {
+    result.error = true;
+    result.error_message = "Stream overflowed in svc_temp_entities";
+  }
+
+  return result;
+}
+
+void dg_parser_handle_temp_entities(dg_parser *thisptr, struct dg_svc_temp_entities *message) {
+  // Nothing to decode against before datatables have been parsed
+  if (!thisptr->state.entity_state.class_datas) {
+    return;
+  }
+
+  dg_svc_temp_entities_parsed output;
+  dg_temp_entities_parse_args args;
+  args.allocator = dg_parser_packet_allocator(thisptr);
+  args.demver_data = &thisptr->demo_version;
+  args.entity_state = &thisptr->state.entity_state;
+  args.message = message;
+  args.output = &output;
+  args.permanent_allocator = dg_parser_perm_allocator(thisptr);
+  args.class_filter = thisptr->temp_entity_classes;
+
+  dg_parse_result result = dg_parse_temp_entities(&args);
+
+  if (!result.error) {
+    dg_svc_temp_entities_parsed *parsed_ptr;
+    message->parsed = parsed_ptr = dg_alloc_allocate(
+        args.allocator, sizeof(dg_svc_temp_entities_parsed), alignof(dg_svc_temp_entities_parsed));
+    *parsed_ptr = output;
+    if (output.entities_count > 0) {
+      thisptr->m_settings.temp_entities_parsed_handler(&thisptr->state, parsed_ptr);
+    }
   } else {
     thisptr->error = result.error;
     thisptr->error_message = result.error_message;
@@ -636,12 +825,214 @@ dg_parse_result dg_parse_instancebaseline(const dg_instancebaseline_args* args)
   state.allocator = args->allocator;
   state.permanent_allocator = args->permanent_allocator;
   state.update = args->output;
+  memset(state.update, 0, sizeof(*state.update));
   state.update->datatable_id = args->datatable_id;
+  state.update->update_type = 2;
   state.demver_data = args->demver_data;
 
+  if (args->datatable_id >= args->estate_ptr->serverclass_count) {
+    result.error = true;
+    result.error_message = "Invalid class ID in instancebaseline";
+    goto end;
+  }
+
   parse_props(&state);
+  result.error = state.error;
+  result.error_message = state.error_message;
+
+  if (stream.overflow && !result.error) {
+    result.error = true;
+    result.error_message = "Stream overflowed in instancebaseline";
+  }
 
+end:
   dg_va_free(&state.prop_array);
   
   return result;
 }
+
+void dg_baseline_cache_init(dg_baseline_cache *cache, dg_alloc_state *allocator, uint32_t table_id,
+                            uint32_t max_entries) {
+  memset(cache, 0, sizeof(*cache));
+  cache->baselines = dg_alloc_allocate(allocator, sizeof(dg_instancebaseline) * max_entries,
+                                       alignof(dg_instancebaseline));
+  cache->entry_classes =
+      dg_alloc_allocate(allocator, sizeof(int32_t) * max_entries, alignof(int32_t));
+  if (max_entries > 0) {
+    memset(cache->baselines, 0, sizeof(dg_instancebaseline) * max_entries);
+    memset(cache->entry_classes, 0xff, sizeof(int32_t) * max_entries);
+  }
+  cache->max_entries = max_entries;
+  cache->table_id = table_id;
+  cache->exists = true;
+}
+
+// Entry names are the datatable ids as strings
+static int32_t baseline_datatable_id(const char *name, uint32_t max_entries) {
+  int32_t value = 0;
+  if (*name == '\0') {
+    return -1;
+  }
+
+  for (; *name; ++name) {
+    if (*name < '0' || *name > '9' || value >= (int32_t)max_entries) {
+      return -1;
+    }
+    value = value * 10 + (*name - '0');
+  }
+
+  return value < (int32_t)max_entries ? value : -1;
+}
+
+// The stringtable data lives in packet memory, so it has to be copied for the cache to outlive it
+static void store_baseline(dg_instancebaseline *baseline, const dg_bitstream *userdata,
+                           dg_alloc_state *allocator) {
+  uint32_t first_byte = userdata->bitoffset / 8;
+  uint32_t end_byte = (userdata->bitsize + 7) / 8;
+  uint32_t bytes = end_byte - first_byte;
+  uint8_t *data = dg_alloc_allocate(allocator, bytes, 1);
+  if (bytes > 0) {
+    memcpy(data, (uint8_t *)userdata->data + first_byte, bytes);
+  }
+
+  baseline->data = dg_bitstream_create(data, userdata->bitsize - first_byte * 8);
+  baseline->data.bitoffset = userdata->bitoffset & 0x7;
+  baseline->has_data = true;
+  baseline->is_decoded = false;
+}
+
+enum { BASELINE_HISTORY_SIZE = 32, BASELINE_NAME_SIZE = 16 };
+
+dg_parse_result dg_baseline_cache_update(dg_baseline_cache *cache, const dg_baseline_cache_args *args,
+                                         const dg_sentry *entries) {
+  dg_parse_result result;
+  memset(&result, 0, sizeof(result));
+  // Names can reuse the beginning of one of the last 32 entries of the same update
+  char history[BASELINE_HISTORY_SIZE][BASELINE_NAME_SIZE];
+  size_t history_count = 0;
+
+  for (size_t i = 0; i < entries->values_length; ++i) {
+    const dg_sentry_value *value = entries->values + i;
+    if (value->entry_index >= cache->max_entries) {
+      result.error = true;
+      result.error_message = "instancebaseline entry out of bounds";
+      break;
+    }
+
+    char name[BASELINE_NAME_SIZE];
+    int32_t datatable_id = cache->entry_classes[value->entry_index];
+
+    if (value->has_name) {
+      size_t length = 0;
+      if (value->reuse_previous_value && value->reuse_str_index < history_count) {
+        const char *previous = history[value->reuse_str_index];
+        while (length < value->reuse_length && previous[length] && length < sizeof(name) - 1) {
+          name[length] = previous[length];
+          ++length;
+        }
+      }
+      const char *str = value->stored_string;
+      while (*str && length < sizeof(name) - 1) {
+        name[length++] = *str++;
+      }
+      name[length] = '\0';
+      datatable_id = baseline_datatable_id(name, cache->max_entries);
+      cache->entry_classes[value->entry_index] = datatable_id;
+    } else if (datatable_id >= 0) {
+      snprintf(name, sizeof(name), "%d", datatable_id);
+    } else {
+      name[0] = '\0';
+    }
+
+    if (history_count == BASELINE_HISTORY_SIZE) {
+      memmove(history[0], history[1], sizeof(history[0]) * (BASELINE_HISTORY_SIZE - 1));
+      --history_count;
+    }
+    memcpy(history[history_count++], name, sizeof(name));
+
+    if (value->has_user_data && datatable_id >= 0) {
+      store_baseline(cache->baselines + datatable_id, &value->userdata, args->permanent_allocator);
+    }
+  }
+
+  if (!result.error && args->estate_ptr->class_datas) {
+    result = dg_baseline_cache_decode(cache, args);
+  }
+
+  return result;
+}
+
+dg_parse_result dg_baseline_cache_decode(dg_baseline_cache *cache, const dg_baseline_cache_args *args) {
+  dg_parse_result result;
+  memset(&result, 0, sizeof(result));
+  uint32_t count = MIN(cache->max_entries, args->estate_ptr->serverclass_count);
+
+  dg_instancebaseline_args parse_args;
+  parse_args.estate_ptr = args->estate_ptr;
+  parse_args.demver_data = args->demver_data;
+  parse_args.permanent_allocator = parse_args.allocator = args->permanent_allocator;
+
+  for (uint32_t i = 0; i < count && !result.error; ++i) {
+    dg_instancebaseline *baseline = cache->baselines + i;
+    if (!baseline->has_data || baseline->is_decoded) {
+      continue;
+    }
+
+    parse_args.datatable_id = i;
+    parse_args.output = &baseline->decoded;
+    parse_args.stream = &baseline->data;
+    result = dg_parse_instancebaseline(&parse_args);
+    baseline->is_decoded = !result.error;
+  }
+
+  return result;
+}
+
+const dg_ent_update *dg_baseline_cache_get(const dg_baseline_cache *cache, uint32_t datatable_id) {
+  if (cache == NULL || datatable_id >= cache->max_entries ||
+      !cache->baselines[datatable_id].is_decoded) {
+    return NULL;
+  }
+
+  return &cache->baselines[datatable_id].decoded;
+}
+
+static dg_baseline_cache_args get_baseline_cache_args(dg_parser *thisptr) {
+  dg_baseline_cache_args args;
+  args.estate_ptr = &thisptr->state.entity_state;
+  args.demver_data = &thisptr->demo_version;
+  args.permanent_allocator = dg_parser_perm_allocator(thisptr);
+  return args;
+}
+
+static void handle_baseline_result(dg_parser *thisptr, dg_parse_result result) {
+  if (result.error) {
+    thisptr->error = true;
+    thisptr->error_message = result.error_message;
+  }
+}
+
+void dg_parser_create_instancebaselines(dg_parser *thisptr, uint32_t table_id,
+                                        const dg_sentry *entries) {
+  dg_baseline_cache *cache = &thisptr->state.instancebaselines;
+  dg_baseline_cache_init(cache, dg_parser_perm_allocator(thisptr), table_id, entries->max_entries);
+  dg_baseline_cache_args args = get_baseline_cache_args(thisptr);
+
+  if (entries->values) {
+    handle_baseline_result(thisptr, dg_baseline_cache_update(cache, &args, entries));
+  }
+}
+
+void dg_parser_update_instancebaselines(dg_parser *thisptr, const dg_sentry *entries) {
+  dg_baseline_cache_args args = get_baseline_cache_args(thisptr);
+  handle_baseline_result(
+      thisptr, dg_baseline_cache_update(&thisptr->state.instancebaselines, &args, entries));
+}
+
+void dg_parser_decode_instancebaselines(dg_parser *thisptr) {
+  if (thisptr->state.instancebaselines.exists) {
+    dg_baseline_cache_args args = get_baseline_cache_args(thisptr);
+    handle_baseline_result(
+        thisptr, dg_baseline_cache_decode(&thisptr->state.instancebaselines, &args));
+  }
+}
@@ -4,3 +4,9 @@
 #include "demogobbler/parser.h"
 
 void dg_parser_handle_packetentities(dg_parser *thisptr, struct dg_svc_packet_entities *message);
+void dg_parser_handle_temp_entities(dg_parser *thisptr, struct dg_svc_temp_entities *message);
+// Instancebaselines are only cached when packet entities are parsed
+void dg_parser_create_instancebaselines(dg_parser *thisptr, uint32_t table_id,
+                                        const dg_sentry *entries);
+void dg_parser_update_instancebaselines(dg_parser *thisptr, const dg_sentry *entries);
+void dg_parser_decode_instancebaselines(dg_parser *thisptr);
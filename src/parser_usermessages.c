@@ -0,0 +1,181 @@
+#include "parser_usermessages.h"
+#include "demogobbler/alignof_wrapper.h"
+#include "demogobbler/allocator.h"
+#include "demogobbler/utils.h"
+#include <string.h>
+
+typedef struct {
+  char *address;
+  size_t size;
+} string_blk;
+
+static const char *read_string(dg_bitstream *stream, string_blk *strings) {
+  char *str = strings->address;
+  size_t bytes = dg_bitstream_read_cstring(stream, strings->address, strings->size);
+  strings->address += bytes;
+  strings->size -= bytes;
+  return str;
+}
+
+// Some of the trailing strings are not written by every game
+static const char *read_optional_string(dg_bitstream *stream, string_blk *strings) {
+  if (dg_bitstream_bits_left(stream) >= 8) {
+    return read_string(stream, strings);
+  } else {
+    return NULL;
+  }
+}
+
+static void decode_um_geiger(dg_bitstream *stream, dg_user_message_parsed *message,
+                             string_blk *strings) {
+  message->message_um_geiger.range = dg_bitstream_read_uint(stream, 8);
+}
+
+static void decode_um_train(dg_bitstream *stream, dg_user_message_parsed *message,
+                            string_blk *strings) {
+  message->message_um_train.pos = dg_bitstream_read_uint(stream, 8);
+}
+
+static void decode_um_hudtext(dg_bitstream *stream, dg_user_message_parsed *message,
+                              string_blk *strings) {
+  message->message_um_hudtext.text = read_string(stream, strings);
+}
+
+static void decode_um_saytext(dg_bitstream *stream, dg_user_message_parsed *message,
+                              string_blk *strings) {
+  struct dg_um_saytext *ptr = &message->message_um_saytext;
+  ptr->client = dg_bitstream_read_uint(stream, 8);
+  ptr->text = read_string(stream, strings);
+  ptr->chat = dg_bitstream_read_uint(stream, 8) != 0;
+}
+
+static void decode_um_saytext2(dg_bitstream *stream, dg_user_message_parsed *message,
+                               string_blk *strings) {
+  struct dg_um_saytext2 *ptr = &message->message_um_saytext2;
+  ptr->client = dg_bitstream_read_uint(stream, 8);
+  ptr->chat = dg_bitstream_read_uint(stream, 8) != 0;
+  ptr->msg_name = read_string(stream, strings);
+  for (size_t i = 0; i < ARRAYSIZE(ptr->params); ++i) {
+    ptr->params[i] = read_optional_string(stream, strings);
+  }
+}
+
+static void decode_um_textmsg(dg_bitstream *stream, dg_user_message_parsed *message,
+                              string_blk *strings) {
+  struct dg_um_textmsg *ptr = &message->message_um_textmsg;
+  ptr->dest = dg_bitstream_read_uint(stream, 8);
+  ptr->msg_name = read_string(stream, strings);
+  for (size_t i = 0; i < ARRAYSIZE(ptr->params); ++i) {
+    ptr->params[i] = read_optional_string(stream, strings);
+  }
+}
+
+static void decode_um_resethud(dg_bitstream *stream, dg_user_message_parsed *message,
+                               string_blk *strings) {
+  message->message_um_resethud.unk = dg_bitstream_read_uint(stream, 8);
+}
+
+static void decode_um_shake(dg_bitstream *stream, dg_user_message_parsed *message,
+                            string_blk *strings) {
+  struct dg_um_shake *ptr = &message->message_um_shake;
+  ptr->command = dg_bitstream_read_uint(stream, 8);
+  ptr->amplitude = dg_bitstream_read_float(stream);
+  ptr->frequency = dg_bitstream_read_float(stream);
+  ptr->duration = dg_bitstream_read_float(stream);
+}
+
+static void decode_um_fade(dg_bitstream *stream, dg_user_message_parsed *message,
+                           string_blk *strings) {
+  struct dg_um_fade *ptr = &message->message_um_fade;
+  ptr->duration = dg_bitstream_read_uint(stream, 16);
+  ptr->hold_time = dg_bitstream_read_uint(stream, 16);
+  ptr->flags = dg_bitstream_read_uint(stream, 16);
+  ptr->r = dg_bitstream_read_uint(stream, 8);
+  ptr->g = dg_bitstream_read_uint(stream, 8);
+  ptr->b = dg_bitstream_read_uint(stream, 8);
+  ptr->a = dg_bitstream_read_uint(stream, 8);
+}
+
+static void decode_um_rumble(dg_bitstream *stream, dg_user_message_parsed *message,
+                             string_blk *strings) {
+  struct dg_um_rumble *ptr = &message->message_um_rumble;
+  ptr->index = dg_bitstream_read_uint(stream, 8);
+  ptr->data = dg_bitstream_read_uint(stream, 8);
+  ptr->flags = dg_bitstream_read_uint(stream, 8);
+}
+
+dg_user_message_type dg_get_user_message_type(const dg_demver_data *version_data,
+                                              uint8_t msg_type) {
+  if (msg_type >= version_data->user_message_count) {
+    return um_invalid;
+  } else {
+    return version_data->user_message_array[msg_type];
+  }
+}
+
+dg_parse_result dg_parse_user_message(dg_user_message_parsed *out,
+                                      const dg_user_message_parse_args *args) {
+  dg_parse_result result;
+  memset(&result, 0, sizeof(result));
+  memset(out, 0, sizeof(*out));
+  out->type = dg_get_user_message_type(args->version_data, args->msg_type);
+
+  if (out->type == um_invalid) {
+    result.error = true;
+    result.error_message = "No decoder for this user message type";
+    return result;
+  }
+
+  dg_bitstream stream = args->stream;
+  string_blk strings;
+  strings.size = dg_bitstream_bits_left(&stream) / 8 + 1;
+  strings.address = dg_alloc_allocate(args->allocator, strings.size, 1);
+
+#define DECLARE_SWITCH_STATEMENT(message_type)                                                     \
+  case message_type:                                                                               \
+    decode_##message_type(&stream, out, &strings);                                                 \
+    break;
+
+  switch (out->type) {
+    DEMOGOBBLER_MACRO_ALL_USER_MESSAGES(DECLARE_SWITCH_STATEMENT);
+  default:
+    break;
+  }
+
+#undef DECLARE_SWITCH_STATEMENT
+
+  if (stream.overflow) {
+    result.error = true;
+    result.error_message = "Overflowed during user message parsing";
+  }
+
+  return result;
+}
+
+void dg_parser_handle_user_message(dg_parser *thisptr, struct dg_svc_user_message *message) {
+  dg_user_message_type type = dg_get_user_message_type(&thisptr->demo_version, message->msg_type);
+
+  // Unknown and unsubscribed messages have already been skipped over, nothing to do here
+  uint32_t mask = thisptr->m_settings.user_message_mask;
+  if (type == um_invalid || (mask != 0 && (mask & (1u << type)) == 0)) {
+    return;
+  }
+
+  dg_user_message_parse_args args;
+  args.allocator = dg_parser_packet_allocator(thisptr);
+  args.version_data = &thisptr->demo_version;
+  args.msg_type = message->msg_type;
+  args.stream = message->data;
+
+  dg_user_message_parsed parsed;
+  dg_parse_result result = dg_parse_user_message(&parsed, &args);
+
+  // Mods can change the layout of these messages, leave the message undecoded instead of failing
+  // the whole parse
+  if (!result.error) {
+    message->parsed =
+        dg_alloc_allocate(args.allocator, sizeof(parsed), alignof(dg_user_message_parsed));
+    *message->parsed = parsed;
+    thisptr->m_settings.user_message_handler(&thisptr->state, message->parsed);
+  }
+}
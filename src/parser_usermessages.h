@@ -0,0 +1,6 @@
+#pragma once
+
+#include "demogobbler.h"
+#include "demogobbler/parser.h"
+
+void dg_parser_handle_user_message(dg_parser *thisptr, struct dg_svc_user_message *message);
@@ -41,19 +41,17 @@ void dg_buffer_stream_init(buffer_stream* thisptr, void* buffer, size_t size)
 size_t dg_buffer_stream_read(void* ptr, void* dest, size_t bytes)
 {
   buffer_stream* thisptr = ptr;
-  if(bytes >= thisptr->size || bytes < 0)
+  // Reads past the end return whatever is left, the filereader asks for more than small buffers hold
+  size_t read = MIN(thisptr->size - thisptr->offset, bytes);
+  if(read < bytes)
   {
     thisptr->overflow = true;
-    return 0;
-  }
-  else
-  {
-    size_t read = MIN(thisptr->size - thisptr->offset, bytes);
-    uint8_t* src = (uint8_t*)thisptr->buffer + thisptr->offset;
-    memcpy(dest, src, read);
-    thisptr->offset += read;
-    return read;
   }
+
+  uint8_t* src = (uint8_t*)thisptr->buffer + thisptr->offset;
+  memcpy(dest, src, read);
+  thisptr->offset += read;
+  return read;
 }
 
 int dg_buffer_stream_seek(void* ptr, long int offset)
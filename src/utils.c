@@ -27,6 +27,26 @@ enum dg_proptype dg_sendprop_vector_type(const dg_sendprop* _prop) {
   return dg_sendprop_type(&prop);
 }
 
+void dg_flatprop_init(dg_flatprop *flatprop, const dg_sendprop *prop) {
+  memset(flatprop, 0, sizeof(*flatprop));
+  flatprop->proptype = prop->proptype;
+  flatprop->prop_numbits = prop->prop_numbits;
+  flatprop->array_num_elements = prop->array_num_elements;
+  flatprop->flag_normal = prop->flag_normal;
+
+  if (prop->proptype == sendproptype_int || prop->proptype == sendproptype_float) {
+    flatprop->type = dg_sendprop_type(prop);
+  } else if (prop->proptype == sendproptype_vector2 || prop->proptype == sendproptype_vector3) {
+    flatprop->type = dg_sendprop_vector_type(prop);
+  }
+
+  // The low and high values share a union with the array prop pointer
+  if (prop->proptype != sendproptype_array && prop->proptype != sendproptype_string) {
+    flatprop->low_value = prop->prop_.low_value;
+    flatprop->high_value = prop->prop_.high_value;
+  }
+}
+
 enum dg_proptype dg_sendprop_type(const dg_sendprop* prop) {
   if(prop->proptype == sendproptype_float) {
     if (prop->flag_coord) {
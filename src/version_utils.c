@@ -110,6 +110,68 @@ static net_message_type new_protocol_messages[] =
   svc_cmd_key_values, // Not in old L4D
   svc_paintmap_data // Added in protocol 4
 };
+
+// User message ids only for the types that have a decoder, everything else is um_invalid
+
+// Messages registered by the HL2 base, mods diverge after TextMsg so don't go further
+static dg_user_message_type hl2_user_messages[] =
+{
+  um_geiger,
+  um_train,
+  um_hudtext,
+  um_saytext,
+  um_saytext2,
+  um_textmsg
+};
+
+// Old engine has no SayText2, TextMsg takes its id
+static dg_user_message_type oe_user_messages[] =
+{
+  um_geiger,
+  um_train,
+  um_hudtext,
+  um_saytext,
+  um_textmsg
+};
+
+static dg_user_message_type l4d_user_messages[] =
+{
+  um_geiger,
+  um_train,
+  um_hudtext,
+  um_saytext,
+  um_saytext2,
+  um_textmsg,
+  um_invalid, // HudMsg
+  um_resethud,
+  um_invalid, // GameTitle
+  um_invalid, // ItemPickup
+  um_invalid, // ShowMenu
+  um_shake,
+  um_fade,
+  um_invalid, // VGUIMenu
+  um_rumble
+};
+
+static dg_user_message_type portal2_user_messages[] =
+{
+  um_geiger,
+  um_train,
+  um_hudtext,
+  um_saytext,
+  um_saytext2,
+  um_textmsg,
+  um_invalid, // HudMsg
+  um_resethud,
+  um_invalid, // GameTitle
+  um_invalid, // ItemPickup
+  um_invalid, // ShowMenu
+  um_shake,
+  um_invalid, // Tilt
+  um_fade,
+  um_invalid, // VGUIMenu
+  um_rumble
+};
 // clang-format on
 
 static bool is_oe(dg_demver_data *version) { return version->network_protocol <= 7; }
@@ -125,6 +187,35 @@ static void get_net_message_array(dg_demver_data *version) {
     version->netmessage_array = new_protocol_messages;
     version->netmessage_count = ARRAYSIZE(new_protocol_messages);
   }
+
+  // Writers map types back to ids for every message, the first id of a type wins
+  memset(version->netmessage_ids, -1, sizeof(version->netmessage_ids));
+  for (int i = version->netmessage_count - 1; i >= 0; --i) {
+    net_message_type type = version->netmessage_array[i];
+    if (type != svc_invalid) {
+      version->netmessage_ids[type] = i;
+    }
+  }
+}
+
+static void get_user_message_array(dg_demver_data *version) {
+  if (version->game == portal2) {
+    version->user_message_array = portal2_user_messages;
+    version->user_message_count = ARRAYSIZE(portal2_user_messages);
+  } else if (version->game == l4d || version->game == l4d2) {
+    version->user_message_array = l4d_user_messages;
+    version->user_message_count = ARRAYSIZE(l4d_user_messages);
+  } else if (version->game == csgo) {
+    // Protobuf user messages, not supported
+    version->user_message_array = NULL;
+    version->user_message_count = 0;
+  } else if (is_oe(version)) {
+    version->user_message_array = oe_user_messages;
+    version->user_message_count = ARRAYSIZE(oe_user_messages);
+  } else {
+    version->user_message_array = hl2_user_messages;
+    version->user_message_count = ARRAYSIZE(hl2_user_messages);
+  }
 }
 
 static void get_net_message_bits(dg_demver_data *version) {
@@ -313,6 +404,7 @@ void version_update_build_info(dg_demver_data *version) {
   get_cmdinfo_size(version);
   get_preamble_info(version);
   get_net_message_array(version);
+  get_user_message_array(version);
   get_net_message_bits(version);
   get_net_file_bits(version);
   get_has_nettick_times(version);
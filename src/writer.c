@@ -4,12 +4,17 @@
 #include "demogobbler/streams.h"
 #include "demogobbler/utils.h"
 #include "demogobbler/version_utils.h"
+#include "writer.h"
 #include <stdlib.h>
 #include <string.h>
 
+#define WRITER_BUFFER_SIZE (1 << 16)
+
 void dg_writer_init(writer *thisptr) {
   memset(thisptr, 0, sizeof(writer));
   dg_bitwriter_init(&thisptr->bitwriter, 32768);
+  thisptr->_buffer = malloc(WRITER_BUFFER_SIZE);
+  thisptr->_buffer_size = WRITER_BUFFER_SIZE;
 }
 
 void dg_writer_open_file(writer *thisptr, const char *filepath) {
@@ -28,7 +33,18 @@ void dg_writer_open(writer *thisptr, void *stream, output_interface output_inter
   thisptr->_custom_stream = true;
 }
 
+void dg_writer_flush(writer *thisptr) {
+  if (thisptr->_buffer_offset > 0) {
+    thisptr->output_funcs.write(thisptr->_stream, thisptr->_buffer, thisptr->_buffer_offset);
+    thisptr->_buffer_offset = 0;
+  }
+}
+
 void dg_writer_close(writer *thisptr) {
+  dg_writer_flush(thisptr);
+  free(thisptr->_buffer);
+  thisptr->_buffer = NULL;
+  thisptr->_buffer_size = 0;
   dg_bitwriter_free(&thisptr->bitwriter);
   if (!thisptr->_custom_stream && thisptr->_stream) {
     fclose(thisptr->_stream);
@@ -36,14 +52,13 @@ void dg_writer_close(writer *thisptr) {
   }
 }
 
-#define WRITE_BYTE(field) thisptr->output_funcs.write(thisptr->_stream, &message->field, 1);
-#define WRITE_INT32(field) thisptr->output_funcs.write(thisptr->_stream, &message->field, 4);
-#define WRITE_STRING(field, length)                                                                \
-  thisptr->output_funcs.write(thisptr->_stream, &message->field, length);
+#define WRITE_BYTE(field) dg_write_data(thisptr, &message->field, 1);
+#define WRITE_INT32(field) dg_write_data(thisptr, &message->field, 4);
+#define WRITE_STRING(field, length) dg_write_data(thisptr, &message->field, length);
 #define WRITE_CMDINFO_VEC(field)                                                                   \
-  thisptr->output_funcs.write(thisptr->_stream, &(cmdinfo->field.x), 4);                           \
-  thisptr->output_funcs.write(thisptr->_stream, &(cmdinfo->field.y), 4);                           \
-  thisptr->output_funcs.write(thisptr->_stream, &(cmdinfo->field.z), 4);
+  dg_write_data(thisptr, &(cmdinfo->field.x), 4);                                                  \
+  dg_write_data(thisptr, &(cmdinfo->field.y), 4);                                                  \
+  dg_write_data(thisptr, &(cmdinfo->field.z), 4);
 #define WRITE_PREAMBLE()                                                                           \
   WRITE_BYTE(preamble.type);                                                                       \
   WRITE_INT32(preamble.tick);                                                                      \
@@ -53,13 +68,13 @@ void dg_writer_close(writer *thisptr) {
 #define WRITE_DATA()                                                                               \
   WRITE_INT32(size_bytes);                                                                         \
   if (message->size_bytes > 0)                                                                     \
-    thisptr->output_funcs.write(thisptr->_stream, message->data, message->size_bytes);
+    dg_write_data(thisptr, message->data, message->size_bytes);
 
 void dg_write_preamble(writer *thisptr, dg_message_preamble preamble) {
-  thisptr->output_funcs.write(thisptr->_stream, &preamble.type, 1);
-  thisptr->output_funcs.write(thisptr->_stream, &preamble.tick, 4);
+  dg_write_data(thisptr, &preamble.type, 1);
+  dg_write_data(thisptr, &preamble.tick, 4);
   if (thisptr->version.has_slot_in_preamble) {
-    thisptr->output_funcs.write(thisptr->_stream, &preamble.slot, 1);
+    dg_write_data(thisptr, &preamble.slot, 1);
   }
 }
 
@@ -98,7 +113,7 @@ void dg_write_packet(writer *thisptr, dg_packet *message) {
 
   for (int i = 0; i < thisptr->version.cmdinfo_size; ++i) {
     dg_cmdinfo *cmdinfo = &message->cmdinfo[i];
-    thisptr->output_funcs.write(thisptr->_stream, &cmdinfo->interp_flags, 4);
+    dg_write_data(thisptr, &cmdinfo->interp_flags, 4);
 
     WRITE_CMDINFO_VEC(view_origin);
     WRITE_CMDINFO_VEC(view_angles);
@@ -113,6 +128,27 @@ void dg_write_packet(writer *thisptr, dg_packet *message) {
   WRITE_DATA();
 }
 
+void dg_bitwriter_write_packet_data(dg_bitwriter *bitwriter, dg_demver_data *version,
+                                    packet_parsed *message_parsed) {
+  dg_packet *message = &message_parsed->orig;
+  for (uint32_t i = 0; i < message_parsed->message_count; ++i) {
+    packet_net_message *netmsg = message_parsed->messages + i;
+    dg_bitwriter_write_netmessage(bitwriter, version, netmsg);
+  }
+
+  if (bitwriter->bitoffset % 8 != 0) {
+    uint32_t expected_bits =
+        bitwriter->bitoffset + dg_bitstream_bits_left(&message_parsed->leftover_bits);
+    if (expected_bits == message->size_bytes * 8) {
+      // grab leftover bits from original stream if number of bytes matches
+      dg_bitwriter_write_bitstream(bitwriter, &message_parsed->leftover_bits);
+    } else {
+      // otherwise write 0 for the last bits
+      dg_bitwriter_write_uint(bitwriter, 0, 8 - bitwriter->bitoffset % 8);
+    }
+  }
+}
+
 void dg_write_packet_parsed(writer *thisptr, packet_parsed *message_parsed) {
   dg_packet *message = &message_parsed->orig;
   thisptr->bitwriter.bitoffset = 0;
@@ -123,7 +159,7 @@ void dg_write_packet_parsed(writer *thisptr, packet_parsed *message_parsed) {
 
   for (int i = 0; i < thisptr->version.cmdinfo_size; ++i) {
     dg_cmdinfo *cmdinfo = &message->cmdinfo[i];
-    thisptr->output_funcs.write(thisptr->_stream, &cmdinfo->interp_flags, 4);
+    dg_write_data(thisptr, &cmdinfo->interp_flags, 4);
 
     WRITE_CMDINFO_VEC(view_origin);
     WRITE_CMDINFO_VEC(view_angles);
@@ -136,6 +172,9 @@ void dg_write_packet_parsed(writer *thisptr, packet_parsed *message_parsed) {
   WRITE_INT32(in_sequence);
   WRITE_INT32(out_sequence);
 
+  // Rewritten packets are usually the same size as the original
+  dg_bitwriter_reserve(&thisptr->bitwriter, message->size_bytes * 8);
+
 #ifdef GROUND_TRUTH_CHECK
   if(thisptr->expect_equal) {
     thisptr->bitwriter.truth_data = message_parsed->orig.data;
@@ -144,26 +183,11 @@ void dg_write_packet_parsed(writer *thisptr, packet_parsed *message_parsed) {
   }
 #endif
 
-  for (uint32_t i = 0; i < message_parsed->message_count; ++i) {
-    packet_net_message *netmsg = message_parsed->messages + i;
-    dg_bitwriter_write_netmessage(&thisptr->bitwriter, &thisptr->version, netmsg);
-  }
-
-  if (thisptr->bitwriter.bitoffset % 8 != 0) {
-    uint32_t expected_bits =
-        thisptr->bitwriter.bitoffset + dg_bitstream_bits_left(&message_parsed->leftover_bits);
-    if (expected_bits == message->size_bytes * 8) {
-      // grab leftover bits from original stream if number of bytes matches
-      dg_bitwriter_write_bitstream(&thisptr->bitwriter, &message_parsed->leftover_bits);
-    } else {
-      // otherwise write 0 for the last bits
-      dg_bitwriter_write_uint(&thisptr->bitwriter, 0, 8 - thisptr->bitwriter.bitoffset % 8);
-    }
-  }
+  dg_bitwriter_write_packet_data(&thisptr->bitwriter, &thisptr->version, message_parsed);
 
   uint32_t bytes = thisptr->bitwriter.bitoffset / 8;
-  thisptr->output_funcs.write(thisptr->_stream, &bytes, 4);
-  thisptr->output_funcs.write(thisptr->_stream, thisptr->bitwriter.ptr, bytes);
+  dg_write_data(thisptr, &bytes, 4);
+  dg_write_data(thisptr, thisptr->bitwriter.ptr, bytes);
 #ifdef GROUND_TRUTH_CHECK
   if(thisptr->expect_equal) {
       thisptr->bitwriter.truth_data = NULL;
@@ -175,8 +199,8 @@ void dg_write_synctick(writer *thisptr, dg_synctick *message) { WRITE_PREAMBLE()
 
 void dg_write_stop(writer *thisptr, dg_stop *message) {
   enum dg_type t = dg_type_stop;
-  thisptr->output_funcs.write(thisptr->_stream, &t, 1);
-  thisptr->output_funcs.write(thisptr->_stream, message->data, message->size_bytes);
+  dg_write_data(thisptr, &t, 1);
+  dg_write_data(thisptr, message->data, message->size_bytes);
 }
 
 void dg_write_stringtables(writer *thisptr, dg_stringtables *message) {
@@ -195,26 +219,29 @@ void dg_writer_free(writer *thisptr) {
   dg_bitwriter_free(&thisptr->bitwriter);
 }
 
-void dg_write_byte(writer *thisptr, uint8_t value) {
-  thisptr->output_funcs.write(thisptr->_stream, &value, 1);
-}
+void dg_write_byte(writer *thisptr, uint8_t value) { dg_write_data(thisptr, &value, 1); }
 
-void dg_write_short(writer *thisptr, uint16_t value) {
-  thisptr->output_funcs.write(thisptr->_stream, &value, 2);
-}
+void dg_write_short(writer *thisptr, uint16_t value) { dg_write_data(thisptr, &value, 2); }
 
-void dg_write_int32(writer *thisptr, int32_t value) {
-  thisptr->output_funcs.write(thisptr->_stream, &value, 4);
-}
+void dg_write_int32(writer *thisptr, int32_t value) { dg_write_data(thisptr, &value, 4); }
+
+void dg_write_data(writer *thisptr, const void *src, uint32_t bytes) {
+  if (bytes == 0)
+    return;
 
-void dg_write_data(writer *thisptr, void *src, uint32_t bytes) {
-  thisptr->output_funcs.write(thisptr->_stream, src, bytes);
+  if (thisptr->_buffer_offset + bytes > thisptr->_buffer_size) {
+    dg_writer_flush(thisptr);
+    // Blocks larger than the buffer are passed on directly instead of being copied in pieces
+    if (bytes > thisptr->_buffer_size) {
+      thisptr->output_funcs.write(thisptr->_stream, src, bytes);
+      return;
+    }
+  }
+
+  memcpy(thisptr->_buffer + thisptr->_buffer_offset, src, bytes);
+  thisptr->_buffer_offset += bytes;
 }
 
 void dg_write_string(writer *thisptr, const char *str) {
-  while (*str) {
-    thisptr->output_funcs.write(thisptr->_stream, str, 1);
-    ++str;
-  }
-  thisptr->output_funcs.write(thisptr->_stream, str, 1);
+  dg_write_data(thisptr, str, strlen(str) + 1);
 }
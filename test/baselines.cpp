@@ -1,6 +1,8 @@
 #include "demogobbler.h"
+#include "utils/datatables.hpp"
 #include "utils/test_demos.hpp"
 #include "gtest/gtest.h"
+#include <vector>
 
 struct baseline_state {
   dg_arena memory;
@@ -286,3 +288,113 @@ TEST(baselines, generate_and_verify) {
     EXPECT_EQ(result.error, false);
   }
 }
+
+static dg_bitstream write_update_props(dg_bitwriter *writer, const dg_demver_data *version,
+                                       std::vector<prop_value> props) {
+  dg_ent_update update;
+  memset(&update, 0, sizeof(update));
+  update.prop_value_array = props.data();
+  update.prop_value_array_size = props.size();
+  dg_bitwriter_write_props(writer, version, &update);
+  return dg_bitstream_create(writer->ptr, writer->bitoffset);
+}
+
+TEST(baselines, cached_and_applied_on_enter_pvs) {
+  dg_demver_data version = get_version();
+
+  dg_arena arena = dg_arena_create(1 << 16);
+  dg_alloc_state allocator = dg_arena_create_allocator(&arena);
+  dg_bitwriter dt_writer;
+  dg_bitwriter_init(&dt_writer, 1024);
+  write_test_datatables(&dt_writer, &version, {{"m_iFirst", 8}, {"m_iSecond", 8}});
+  auto parsed = parse_test_datatables(&dt_writer, &version, &allocator);
+  ASSERT_FALSE(parsed.error) << parsed.error_message;
+
+  estate entity_state;
+  memset(&entity_state, 0, sizeof(entity_state));
+  estate_init_args args;
+  args.allocator = &allocator;
+  args.flatten_datatables = true;
+  args.message = &parsed.output;
+  args.should_store_props = true;
+  args.build_prop_lookup = false;
+  args.version_data = &version;
+  auto result = dg_estate_init(&entity_state, args);
+  ASSERT_FALSE(result.error) << result.error_message;
+
+  dg_baseline_cache cache;
+  dg_baseline_cache_init(&cache, &allocator, 0, 8);
+  dg_baseline_cache_args cache_args;
+  cache_args.estate_ptr = &entity_state;
+  cache_args.demver_data = &version;
+  cache_args.permanent_allocator = &allocator;
+  entity_state.instancebaselines = &cache;
+
+  dg_bitwriter baseline_writer;
+  dg_bitwriter_init(&baseline_writer, 1024);
+  char name[] = "0";
+  dg_sentry_value value;
+  memset(&value, 0, sizeof(value));
+  value.entry_index = 3;
+  value.has_name = true;
+  value.stored_string = name;
+  value.has_user_data = true;
+  value.userdata =
+      write_update_props(&baseline_writer, &version, {int_value(0, 42), int_value(1, 7)});
+  dg_sentry entries;
+  memset(&entries, 0, sizeof(entries));
+  entries.values = &value;
+  entries.values_length = 1;
+
+  result = dg_baseline_cache_update(&cache, &cache_args, &entries);
+  ASSERT_FALSE(result.error) << result.error_message;
+  // The stringtable data is copied, so the baseline outlives the packet
+  dg_bitwriter_free(&baseline_writer);
+  const dg_ent_update *baseline = dg_baseline_cache_get(&cache, 0);
+  ASSERT_NE(baseline, nullptr);
+  ASSERT_EQ(baseline->prop_value_array_size, 2);
+  EXPECT_EQ(baseline->prop_value_array[0].value.signed_val, 42);
+  EXPECT_EQ(baseline->prop_value_array[1].value.signed_val, 7);
+  EXPECT_EQ(dg_baseline_cache_get(&cache, 1), nullptr);
+
+  std::vector<prop_value> delta = {int_value(1, 100)};
+  dg_ent_update update;
+  memset(&update, 0, sizeof(update));
+  update.ent_index = 1;
+  update.update_type = 2;
+  update.prop_value_array = delta.data();
+  update.prop_value_array_size = delta.size();
+  dg_packetentities_data data;
+  memset(&data, 0, sizeof(data));
+  data.ent_updates = &update;
+  data.ent_updates_count = 1;
+
+  result = dg_estate_update(&entity_state, &data);
+  ASSERT_FALSE(result.error) << result.error_message;
+  dg_edict *ent = entity_state.edicts + 1;
+  EXPECT_EQ(ent->props.values[0].signed_val, 42);
+  EXPECT_EQ(ent->props.values[1].signed_val, 100);
+
+  // Updates without a name refer to the class by entry index and get decoded again
+  dg_bitwriter_init(&baseline_writer, 1024);
+  value.has_name = false;
+  value.stored_string = nullptr;
+  value.userdata = write_update_props(&baseline_writer, &version, {int_value(0, 5)});
+  result = dg_baseline_cache_update(&cache, &cache_args, &entries);
+  ASSERT_FALSE(result.error) << result.error_message;
+  dg_bitwriter_free(&baseline_writer);
+  baseline = dg_baseline_cache_get(&cache, 0);
+  ASSERT_NE(baseline, nullptr);
+  ASSERT_EQ(baseline->prop_value_array_size, 1);
+  EXPECT_EQ(baseline->prop_value_array[0].value.signed_val, 5);
+
+  update.ent_index = 2;
+  result = dg_estate_update(&entity_state, &data);
+  ASSERT_FALSE(result.error) << result.error_message;
+  EXPECT_EQ(entity_state.edicts[2].props.values[0].signed_val, 5);
+  EXPECT_EQ(entity_state.edicts[2].props.values[1].signed_val, 100);
+
+  dg_estate_free(&entity_state);
+  dg_bitwriter_free(&dt_writer);
+  dg_arena_free(&arena);
+}
@@ -612,3 +612,52 @@ TEST(BitstreamPlusWriter, BitCoordMp) {
   EXPECT_EQ(stream.bitoffset, writer.bitoffset);
   dg_bitwriter_free(&writer);
 }
+
+TEST(BitstreamPlusWriter, WideUInt) {
+  dg_bitwriter writer;
+  const int COUNT = 10000;
+  dg_bitwriter_init(&writer, 1);
+  srand(0);
+
+  // Values have bits set above the written width, only the low bits should end up in the output
+  for (int i = 0; i < COUNT; ++i) {
+    unsigned int bits = rand() % 64 + 1;
+    uint64_t value = ((uint64_t)rand() << 40) ^ ((uint64_t)rand() << 20) ^ rand();
+    dg_bitwriter_write_uint(&writer, value, bits);
+  }
+
+  dg_bitstream stream = dg_bitstream_create(writer.ptr, writer.bitoffset);
+  srand(0);
+
+  for (int i = 0; i < COUNT; ++i) {
+    unsigned int bits = rand() % 64 + 1;
+    uint64_t value = ((uint64_t)rand() << 40) ^ ((uint64_t)rand() << 20) ^ rand();
+    if (bits < 64)
+      value &= (1ULL << bits) - 1;
+    EXPECT_EQ(value, dg_bitstream_read_uint(&stream, bits)) << i;
+  }
+
+  EXPECT_EQ(stream.bitoffset, writer.bitoffset);
+  dg_bitwriter_free(&writer);
+}
+
+TEST(BitstreamPlusWriter, Reserve) {
+  dg_bitwriter writer;
+  dg_bitwriter_init(&writer, 1);
+  dg_bitwriter_write_bit(&writer, true);
+  dg_bitwriter_reserve(&writer, 4096);
+  EXPECT_GE(dg_bitwriter_get_available_bits(&writer), 4096);
+
+  uint8_t *ptr = writer.ptr;
+  for (int i = 0; i < 4096; ++i) {
+    dg_bitwriter_write_bit(&writer, i % 3 == 0);
+  }
+  EXPECT_EQ(writer.ptr, ptr);
+
+  dg_bitstream stream = dg_bitstream_create(writer.ptr, writer.bitoffset);
+  EXPECT_TRUE(dg_bitstream_read_bit(&stream));
+  for (int i = 0; i < 4096; ++i) {
+    EXPECT_EQ(dg_bitstream_read_bit(&stream), i % 3 == 0) << i;
+  }
+  dg_bitwriter_free(&writer);
+}
@@ -0,0 +1,240 @@
+#include "demogobbler.h"
+#include "gtest/gtest.h"
+#include "utils/datatables.hpp"
+#include <cstring>
+#include <vector>
+
+class changed_props : public ::testing::Test {
+protected:
+  dg_demver_data version;
+  dg_arena arena;
+  dg_bitwriter writer;
+  estate state;
+
+  void SetUp() override {
+    version = get_version();
+    arena = dg_arena_create(1 << 16);
+    dg_alloc_state allocator = dg_arena_create_allocator(&arena);
+    dg_bitwriter_init(&writer, 1024);
+    write_test_datatables(&writer, &version, {{"m_iHealth", 8}, {"m_iArmor", 8}});
+    auto parsed = parse_test_datatables(&writer, &version, &allocator);
+    ASSERT_FALSE(parsed.error) << parsed.error_message;
+
+    memset(&state, 0, sizeof(state));
+    estate_init_args args;
+    args.allocator = &allocator;
+    args.flatten_datatables = true;
+    args.message = &parsed.output;
+    args.should_store_props = true;
+    args.build_prop_lookup = false;
+    args.version_data = &version;
+    auto result = dg_estate_init(&state, args);
+    ASSERT_FALSE(result.error) << result.error_message;
+    state.track_changed_props = true;
+  }
+
+  void TearDown() override {
+    dg_estate_free(&state);
+    dg_bitwriter_free(&writer);
+    dg_arena_free(&arena);
+  }
+
+  static dg_ent_update create_update(int ent_index, size_t update_type,
+                                     std::vector<prop_value> &props) {
+    dg_ent_update update;
+    memset(&update, 0, sizeof(update));
+    update.ent_index = ent_index;
+    update.update_type = update_type;
+    update.prop_value_array = props.data();
+    update.prop_value_array_size = props.size();
+    return update;
+  }
+
+  void apply(std::vector<dg_ent_update> updates) {
+    dg_packetentities_data data;
+    memset(&data, 0, sizeof(data));
+    data.ent_updates = updates.data();
+    data.ent_updates_count = updates.size();
+    auto result = dg_estate_update(&state, &data);
+    ASSERT_FALSE(result.error) << result.error_message;
+  }
+
+  void update(int ent_index, size_t update_type, std::vector<prop_value> props) {
+    apply({create_update(ent_index, update_type, props)});
+  }
+};
+
+TEST_F(changed_props, only_changed_values) {
+  update(1, 2, {int_value(0, 100), int_value(1, 0)});
+  ASSERT_EQ(state.changed_edicts_count, 1);
+  EXPECT_EQ(state.changed_edicts[0], 1);
+  // Props that were sent for the first time count as changed even if they are zero
+  EXPECT_TRUE(dg_edict_prop_changed(state.edicts + 1, 0));
+  EXPECT_TRUE(dg_edict_prop_changed(state.edicts + 1, 1));
+
+  update(1, 0, {int_value(0, 100), int_value(1, 5)});
+  ASSERT_EQ(state.changed_edicts_count, 1);
+  EXPECT_FALSE(dg_edict_prop_changed(state.edicts + 1, 0));
+  EXPECT_TRUE(dg_edict_prop_changed(state.edicts + 1, 1));
+  EXPECT_EQ(state.edicts[1].props.values[1].signed_val, 5);
+
+  update(1, 0, {int_value(0, 100)});
+  EXPECT_EQ(state.changed_edicts_count, 0);
+  EXPECT_FALSE(dg_edict_prop_changed(state.edicts + 1, 1));
+}
+
+TEST_F(changed_props, deleted_and_recreated) {
+  std::vector<prop_value> props = {int_value(0, 100)};
+  std::vector<prop_value> no_props;
+
+  // The entity stays in the list after being deleted in the same message, but has no bits left
+  apply({create_update(2, 2, props), create_update(2, 3, no_props)});
+  ASSERT_EQ(state.changed_edicts_count, 1);
+  EXPECT_FALSE(state.edicts[2].exists);
+  EXPECT_FALSE(dg_edict_prop_changed(state.edicts + 2, 0));
+
+  // Recreating it in the same message does not add it twice
+  apply({create_update(2, 2, props), create_update(2, 3, no_props), create_update(2, 2, props)});
+  ASSERT_EQ(state.changed_edicts_count, 1);
+  EXPECT_TRUE(dg_edict_prop_changed(state.edicts + 2, 0));
+  EXPECT_FALSE(dg_edict_prop_changed(state.edicts + 2, 1));
+
+  update(2, 0, {int_value(0, 100)});
+  EXPECT_EQ(state.changed_edicts_count, 0);
+}
+
+TEST_F(changed_props, reenter_pvs_with_baseline) {
+  std::vector<prop_value> baseline_props = {int_value(0, 42), int_value(1, 7)};
+  dg_instancebaseline baseline;
+  memset(&baseline, 0, sizeof(baseline));
+  baseline.decoded = create_update(0, 2, baseline_props);
+  baseline.has_data = baseline.is_decoded = true;
+  dg_baseline_cache cache;
+  memset(&cache, 0, sizeof(cache));
+  cache.baselines = &baseline;
+  cache.max_entries = 1;
+  cache.exists = true;
+  state.instancebaselines = &cache;
+
+  update(1, 2, {int_value(1, 100)});
+  EXPECT_EQ(state.edicts[1].props.values[0].signed_val, 42);
+  EXPECT_EQ(state.edicts[1].props.values[1].signed_val, 100);
+  update(1, 1, {});
+
+  // The delta overrides the baseline, so m_iArmor is compared against 100 and not against 7
+  update(1, 2, {int_value(1, 100)});
+  EXPECT_EQ(state.changed_edicts_count, 0);
+  EXPECT_FALSE(dg_edict_prop_changed(state.edicts + 1, 0));
+  EXPECT_FALSE(dg_edict_prop_changed(state.edicts + 1, 1));
+  EXPECT_EQ(state.edicts[1].props.values[1].signed_val, 100);
+
+  update(1, 1, {});
+  update(1, 2, {});
+  EXPECT_EQ(state.changed_edicts_count, 1);
+  EXPECT_FALSE(dg_edict_prop_changed(state.edicts + 1, 0));
+  EXPECT_TRUE(dg_edict_prop_changed(state.edicts + 1, 1));
+  EXPECT_EQ(state.edicts[1].props.values[1].signed_val, 7);
+  state.instancebaselines = nullptr;
+}
+
+TEST_F(changed_props, snapshot_diff) {
+  update(1, 2, {int_value(0, 100), int_value(1, 0)});
+  update(2, 2, {int_value(0, 1)});
+  dg_estate_snapshot *snapshot = dg_estate_snapshot_create(&state);
+  ASSERT_NE(snapshot, nullptr);
+
+  // Values that change back to what they were at the snapshot are not part of the diff
+  update(1, 0, {int_value(0, 90)});
+  update(1, 0, {int_value(0, 100), int_value(1, 5)});
+  update(2, 1, {});
+  update(3, 2, {int_value(0, 7)});
+  update(4, 2, {int_value(0, 7)});
+  update(4, 3, {});
+
+  dg_alloc_state allocator = dg_arena_create_allocator(&arena);
+  dg_estate_diff diff = dg_estate_snapshot_diff(&state, snapshot, &allocator);
+  ASSERT_EQ(diff.entities_count, 3);
+
+  EXPECT_EQ(diff.entities[0].ent_index, 1);
+  EXPECT_EQ(diff.entities[0].flags, 0);
+  ASSERT_EQ(diff.entities[0].changed_props_count, 1);
+  EXPECT_EQ(diff.entities[0].changed_props[0], 1);
+
+  EXPECT_EQ(diff.entities[1].ent_index, 2);
+  EXPECT_EQ(diff.entities[1].flags, dg_entity_diff_left_pvs);
+  EXPECT_EQ(diff.entities[1].changed_props_count, 0);
+
+  EXPECT_EQ(diff.entities[2].ent_index, 3);
+  EXPECT_EQ(diff.entities[2].flags, dg_entity_diff_created);
+  ASSERT_EQ(diff.entities[2].changed_props_count, 1);
+  EXPECT_EQ(diff.entities[2].changed_props[0], 0);
+
+  dg_estate_snapshot_reset(&state, snapshot);
+  diff = dg_estate_snapshot_diff(&state, snapshot, &allocator);
+  EXPECT_EQ(diff.entities_count, 0);
+
+  update(2, 3, {});
+  update(1, 3, {});
+  update(1, 2, {int_value(1, 5)});
+  diff = dg_estate_snapshot_diff(&state, snapshot, &allocator);
+  ASSERT_EQ(diff.entities_count, 2);
+  EXPECT_EQ(diff.entities[0].ent_index, 2);
+  EXPECT_EQ(diff.entities[0].flags, dg_entity_diff_deleted);
+  EXPECT_EQ(diff.entities[1].ent_index, 1);
+  EXPECT_EQ(diff.entities[1].flags, dg_entity_diff_created | dg_entity_diff_deleted);
+  ASSERT_EQ(diff.entities[1].changed_props_count, 1);
+  EXPECT_EQ(diff.entities[1].changed_props[0], 1);
+
+  // The snapshot is freed along with the entity state
+}
+
+TEST_F(changed_props, history) {
+  state.tick = 10;
+  ASSERT_NE(dg_estate_history_create(&state, 3), nullptr);
+  update(1, 2, {int_value(0, 100)});
+  state.tick = 11;
+  update(1, 0, {int_value(0, 90), int_value(1, 5)});
+  // Only the value from before the first change in a tick is kept
+  update(1, 0, {int_value(0, 80)});
+  state.tick = 12;
+  // Unchanged values are not recorded
+  update(1, 0, {int_value(0, 80)});
+  state.tick = 13;
+  update(1, 3, {});
+
+  EXPECT_EQ(dg_estate_history_get(&state, 1, 0, 9), nullptr);
+  EXPECT_EQ(dg_estate_history_get(&state, 1, 0, 10)->signed_val, 100);
+  EXPECT_EQ(dg_estate_history_get(&state, 1, 1, 10), nullptr);
+  EXPECT_EQ(dg_estate_history_get(&state, 1, 0, 12)->signed_val, 80);
+  EXPECT_EQ(dg_estate_history_get(&state, 1, 1, 12)->signed_val, 5);
+  EXPECT_EQ(dg_estate_history_get(&state, 1, 0, 13), nullptr);
+
+  dg_alloc_state allocator = dg_arena_create_allocator(&arena);
+  dg_prop_history range = dg_estate_history_range(&state, 1, 0, 10, 13, &allocator);
+  ASSERT_EQ(range.entries_count, 3);
+  EXPECT_EQ(range.entries[0].tick, 10);
+  EXPECT_EQ(range.entries[0].value->signed_val, 100);
+  EXPECT_EQ(range.entries[1].tick, 11);
+  EXPECT_EQ(range.entries[1].value->signed_val, 80);
+  EXPECT_EQ(range.entries[2].tick, 13);
+  EXPECT_EQ(range.entries[2].value, nullptr);
+
+  range = dg_estate_history_range(&state, 1, 0, 11, 12, &allocator);
+  ASSERT_EQ(range.entries_count, 1);
+  EXPECT_EQ(range.entries[0].value->signed_val, 80);
+
+  // Recreating the entity pushes tick 10 out of the history
+  state.tick = 14;
+  update(1, 2, {int_value(0, 70)});
+  EXPECT_EQ(dg_estate_history_get(&state, 1, 0, 9), nullptr);
+  EXPECT_EQ(dg_estate_history_get(&state, 1, 0, 10)->signed_val, 100);
+  EXPECT_EQ(dg_estate_history_get(&state, 1, 0, 13), nullptr);
+  EXPECT_EQ(dg_estate_history_get(&state, 1, 0, 14)->signed_val, 70);
+  state.tick = 15;
+  update(1, 0, {int_value(0, 60)});
+  EXPECT_EQ(dg_estate_history_get(&state, 1, 0, 10), nullptr);
+  EXPECT_EQ(dg_estate_history_get(&state, 1, 0, 11)->signed_val, 80);
+  EXPECT_EQ(dg_estate_history_get(&state, 1, 0, 20)->signed_val, 60);
+
+  // The history is freed along with the entity state
+}
@@ -68,7 +68,7 @@ static bool verify_updates(freddie::demo_t* demo) {
   dg_estate_init(&state, args);
 
   for(size_t i=0; i < demo->packets.size() && !result.error; ++i) {
-    packet_parsed *ptr = std::get_if<packet_parsed>(&demo->packets[i]->packet);
+    packet_parsed *ptr = std::get_if<packet_parsed>(&demo->packets[i]);
 
     if(ptr == NULL)
       continue;
@@ -174,6 +174,22 @@ void do_conversion(const Conversion& conversion) {
   }
 
   EXPECT_EQ(output.packets.size(), input.packets.size());
+
+  // Streaming the conversion gives the same demo
+  freddie::memory_stream input_stream;
+  input_stream.fill_with_file(conversion.input.c_str());
+  wrapped_memory_stream streamed;
+  result = freddie::convert_demo(&example, &input_stream,
+                                 {freddie::memory_stream_read, freddie::memory_stream_seek},
+                                 &streamed.underlying, {freddie::memory_stream_write});
+
+  if(result.error)
+  {
+    EXPECT_EQ(result.error, false) << "error streaming conversion: " << result.error_message;
+    return;
+  }
+
+  EXPECT_EQ(streamed.underlying.file_size, output_stream.underlying.file_size);
 }
 
 TEST(convert, test) {
@@ -0,0 +1,154 @@
+extern "C" {
+#include "demogobbler.h"
+#include "demogobbler/bitwriter.h"
+#include "demogobbler/datatable_registry.h"
+#include "demogobbler/version_utils.h"
+}
+
+#include "gtest/gtest.h"
+#include "utils/datatables.hpp"
+#include "utils/memory_stream.hpp"
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST(datatable_registry, shares_entries) {
+  dg_demver_data version = get_version();
+  dg_datatable_registry *registry = dg_datatable_registry_create();
+  const char *error_message = nullptr;
+
+  dg_bitwriter first;
+  dg_bitwriter_init(&first, 1024);
+  write_test_datatables(&first, &version, {{"m_iValue", 8}});
+  dg_datatables message = get_datatables_message(&first);
+
+  auto a = dg_datatable_registry_acquire(registry, &version, &message, &error_message);
+  ASSERT_NE(a, nullptr) << error_message;
+  ASSERT_EQ(a->datatables.serverclass_count, 1);
+  EXPECT_EQ(a->class_datas[0].prop_count, 1);
+  EXPECT_STREQ(a->class_datas[0].props[0]->name, "m_iValue");
+
+  auto b = dg_datatable_registry_acquire(registry, &version, &message, &error_message);
+  EXPECT_EQ(a, b);
+  EXPECT_EQ(dg_datatable_registry_count(registry), 1);
+
+  dg_bitwriter second;
+  dg_bitwriter_init(&second, 1024);
+  write_test_datatables(&second, &version, {{"m_iOther", 8}});
+  message = get_datatables_message(&second);
+  auto c = dg_datatable_registry_acquire(registry, &version, &message, &error_message);
+  ASSERT_NE(c, nullptr) << error_message;
+  EXPECT_NE(a, c);
+  EXPECT_STREQ(c->class_datas[0].props[0]->name, "m_iOther");
+  EXPECT_EQ(dg_datatable_registry_count(registry), 2);
+
+  // Entries in use are not trimmed
+  dg_datatable_registry_release(registry, c);
+  dg_datatable_registry_release(registry, b);
+  EXPECT_EQ(dg_datatable_registry_trim(registry), 1);
+  dg_datatable_registry_release(registry, a);
+  EXPECT_EQ(dg_datatable_registry_trim(registry), 1);
+  EXPECT_EQ(dg_datatable_registry_count(registry), 0);
+
+  dg_bitwriter_free(&first);
+  dg_bitwriter_free(&second);
+  dg_datatable_registry_free(registry);
+}
+
+TEST(datatable_registry, concurrent_acquire) {
+  dg_demver_data version = get_version();
+  dg_datatable_registry *registry = dg_datatable_registry_create();
+  dg_bitwriter writer;
+  dg_bitwriter_init(&writer, 1024);
+  write_test_datatables(&writer, &version, {{"m_iValue", 8}});
+  dg_datatables message = get_datatables_message(&writer);
+
+  // Threads that flatten the same block at the same time all end up with the first entry
+  const dg_shared_datatables *acquired[8];
+  std::vector<std::thread> threads;
+  for (auto &output : acquired) {
+    threads.emplace_back([&, ptr = &output] {
+      const char *error_message = nullptr;
+      *ptr = dg_datatable_registry_acquire(registry, &version, &message, &error_message);
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_EQ(dg_datatable_registry_count(registry), 1);
+  for (auto ptr : acquired) {
+    ASSERT_NE(ptr, nullptr);
+    EXPECT_EQ(ptr, acquired[0]);
+    dg_datatable_registry_release(registry, ptr);
+  }
+  EXPECT_EQ(dg_datatable_registry_trim(registry), 1);
+
+  dg_bitwriter_free(&writer);
+  dg_datatable_registry_free(registry);
+}
+
+namespace {
+struct registry_parse_state {
+  const dg_sendtable *sendtables = nullptr;
+  std::string class_name;
+};
+} // namespace
+
+static void registry_datatables_handler(parser_state *state, dg_datatables_parsed *message) {
+  registry_parse_state *output = (registry_parse_state *)state->client_state;
+  output->sendtables = message->sendtables;
+  output->class_name = message->serverclasses[0].serverclass_name;
+}
+
+TEST(datatable_registry, parse) {
+  dg_demver_data version = get_version();
+  dg_bitwriter dt_writer;
+  dg_bitwriter_init(&dt_writer, 1024);
+  write_test_datatables(&dt_writer, &version, {{"m_iValue", 8}});
+
+  freddie::memory_stream demo;
+  writer w;
+  dg_writer_init(&w);
+  dg_writer_open(&w, &demo, {freddie::memory_stream_write});
+  w.version = version;
+  dg_header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.ID, "HL2DEMO", 8);
+  header.demo_protocol = 3;
+  header.net_protocol = 15;
+  strcpy(header.game_directory, "portal");
+  dg_write_header(&w, &header);
+  dg_datatables message = get_datatables_message(&dt_writer);
+  message.preamble.type = dg_type_datatables;
+  dg_write_datatables(&w, &message);
+  dg_stop stop;
+  memset(&stop, 0, sizeof(stop));
+  dg_write_stop(&w, &stop);
+  dg_writer_close(&w);
+
+  // Both parses get the same flattened datatables out of the registry
+  dg_datatable_registry *registry = dg_datatable_registry_create();
+  registry_parse_state outputs[2];
+  for (auto &output : outputs) {
+    dg_settings settings;
+    dg_settings_init(&settings);
+    settings.client_state = &output;
+    settings.datatable_registry = registry;
+    settings.datatables_parsed_handler = registry_datatables_handler;
+    settings.parse_packetentities = true;
+    auto result = dg_parse_buffer(&settings, demo.buffer, demo.offset);
+    ASSERT_FALSE(result.error) << result.error_message;
+    EXPECT_EQ(output.class_name, "CTest");
+  }
+
+  EXPECT_NE(outputs[0].sendtables, nullptr);
+  EXPECT_EQ(outputs[0].sendtables, outputs[1].sendtables);
+  EXPECT_EQ(dg_datatable_registry_count(registry), 1);
+  // The parsers release their entries when they are done
+  EXPECT_EQ(dg_datatable_registry_trim(registry), 1);
+
+  dg_bitwriter_free(&dt_writer);
+  dg_datatable_registry_free(registry);
+}
@@ -0,0 +1,170 @@
+extern "C" {
+#include "demogobbler.h"
+#include "demogobbler/hashtable.h"
+#include "demogobbler/version_utils.h"
+}
+
+#include "gtest/gtest.h"
+#include "utils/datatables.hpp"
+#include <cstring>
+#include <string>
+#include <vector>
+
+static dg_sendprop create_prop(const char *name, uint8_t priority) {
+  dg_sendprop prop;
+  memset(&prop, 0, sizeof(prop));
+  prop.proptype = sendproptype_int;
+  prop.name = name;
+  prop.priority = priority;
+  prop.prop_numbits = 8;
+  return prop;
+}
+
+static dg_sendprop create_dt_prop(const char *dtname, bool collapsible) {
+  dg_sendprop prop;
+  memset(&prop, 0, sizeof(prop));
+  prop.proptype = sendproptype_datatable;
+  prop.name = dtname;
+  prop.dtname = dtname;
+  prop.flag_collapsible = collapsible;
+  return prop;
+}
+
+static dg_sendtable create_table(const char *name, std::vector<dg_sendprop> &props) {
+  dg_sendtable table;
+  memset(&table, 0, sizeof(table));
+  table.name = name;
+  table.name_length = strlen(name);
+  table.name_hash = dg_hashtable_hash(name, table.name_length);
+  table.props = props.data();
+  table.prop_count = props.size();
+  return table;
+}
+
+class flattening : public ::testing::Test {
+protected:
+  // Names are compared by pointer when checking excludes, as if they came from the string pool
+  const char *root = "DT_Root";
+  const char *base = "DT_Base";
+  const char *inner = "DT_Inner";
+  const char *collapsed = "DT_Collapsed";
+  const char *inner2 = "DT_Inner2";
+  const char *b2 = "b2";
+
+  std::vector<dg_sendprop> root_props;
+  std::vector<dg_sendprop> base_props;
+  std::vector<dg_sendprop> inner_props;
+  std::vector<dg_sendprop> collapsed_props;
+  std::vector<dg_sendprop> inner2_props;
+  dg_sendtable tables[5];
+  dg_serverclass serverclass;
+  dg_datatables_parsed datatables;
+  dg_demver_data version;
+  dg_arena arena;
+  estate state;
+
+  void SetUp() override {
+    root_props = {create_prop("r1", 128), create_dt_prop(base, false), create_prop("r2", 1),
+                  create_dt_prop(collapsed, true), create_prop("r3", 0)};
+    root_props[4].flag_exclude = true;
+    root_props[4].name = b2;
+    root_props[4].exclude_name = base;
+
+    base_props = {create_dt_prop(inner, false), create_prop("b1", 128), create_prop(b2, 1)};
+    // b1 also exists in DT_Base
+    inner_props = {create_prop("i1", 128), create_prop("b1", 128)};
+    inner_props[0].flag_changesoften = true;
+    collapsed_props = {create_dt_prop(inner2, false), create_prop("c1", 0)};
+    inner2_props = {create_prop("j1.000", 128)};
+
+    tables[0] = create_table(root, root_props);
+    tables[1] = create_table(base, base_props);
+    tables[2] = create_table(inner, inner_props);
+    tables[3] = create_table(collapsed, collapsed_props);
+    tables[4] = create_table(inner2, inner2_props);
+
+    for (auto &table : tables) {
+      for (size_t i = 0; i < table.prop_count; ++i) {
+        if (table.props[i].proptype != sendproptype_datatable) {
+          table.props[i].baseclass = &table;
+        }
+      }
+    }
+
+    memset(&serverclass, 0, sizeof(serverclass));
+    serverclass.serverclass_name = "CRoot";
+    serverclass.datatable_name = root;
+
+    memset(&datatables, 0, sizeof(datatables));
+    datatables.sendtables = tables;
+    datatables.sendtable_count = sizeof(tables) / sizeof(*tables);
+    datatables.serverclasses = &serverclass;
+    datatables.serverclass_count = 1;
+
+    version = get_version("portal2", 4, 2001);
+    arena = dg_arena_create(1 << 16);
+    memset(&state, 0, sizeof(state));
+  }
+
+  void TearDown() override {
+    dg_estate_free(&state);
+    dg_arena_free(&arena);
+  }
+
+  void flatten(bool build_prop_lookup) {
+    dg_alloc_state allocator = dg_arena_create_allocator(&arena);
+    estate_init_args args;
+    args.version_data = &version;
+    args.message = &datatables;
+    args.allocator = &allocator;
+    args.flatten_datatables = true;
+    args.should_store_props = false;
+    args.build_prop_lookup = build_prop_lookup;
+    dg_parse_result result = dg_estate_init(&state, args);
+    ASSERT_FALSE(result.error) << result.error_message;
+  }
+};
+
+TEST_F(flattening, matches_engine_order) {
+  flatten(false);
+
+  // Non-collapsible tables come first in depth first order, the priority sort swaps props
+  // around instead of keeping them stable
+  const char *expected[] = {"c1", "r2", "i1", "j1.000", "r1", "b1", "b1"};
+  ASSERT_EQ(state.class_datas[0].prop_count, sizeof(expected) / sizeof(*expected));
+  for (size_t i = 0; i < state.class_datas[0].prop_count; ++i) {
+    EXPECT_STREQ(state.class_datas[0].props[i]->name, expected[i]) << "at index " << i;
+    EXPECT_EQ(state.class_datas[0].flatprops[i].proptype, sendproptype_int);
+    EXPECT_EQ(state.class_datas[0].flatprops[i].type, dg_int_signed);
+    EXPECT_EQ(state.class_datas[0].flatprops[i].prop_numbits, 8);
+  }
+
+  // Flattened props point to the sendtables instead of copying them
+  EXPECT_EQ(state.class_datas[0].props[2], &inner_props[0]);
+  EXPECT_EQ(state.class_datas[0].props[5], &inner_props[1]);
+  EXPECT_EQ(state.class_datas[0].props[6], &base_props[1]);
+}
+
+TEST_F(flattening, find_prop) {
+  for (bool build_prop_lookup : {false, true}) {
+    TearDown();
+    SetUp();
+    flatten(build_prop_lookup);
+    EXPECT_EQ(state.class_datas[0].lookup != nullptr, build_prop_lookup);
+
+    EXPECT_EQ(dg_estate_find_prop(&state, 0, "DT_Root.r1"), 4);
+    EXPECT_EQ(dg_estate_find_prop(&state, 0, "r2"), 1);
+    EXPECT_EQ(dg_estate_find_prop(&state, 0, "DT_Collapsed.c1"), 0);
+    EXPECT_EQ(dg_estate_find_prop(&state, 0, "DT_Inner.b1"), 5);
+    EXPECT_EQ(dg_estate_find_prop(&state, 0, "DT_Base.b1"), 6);
+    // Unqualified names return the first match
+    EXPECT_EQ(dg_estate_find_prop(&state, 0, "b1"), 5);
+    EXPECT_EQ(dg_estate_find_prop(&state, 0, "j1.000"), 3);
+    EXPECT_EQ(dg_estate_find_prop(&state, 0, "DT_Inner2.j1.000"), 3);
+    // Excluded props are not flattened
+    EXPECT_EQ(dg_estate_find_prop(&state, 0, "DT_Base.b2"), -1);
+    EXPECT_EQ(dg_estate_find_prop(&state, 0, "DT_Root.c1"), -1);
+    EXPECT_EQ(dg_estate_find_prop(&state, 0, "missing"), -1);
+    EXPECT_EQ(dg_estate_find_prop(&state, 1, "r1"), -1);
+  }
+}
@@ -0,0 +1,519 @@
+#include "demogobbler.h"
+#include "demogobbler/freddie.hpp"
+#include "demogobbler/version_utils.h"
+#include "utils/datatables.hpp"
+#include "utils/memory_stream.hpp"
+#include "gtest/gtest.h"
+#include <cstring>
+#include <string>
+#include <vector>
+
+static dg_header create_header() {
+  dg_header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.ID, "HL2DEMO", 8);
+  header.demo_protocol = 3;
+  header.net_protocol = 15;
+  strcpy(header.game_directory, "portal");
+  return header;
+}
+
+static void write_consolecmd(writer *thisptr, int32_t tick, const char *cmd) {
+  dg_consolecmd message;
+  memset(&message, 0, sizeof(message));
+  message.preamble.type = dg_type_consolecmd;
+  message.preamble.tick = tick;
+  message.size_bytes = strlen(cmd) + 1;
+  message.data = (char *)cmd;
+  dg_write_consolecmd(thisptr, &message);
+}
+
+static void write_packet(writer *thisptr, int32_t tick) {
+  // Empty packets are skipped by the parser, a zero byte is a single net_nop
+  static uint8_t data = 0;
+  dg_packet message;
+  memset(&message, 0, sizeof(message));
+  message.preamble.type = dg_type_packet;
+  message.preamble.tick = tick;
+  message.size_bytes = 1;
+  message.data = &data;
+  dg_write_packet(thisptr, &message);
+}
+
+// Demo without any game data, covers the message types that don't need datatables
+static void write_test_demo(freddie::memory_stream *output) {
+  writer w;
+  dg_writer_init(&w);
+  dg_writer_open(&w, output, {freddie::memory_stream_write});
+  dg_header header = create_header();
+  w.version = dg_get_demo_version(&header);
+  dg_write_header(&w, &header);
+
+  dg_synctick synctick;
+  memset(&synctick, 0, sizeof(synctick));
+  synctick.preamble.type = dg_type_synctick;
+  dg_write_synctick(&w, &synctick);
+
+  for (int32_t tick = 0; tick < 100; ++tick) {
+    write_packet(&w, tick);
+    if (tick % 10 == 0) {
+      write_consolecmd(&w, tick, "echo hello");
+    }
+  }
+
+  dg_stop stop;
+  memset(&stop, 0, sizeof(stop));
+  dg_write_stop(&w, &stop);
+  dg_writer_close(&w);
+
+  output->file_size = output->offset;
+  output->offset = 0;
+}
+
+namespace {
+struct counting_stream {
+  freddie::memory_stream underlying;
+  size_t writes = 0;
+};
+} // namespace
+
+static size_t counting_stream_write(void *stream, const void *src, size_t bytes) {
+  counting_stream *thisptr = (counting_stream *)stream;
+  ++thisptr->writes;
+  return freddie::memory_stream_write(&thisptr->underlying, src, bytes);
+}
+
+TEST(freddie, buffered_writer) {
+  wrapped_memory_stream input;
+  write_test_demo(&input.underlying);
+
+  freddie::demo_t demo;
+  auto result = freddie::demo_t::parse_demo(&demo, &input.underlying,
+                                            {freddie::memory_stream_read, freddie::memory_stream_seek});
+  ASSERT_FALSE(result.error) << result.error_message;
+
+  // The whole demo fits in the writer buffer
+  counting_stream output;
+  output.underlying.ground_truth = &input.underlying;
+  result = demo.write_demo(&output, {counting_stream_write});
+  ASSERT_FALSE(result.error) << result.error_message;
+  EXPECT_EQ(output.writes, 1);
+  EXPECT_EQ(output.underlying.file_size, input.underlying.file_size);
+  EXPECT_TRUE(output.underlying.agrees);
+
+  // Payloads larger than the buffer are passed on without copying
+  std::vector<uint8_t> payload(1 << 17, 0x55);
+  dg_customdata customdata;
+  memset(&customdata, 0, sizeof(customdata));
+  customdata.preamble.type = dg_type_customdata;
+  customdata.size_bytes = payload.size();
+  customdata.data = payload.data();
+
+  counting_stream large;
+  writer w;
+  dg_writer_init(&w);
+  dg_writer_open(&w, &large, {counting_stream_write});
+  w.version = demo.demver_data;
+  dg_write_customdata(&w, &customdata);
+  dg_write_customdata(&w, &customdata);
+  dg_writer_close(&w);
+
+  const size_t frame_header = 1 + 4 + 4 + 4;
+  ASSERT_EQ(large.underlying.file_size, 2 * (frame_header + payload.size()));
+  EXPECT_EQ(large.writes, 4);
+  auto *bytes = (uint8_t *)large.underlying.buffer;
+  EXPECT_EQ(bytes[frame_header], 0x55);
+  EXPECT_EQ(bytes[2 * frame_header + payload.size()], 0x55);
+  EXPECT_EQ(bytes[large.underlying.file_size - 1], 0x55);
+}
+
+TEST(freddie, parse_and_write) {
+  wrapped_memory_stream input;
+  write_test_demo(&input.underlying);
+
+  freddie::demo_t demo;
+  auto result = freddie::demo_t::parse_demo(&demo, &input.underlying,
+                                            {freddie::memory_stream_read, freddie::memory_stream_seek});
+  ASSERT_FALSE(result.error) << result.error_message;
+
+  // Synctick, 100 packets, 10 console commands and the stop message
+  ASSERT_EQ(demo.packets.size(), 112);
+  EXPECT_TRUE(std::holds_alternative<dg_synctick>(demo.packets.front()));
+  EXPECT_TRUE(std::holds_alternative<dg_stop>(demo.packets.back()));
+  auto *cmd = std::get_if<dg_consolecmd>(&demo.packets[2]);
+  ASSERT_NE(cmd, nullptr);
+  EXPECT_STREQ(cmd->data, "echo hello");
+
+  wrapped_memory_stream output;
+  output.underlying.ground_truth = &input.underlying;
+  result = demo.write_demo(&output.underlying, {freddie::memory_stream_write}, true);
+  ASSERT_FALSE(result.error) << result.error_message;
+  EXPECT_EQ(output.underlying.file_size, input.underlying.file_size);
+}
+
+TEST(freddie, parallel_write) {
+  wrapped_memory_stream input;
+  write_test_demo(&input.underlying);
+
+  freddie::demo_t demo;
+  auto result = freddie::demo_t::parse_demo(&demo, &input.underlying,
+                                            {freddie::memory_stream_read, freddie::memory_stream_seek});
+  ASSERT_FALSE(result.error) << result.error_message;
+
+  // More packets than fit in the window of encoded packets
+  for (unsigned threads : {2u, 4u, 0u}) {
+    wrapped_memory_stream output;
+    output.underlying.ground_truth = &input.underlying;
+    result = demo.write_demo(&output.underlying, {freddie::memory_stream_write}, true, threads);
+    ASSERT_FALSE(result.error) << result.error_message;
+    EXPECT_EQ(output.underlying.file_size, input.underlying.file_size);
+  }
+}
+
+TEST(freddie, unmodified_passthrough) {
+  wrapped_memory_stream input;
+  write_test_demo(&input.underlying);
+
+  freddie::demo_t demo;
+  auto result = freddie::demo_t::parse_demo(&demo, &input.underlying,
+                                            {freddie::memory_stream_read, freddie::memory_stream_seek});
+  ASSERT_FALSE(result.error) << result.error_message;
+
+  // Point the original data somewhere else, the messages still encode to a single byte
+  static uint8_t replacement[2] = {0, 0};
+  auto *unmodified = std::get_if<packet_parsed>(&demo.packets[1]);
+  auto *modified = std::get_if<packet_parsed>(&demo.packets[3]);
+  for (auto *packet : {unmodified, modified}) {
+    packet->orig.data = replacement;
+    packet->orig.size_bytes = sizeof(replacement);
+  }
+  modified->modified = true;
+
+  // Passthrough is opt-in, by default every parsed packet is encoded
+  for (bool passthrough : {false, true}) {
+    demo.passthrough_unmodified = passthrough;
+    for (unsigned threads : {1u, 2u}) {
+      freddie::memory_stream output;
+      result = demo.write_demo(&output, {freddie::memory_stream_write}, false, threads);
+      ASSERT_FALSE(result.error) << result.error_message;
+      output.file_size = output.offset;
+      output.offset = 0;
+
+      freddie::demo_t copy;
+      result = freddie::demo_t::parse_demo(
+          &copy, &output, {freddie::memory_stream_read, freddie::memory_stream_seek});
+      ASSERT_FALSE(result.error) << result.error_message;
+      ASSERT_EQ(copy.packets.size(), demo.packets.size());
+      EXPECT_EQ(std::get_if<packet_parsed>(&copy.packets[1])->orig.size_bytes,
+                passthrough ? 2 : 1);
+      EXPECT_EQ(std::get_if<packet_parsed>(&copy.packets[3])->orig.size_bytes, 1);
+    }
+  }
+}
+
+TEST(freddie, lazy_decode) {
+  wrapped_memory_stream input;
+  write_test_demo(&input.underlying);
+
+  freddie::demo_t demo;
+  auto result = freddie::demo_t::parse_demo_lazy(
+      &demo, &input.underlying, {freddie::memory_stream_read, freddie::memory_stream_seek}, 2);
+  ASSERT_FALSE(result.error) << result.error_message;
+  ASSERT_EQ(demo.packets.size(), 112);
+  EXPECT_TRUE(std::holds_alternative<dg_packet>(demo.packets[1]));
+  EXPECT_EQ(demo.get_packet(0), nullptr);
+
+  packet_parsed *first = demo.get_packet(1);
+  ASSERT_NE(first, nullptr);
+  EXPECT_EQ(first->orig.preamble.tick, 0);
+  ASSERT_EQ(first->message_count, 1);
+  EXPECT_EQ(first->messages[0].mtype, net_nop);
+  EXPECT_EQ(demo.get_packet(1), first);
+
+  // Decoding more packets than fit in the cache evicts the least recently used one
+  packet_parsed *second = demo.get_packet(3);
+  ASSERT_NE(second, nullptr);
+  EXPECT_EQ(second->orig.preamble.tick, 1);
+  EXPECT_EQ(demo.get_packet(1), first);
+  packet_parsed *third = demo.get_packet(4);
+  ASSERT_NE(third, nullptr);
+  EXPECT_EQ(third, second);
+  EXPECT_EQ(third->orig.preamble.tick, 2);
+  EXPECT_EQ(demo.get_packet(1)->orig.preamble.tick, 0);
+
+  // Packets are written out from the raw data
+  wrapped_memory_stream output;
+  output.underlying.ground_truth = &input.underlying;
+  result = demo.write_demo(&output.underlying, {freddie::memory_stream_write}, true);
+  ASSERT_FALSE(result.error) << result.error_message;
+  EXPECT_EQ(output.underlying.file_size, input.underlying.file_size);
+}
+
+TEST(freddie, indices) {
+  wrapped_memory_stream input;
+  write_test_demo(&input.underlying);
+
+  freddie::demo_t demo;
+  auto result = freddie::demo_t::parse_demo(&demo, &input.underlying,
+                                            {freddie::memory_stream_read, freddie::memory_stream_seek});
+  ASSERT_FALSE(result.error) << result.error_message;
+
+  for (int pass = 0; pass < 2; ++pass) {
+    EXPECT_TRUE(demo.ticks_sorted);
+    auto range = demo.get_tick_range(0);
+    EXPECT_EQ(range.first, 0);
+    EXPECT_EQ(range.last, 3);
+    range = demo.get_tick_range(10);
+    EXPECT_EQ(range.first, 12);
+    EXPECT_EQ(range.last, 14);
+    // Stop has no tick of its own
+    range = demo.get_tick_range(99);
+    EXPECT_EQ(range.first, 110);
+    EXPECT_EQ(range.last, 112);
+    range = demo.get_tick_range(100);
+    EXPECT_EQ(range.first, range.last);
+
+    EXPECT_EQ(demo.get_packets_of_type<packet_parsed>().size(), 100);
+    ASSERT_EQ(demo.get_packets_of_type<dg_consolecmd>().size(), 10);
+    EXPECT_EQ(demo.get_packets_of_type<dg_consolecmd>()[1], 13);
+    EXPECT_TRUE(demo.get_packets_of_type<dg_datatables_parsed>().empty());
+    EXPECT_EQ(demo.get_datatables(), nullptr);
+
+    auto &nops = demo.get_netmessages(net_nop);
+    ASSERT_EQ(nops.size(), 100);
+    EXPECT_EQ(nops[1].packet_index, 3);
+    EXPECT_EQ(nops[1].message_index, 0);
+    EXPECT_EQ(demo.get_netmessage(nops[1])->mtype, net_nop);
+    EXPECT_TRUE(demo.get_netmessages(svc_packet_entities).empty());
+
+    demo.rebuild_indices();
+  }
+}
+
+TEST(freddie, transform_stream) {
+  wrapped_memory_stream input;
+  write_test_demo(&input.underlying);
+
+  // Without transforms the demo is copied as is, held messages keep their order
+  for (bool hold : {false, true}) {
+    freddie::stream_settings settings;
+    settings.hold_until_datatables = hold;
+    input.underlying.offset = 0;
+    wrapped_memory_stream output;
+    output.underlying.ground_truth = &input.underlying;
+    auto result = freddie::transform_demo(
+        &input.underlying, {freddie::memory_stream_read, freddie::memory_stream_seek},
+        &output.underlying, {freddie::memory_stream_write}, settings);
+    ASSERT_FALSE(result.error) << result.error_message;
+    EXPECT_EQ(output.underlying.file_size, input.underlying.file_size);
+  }
+
+  size_t commands = 0;
+  freddie::stream_settings settings;
+  settings.header_func = [](dg_header *header, dg_demver_data *version) {
+    strcpy(header->map_name, "transformed");
+    dg_parse_result result;
+    memset(&result, 0, sizeof(result));
+    return result;
+  };
+  settings.transforms.push_back([&commands](freddie::packet_variant_t *message,
+                                            dg_alloc_state *allocator) {
+    dg_parse_result result;
+    memset(&result, 0, sizeof(result));
+    auto *cmd = std::get_if<dg_consolecmd>(message);
+    if (cmd) {
+      const char replacement[] = "echo bye";
+      cmd->data = (char *)dg_alloc_allocate(allocator, sizeof(replacement), 1);
+      memcpy(cmd->data, replacement, sizeof(replacement));
+      cmd->size_bytes = sizeof(replacement);
+      ++commands;
+    }
+    return result;
+  });
+
+  input.underlying.offset = 0;
+  freddie::memory_stream output;
+  auto result = freddie::transform_demo(
+      &input.underlying, {freddie::memory_stream_read, freddie::memory_stream_seek}, &output,
+      {freddie::memory_stream_write}, settings);
+  ASSERT_FALSE(result.error) << result.error_message;
+  EXPECT_EQ(commands, 10);
+  output.file_size = output.offset;
+  output.offset = 0;
+
+  freddie::demo_t demo;
+  result = freddie::demo_t::parse_demo(&demo, &output,
+                                       {freddie::memory_stream_read, freddie::memory_stream_seek});
+  ASSERT_FALSE(result.error) << result.error_message;
+  ASSERT_EQ(demo.packets.size(), 112);
+  EXPECT_STREQ(demo.header.map_name, "transformed");
+  for (auto index : demo.get_packets_of_type<dg_consolecmd>()) {
+    EXPECT_STREQ(std::get_if<dg_consolecmd>(&demo.packets[index])->data, "echo bye");
+  }
+
+  // Conversion needs the datatables
+  input.underlying.offset = 0;
+  freddie::memory_stream converted;
+  result = freddie::convert_demo(&demo, &input.underlying,
+                                 {freddie::memory_stream_read, freddie::memory_stream_seek},
+                                 &converted, {freddie::memory_stream_write});
+  EXPECT_TRUE(result.error);
+  EXPECT_STREQ(result.error_message, "missing datatable");
+}
+
+// Demo with a single datatables message, optionally with a packet in front of it
+static void write_datatables_demo(freddie::memory_stream *output, dg_header header,
+                                  bool packet_first) {
+  writer w;
+  dg_writer_init(&w);
+  dg_writer_open(&w, output, {freddie::memory_stream_write});
+  w.version = dg_get_demo_version(&header);
+  dg_write_header(&w, &header);
+  if (packet_first) {
+    write_packet(&w, 0);
+  }
+
+  dg_bitwriter dt_writer;
+  dg_bitwriter_init(&dt_writer, 1024);
+  write_test_datatables(&dt_writer, &w.version, {{"m_iValue", 8}});
+  dg_datatables message = get_datatables_message(&dt_writer);
+  message.preamble.type = dg_type_datatables;
+  dg_write_datatables(&w, &message);
+  dg_bitwriter_free(&dt_writer);
+
+  dg_stop stop;
+  memset(&stop, 0, sizeof(stop));
+  dg_write_stop(&w, &stop);
+  dg_writer_close(&w);
+
+  output->file_size = output->offset;
+  output->offset = 0;
+}
+
+TEST(freddie, stream_version_update) {
+  // The build of a protocol 2042 L4D2 demo is only known once the signon has been parsed
+  dg_header header = create_header();
+  header.demo_protocol = 4;
+  header.net_protocol = 2042;
+  strcpy(header.game_directory, "left4dead2");
+  wrapped_memory_stream input;
+  write_datatables_demo(&input.underlying, header, true);
+
+  std::vector<dg_demver_data> versions;
+  freddie::stream_settings settings;
+  settings.header_func = [&versions](dg_header *header, dg_demver_data *version) {
+    versions.push_back(*version);
+    dg_parse_result result;
+    memset(&result, 0, sizeof(result));
+    return result;
+  };
+  settings.version_func = [&versions](dg_demver_data *version) {
+    versions.push_back(*version);
+    dg_parse_result result;
+    memset(&result, 0, sizeof(result));
+    return result;
+  };
+  freddie::memory_stream output;
+  auto result = freddie::transform_demo(
+      &input.underlying, {freddie::memory_stream_read, freddie::memory_stream_seek}, &output,
+      {freddie::memory_stream_write}, settings);
+  ASSERT_FALSE(result.error) << result.error_message;
+  ASSERT_EQ(versions.size(), 2);
+  EXPECT_FALSE(versions[0].l4d2_version_finalized);
+  EXPECT_TRUE(versions[1].l4d2_version_finalized);
+
+  // The converter picks up the finalized version before the datatables arrive
+  wrapped_memory_stream example_input;
+  write_datatables_demo(&example_input.underlying, create_header(), false);
+  freddie::demo_t example;
+  result = freddie::demo_t::parse_demo(&example, &example_input.underlying,
+                                       {freddie::memory_stream_read, freddie::memory_stream_seek});
+  ASSERT_FALSE(result.error) << result.error_message;
+
+  input.underlying.offset = 0;
+  freddie::memory_stream converted;
+  result = freddie::convert_demo(&example, &input.underlying,
+                                 {freddie::memory_stream_read, freddie::memory_stream_seek},
+                                 &converted, {freddie::memory_stream_write});
+  ASSERT_FALSE(result.error) << result.error_message;
+  converted.file_size = converted.offset;
+  converted.offset = 0;
+
+  freddie::demo_t demo;
+  result = freddie::demo_t::parse_demo(&demo, &converted,
+                                       {freddie::memory_stream_read, freddie::memory_stream_seek});
+  ASSERT_FALSE(result.error) << result.error_message;
+  EXPECT_STREQ(demo.header.game_directory, "portal");
+  EXPECT_EQ(demo.header.net_protocol, 15);
+  ASSERT_NE(demo.get_datatables(), nullptr);
+  EXPECT_STREQ(demo.get_datatables()->serverclasses[0].serverclass_name, "CTest");
+}
+
+TEST(freddie, change_info) {
+  dg_demver_data version = get_version();
+  dg_arena arena = dg_arena_create(1 << 16);
+  dg_alloc_state allocator = dg_arena_create_allocator(&arena);
+
+  dg_bitwriter input_writer, target_writer;
+  dg_bitwriter_init(&input_writer, 1024);
+  dg_bitwriter_init(&target_writer, 1024);
+  write_test_datatables(&input_writer, &version, {{"m_iA", 8}, {"m_iB", 8}, {"m_iC", 8}});
+  write_test_datatables(&target_writer, &version, {{"m_iC", 8}, {"m_iA", 16}});
+  auto input = parse_test_datatables(&input_writer, &version, &allocator);
+  ASSERT_FALSE(input.error) << input.error_message;
+  auto target = parse_test_datatables(&target_writer, &version, &allocator);
+  ASSERT_FALSE(target.error) << target.error_message;
+
+  {
+    freddie::datatable_change_info info(allocator);
+    auto result = info.init(&input.output, &version, &target.output, &version);
+    ASSERT_FALSE(result.error) << result.error_message;
+
+    auto dt_status = info.get_datatable_status(0);
+    EXPECT_TRUE(dt_status.exists);
+    EXPECT_TRUE(dt_status.props_changed);
+    EXPECT_EQ(dt_status.index, 0);
+    EXPECT_FALSE(info.get_datatable_status(1).exists);
+
+    ASSERT_EQ(info.input_estate.class_datas[0].prop_count, 3);
+    for (uint32_t i = 0; i < 3; ++i) {
+      std::string name = info.input_estate.class_datas[0].props[i]->name;
+      auto status = info.get_prop_status(0, i);
+      if (name == "m_iB") {
+        EXPECT_FALSE(status.exists);
+      } else {
+        ASSERT_TRUE(status.exists) << name;
+        EXPECT_EQ(info.target_estate.class_datas[0].props[status.index], status.target);
+        EXPECT_EQ(status.target->name, name);
+        EXPECT_EQ(status.flags_changed, name == "m_iA");
+      }
+    }
+    EXPECT_FALSE(info.get_prop_status(0, 3).exists);
+    EXPECT_FALSE(info.get_prop_status(1, 0).exists);
+
+    // Deleted props are dropped and the rest are remapped and sorted
+    prop_value values[3];
+    memset(values, 0, sizeof(values));
+    for (uint32_t i = 0; i < 3; ++i) {
+      values[i].prop_index = i;
+    }
+    dg_ent_update update;
+    memset(&update, 0, sizeof(update));
+    update.prop_value_array = values;
+    update.prop_value_array_size = 3;
+    dg_packetentities_data data;
+    memset(&data, 0, sizeof(data));
+    data.ent_updates = &update;
+    data.ent_updates_count = 1;
+
+    result = info.convert_updates(&data);
+    ASSERT_FALSE(result.error) << result.error_message;
+    ASSERT_EQ(update.prop_value_array_size, 2);
+    EXPECT_EQ(values[0].prop_index, 0);
+    EXPECT_EQ(values[1].prop_index, 1);
+  }
+
+  dg_bitwriter_free(&input_writer);
+  dg_bitwriter_free(&target_writer);
+  dg_arena_free(&arena);
+}
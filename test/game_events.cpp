@@ -0,0 +1,94 @@
+extern "C" {
+#include "demogobbler.h"
+#include "demogobbler/bitwriter.h"
+}
+
+#include "gtest/gtest.h"
+
+static void write_descriptor(dg_bitwriter *writer, uint32_t id, const char *name,
+                             std::initializer_list<std::pair<uint32_t, const char *>> keys) {
+  dg_bitwriter_write_uint(writer, id, 9);
+  dg_bitwriter_write_cstring(writer, name);
+  for (auto &key : keys) {
+    dg_bitwriter_write_uint(writer, key.first, 3);
+    dg_bitwriter_write_cstring(writer, key.second);
+  }
+  dg_bitwriter_write_uint(writer, dg_gekey_local, 3);
+}
+
+TEST(game_events, list_and_event) {
+  dg_arena arena = dg_arena_create(4096);
+  dg_alloc_state allocator = dg_arena_create_allocator(&arena);
+
+  dg_bitwriter writer;
+  dg_bitwriter_init(&writer, 4096);
+  write_descriptor(&writer, 3, "player_death",
+                   {{dg_gekey_short, "userid"},
+                    {dg_gekey_short, "attacker"},
+                    {dg_gekey_string, "weapon"},
+                    {dg_gekey_bool, "headshot"}});
+  write_descriptor(&writer, 7, "player_hurt",
+                   {{dg_gekey_short, "userid"}, {dg_gekey_byte, "health"}});
+
+  dg_game_event_list list;
+  dg_game_event_list_parse_args list_args;
+  list_args.allocator = &allocator;
+  list_args.events = 2;
+  list_args.stream = dg_bitstream_create(writer.ptr, writer.bitoffset);
+  auto result = dg_parse_game_event_list(&list, &list_args);
+  ASSERT_EQ(result.error, false);
+  ASSERT_EQ(list.descriptor_count, 8);
+  EXPECT_EQ(list.descriptors[0].name, nullptr);
+
+  const dg_game_event_descriptor *death = dg_game_event_list_find(&list, "player_death");
+  const dg_game_event_descriptor *hurt = dg_game_event_list_find(&list, "player_hurt");
+  ASSERT_NE(death, nullptr);
+  ASSERT_NE(hurt, nullptr);
+  EXPECT_EQ(death->event_id, 3);
+  EXPECT_EQ(death->key_count, 4);
+  EXPECT_EQ(dg_game_event_find_key(death, "weapon"), 2);
+  EXPECT_EQ(dg_game_event_find_key(death, "nonexistent"), -1);
+  EXPECT_EQ(death->keys[0].key_value, hurt->keys[0].key_value); // Interned
+
+  writer.bitoffset = 0;
+  dg_bitwriter_write_uint(&writer, 3, 9);
+  dg_bitwriter_write_uint(&writer, 5, 16);
+  dg_bitwriter_write_sint(&writer, -1, 16);
+  dg_bitwriter_write_cstring(&writer, "pistol");
+  dg_bitwriter_write_bit(&writer, true);
+
+  dg_game_event_parsed parsed;
+  dg_game_event_parse_args event_args;
+  event_args.allocator = &allocator;
+  event_args.list = &list;
+  event_args.stream = dg_bitstream_create(writer.ptr, writer.bitoffset);
+  result = dg_parse_game_event(&parsed, &event_args);
+  ASSERT_EQ(result.error, false);
+  ASSERT_EQ(parsed.descriptor, death);
+  ASSERT_NE(parsed.values, nullptr);
+  EXPECT_EQ(parsed.values[0].int_val, 5);
+  EXPECT_EQ(parsed.values[1].int_val, -1);
+  EXPECT_STREQ(parsed.values[2].str_val, "pistol");
+  EXPECT_EQ(parsed.values[3].bool_val, true);
+
+  list.descriptors[3].subscribed = false;
+  result = dg_parse_game_event(&parsed, &event_args);
+  EXPECT_EQ(result.error, false);
+  EXPECT_EQ(parsed.descriptor, death);
+  EXPECT_EQ(parsed.values, nullptr);
+
+  // Events that are not in the list are skipped
+  for (uint32_t id : {0, 8, 511}) {
+    writer.bitoffset = 0;
+    dg_bitwriter_write_uint(&writer, id, 9);
+    dg_bitwriter_write_uint(&writer, 5, 16);
+    event_args.stream = dg_bitstream_create(writer.ptr, writer.bitoffset);
+    result = dg_parse_game_event(&parsed, &event_args);
+    EXPECT_EQ(result.error, false) << id;
+    EXPECT_EQ(parsed.descriptor, nullptr);
+    EXPECT_EQ(parsed.values, nullptr);
+  }
+
+  dg_bitwriter_free(&writer);
+  dg_arena_free(&arena);
+}
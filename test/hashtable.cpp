@@ -3,6 +3,8 @@ extern "C" {
 }
 
 #include "gtest/gtest.h"
+#include <string>
+#include <vector>
 
 TEST(dg_hashtable, works) {
   auto table = dg_hashtable_create(100);
@@ -26,3 +28,58 @@ TEST(dg_hashtable, works) {
 
   dg_hashtable_free(&table);
 }
+
+TEST(dg_hashtable, grows) {
+  auto table = dg_hashtable_create(1);
+  std::vector<std::string> strings;
+  for (size_t i = 0; i < 1000; ++i) {
+    strings.push_back("DT_Table" + std::to_string(i));
+  }
+
+  for (size_t i = 0; i < strings.size(); ++i) {
+    dg_hashtable_entry entry;
+    entry.str = strings[i].c_str();
+    entry.value = i;
+    EXPECT_EQ(dg_hashtable_insert(&table, entry), true);
+  }
+
+  EXPECT_EQ(table.item_count, strings.size());
+
+  for (size_t i = 0; i < strings.size(); ++i) {
+    const char *str = strings[i].c_str();
+    uint32_t hash = dg_hashtable_hash(str, strings[i].size());
+    dg_hashtable_entry got = dg_hashtable_get_hashed(&table, str, strings[i].size(), hash);
+    EXPECT_EQ(got.str, str);
+    EXPECT_EQ(got.value, i);
+  }
+
+  dg_hashtable_clear(&table);
+  EXPECT_EQ(dg_hashtable_get(&table, strings[0].c_str()).str, nullptr);
+
+  dg_hashtable_free(&table);
+}
+
+TEST(dg_string_pool, interns) {
+  dg_arena arena = dg_arena_create(1024);
+  dg_alloc_state allocator = dg_arena_create_allocator(&arena);
+  dg_string_pool pool = dg_string_pool_create(&allocator, 16);
+
+  std::string first = "m_vecOrigin";
+  std::string second = "m_vecOrigin";
+  const char *a = dg_string_pool_intern(&pool, first.c_str(), first.size(),
+                                        dg_hashtable_hash(first.c_str(), first.size()));
+  const char *b = dg_string_pool_intern(&pool, second.c_str(), second.size(),
+                                        dg_hashtable_hash(second.c_str(), second.size()));
+  const char *c = dg_string_pool_intern(&pool, "m_angRotation", 13,
+                                        dg_hashtable_hash("m_angRotation", 13));
+
+  EXPECT_NE(a, first.c_str());
+  EXPECT_EQ(a, b);
+  EXPECT_NE(a, c);
+  EXPECT_STREQ(a, "m_vecOrigin");
+  EXPECT_STREQ(c, "m_angRotation");
+  EXPECT_EQ(pool.table.item_count, 2);
+
+  dg_string_pool_free(&pool);
+  dg_arena_free(&arena);
+}
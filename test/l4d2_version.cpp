@@ -1,7 +1,12 @@
 #include "gtest/gtest.h"
 extern "C" {
+  #include "demogobbler.h"
+  #include "demogobbler/bitwriter.h"
   #include "demogobbler/version_utils.h"
 }
+#include "utils/memory_stream.hpp"
+#include <cstring>
+#include <vector>
 
 void test_l4d2_version(bool expected, int expected_build, const char* str) {
   int build_number = 0;
@@ -28,4 +33,70 @@ TEST(L4D2_version, works) {
 
 TEST(L4D2_version, random_other_strings) {
   test_l4d2_version(false, 0, "user has paused the game.");
-}
\ No newline at end of file
+}
+
+static void record_version(parser_state *state, dg_demver_data version) {
+  auto *versions = (std::vector<dg_demver_data> *)state->client_state;
+  versions->push_back(version);
+}
+
+// Protocol 2042 demo with a signon packet that prints the given text
+static std::vector<dg_demver_data> sniff_version(const char *print) {
+  dg_header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.ID, "HL2DEMO", 8);
+  header.demo_protocol = 4;
+  header.net_protocol = 2042;
+  strcpy(header.game_directory, "left4dead2");
+
+  freddie::memory_stream demo;
+  writer w;
+  dg_writer_init(&w);
+  dg_writer_open(&w, &demo, {freddie::memory_stream_write});
+  w.version = dg_get_demo_version(&header);
+  dg_write_header(&w, &header);
+
+  dg_bitwriter bits;
+  dg_bitwriter_init(&bits, 1024);
+  dg_bitwriter_write_uint(&bits, w.version.netmessage_ids[svc_print],
+                          w.version.netmessage_type_bits);
+  dg_bitwriter_write_cstring(&bits, print);
+  dg_packet packet;
+  memset(&packet, 0, sizeof(packet));
+  packet.preamble.type = dg_type_signon;
+  packet.size_bytes = (bits.bitoffset + 7) / 8;
+  packet.data = bits.ptr;
+  dg_write_packet(&w, &packet);
+  dg_bitwriter_free(&bits);
+
+  dg_stop stop;
+  memset(&stop, 0, sizeof(stop));
+  dg_write_stop(&w, &stop);
+  dg_writer_close(&w);
+
+  std::vector<dg_demver_data> versions;
+  dg_settings settings;
+  dg_settings_init(&settings);
+  settings.client_state = &versions;
+  settings.demo_version_handler = record_version;
+  auto result = dg_parse_buffer(&settings, demo.buffer, demo.offset);
+  EXPECT_FALSE(result.error) << result.error_message;
+
+  return versions;
+}
+
+TEST(L4D2_version, sniffed_from_signon) {
+  auto versions = sniff_version("\nLeft 4 Dead 2\nMap: c6m2_bedlam\nPlayers: 1 (0 bots) / 4 "
+                                "humans\nBuild: 4710\nServer Number: 3\n\n");
+  ASSERT_EQ(versions.size(), 2);
+  EXPECT_FALSE(versions[0].l4d2_version_finalized);
+  EXPECT_EQ(versions[0].l4d2_version, 2042);
+  EXPECT_TRUE(versions[1].l4d2_version_finalized);
+  EXPECT_EQ(versions[1].l4d2_version, 2091);
+
+  // Builds that don't change the protocol finalize the version as it was
+  versions = sniff_version("user has paused the game.");
+  ASSERT_EQ(versions.size(), 2);
+  EXPECT_TRUE(versions[1].l4d2_version_finalized);
+  EXPECT_EQ(versions[1].l4d2_version, 2042);
+}
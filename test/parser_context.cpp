@@ -0,0 +1,170 @@
+extern "C" {
+#include "demogobbler.h"
+}
+
+#include "utils/datatables.hpp"
+#include "utils/memory_stream.hpp"
+#include "gtest/gtest.h"
+#include <cstring>
+#include <string>
+#include <vector>
+
+static void write_bytes(std::vector<uint8_t> &out, const void *data, size_t size) {
+  const uint8_t *bytes = (const uint8_t *)data;
+  out.insert(out.end(), bytes, bytes + size);
+}
+
+static void write_int(std::vector<uint8_t> &out, int32_t value) {
+  write_bytes(out, &value, sizeof(value));
+}
+
+static std::vector<uint8_t> create_demo(const char *command) {
+  std::vector<uint8_t> out;
+  dg_header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.ID, "HL2DEMO", 8);
+  header.demo_protocol = 3;
+  header.net_protocol = 15;
+  strcpy(header.game_directory, "portal");
+
+  write_bytes(out, header.ID, sizeof(header.ID));
+  write_int(out, header.demo_protocol);
+  write_int(out, header.net_protocol);
+  write_bytes(out, header.server_name, 260);
+  write_bytes(out, header.client_name, 260);
+  write_bytes(out, header.map_name, 260);
+  write_bytes(out, header.game_directory, 260);
+  write_bytes(out, &header.seconds, sizeof(header.seconds));
+  write_int(out, header.tick_count);
+  write_int(out, header.frame_count);
+  write_int(out, header.signon_length);
+
+  out.push_back(dg_type_consolecmd);
+  write_int(out, 0);
+  write_int(out, strlen(command) + 1);
+  write_bytes(out, command, strlen(command) + 1);
+  out.push_back(dg_type_stop);
+
+  return out;
+}
+
+static void consolecmd_handler(parser_state *state, dg_consolecmd *message) {
+  std::string *out = (std::string *)state->client_state;
+  *out = message->data;
+}
+
+TEST(parser_context, reuse) {
+  dg_parser_context context = dg_parser_context_create();
+  std::string command;
+
+  dg_settings settings;
+  dg_settings_init(&settings);
+  settings.client_state = &command;
+  settings.consolecmd_handler = consolecmd_handler;
+
+  const char *commands[] = {"+jump", "-jump", "echo hello"};
+
+  for (const char *expected : commands) {
+    auto demo = create_demo(expected);
+    auto result = dg_parse_buffer_with_context(&context, &settings, demo.data(), demo.size());
+    ASSERT_EQ(result.error, false) << result.error_message;
+    EXPECT_EQ(command, expected);
+    // The settings should not be left pointing to the context's arenas
+    EXPECT_EQ(settings.permanent_alloc_state.allocator, nullptr);
+  }
+
+  dg_parser_context_free(&context);
+}
+
+namespace {
+struct warm_parse_output {
+  std::vector<std::string> class_names;
+  std::vector<size_t> prop_counts;
+};
+
+struct arena_usage {
+  uint32_t block_count = 0;
+  size_t total_bytes = 0;
+  size_t bytes_used = 0;
+
+  bool operator==(const arena_usage &rhs) const {
+    return block_count == rhs.block_count && total_bytes == rhs.total_bytes &&
+           bytes_used == rhs.bytes_used;
+  }
+};
+} // namespace
+
+static arena_usage get_usage(const dg_arena *arena) {
+  arena_usage usage;
+  usage.block_count = arena->block_count;
+  for (uint32_t i = 0; i < arena->block_count; ++i) {
+    usage.total_bytes += arena->blocks[i].total_bytes;
+    usage.bytes_used += arena->blocks[i].bytes_used;
+  }
+  return usage;
+}
+
+static void flattened_props_handler(parser_state *state) {
+  warm_parse_output *output = (warm_parse_output *)state->client_state;
+  for (size_t i = 0; i < state->entity_state.serverclass_count; ++i) {
+    output->class_names.push_back(state->entity_state.serverclasses[i].serverclass_name);
+    output->prop_counts.push_back(state->entity_state.class_datas[i].prop_count);
+  }
+}
+
+TEST(parser_context, warm_parse_matches) {
+  dg_demver_data version = get_version();
+  dg_bitwriter dt_writer;
+  dg_bitwriter_init(&dt_writer, 1024);
+  write_test_datatables(&dt_writer, &version, {{"m_iFirst", 8}, {"m_iSecond", 8}});
+
+  freddie::memory_stream demo;
+  writer w;
+  dg_writer_init(&w);
+  dg_writer_open(&w, &demo, {freddie::memory_stream_write});
+  w.version = version;
+  dg_header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.ID, "HL2DEMO", 8);
+  header.demo_protocol = 3;
+  header.net_protocol = 15;
+  strcpy(header.game_directory, "portal");
+  dg_write_header(&w, &header);
+  dg_datatables message = get_datatables_message(&dt_writer);
+  message.preamble.type = dg_type_datatables;
+  dg_write_datatables(&w, &message);
+  dg_stop stop;
+  memset(&stop, 0, sizeof(stop));
+  dg_write_stop(&w, &stop);
+  dg_writer_close(&w);
+
+  // The first parse warms the context up, the ones after it should not need more memory
+  dg_parser_context context = dg_parser_context_create();
+  warm_parse_output outputs[3];
+  arena_usage permanent[3];
+  arena_usage temp[3];
+  for (int i = 0; i < 3; ++i) {
+    dg_settings settings;
+    dg_settings_init(&settings);
+    settings.client_state = outputs + i;
+    settings.flattened_props_handler = flattened_props_handler;
+    settings.parse_packetentities = true;
+    auto result = dg_parse_buffer_with_context(&context, &settings, demo.buffer, demo.offset);
+    ASSERT_FALSE(result.error) << result.error_message;
+    permanent[i] = get_usage(&context.permanent_arena);
+    temp[i] = get_usage(&context.temp_arena);
+  }
+
+  ASSERT_EQ(outputs[0].class_names.size(), 1);
+  EXPECT_EQ(outputs[0].class_names[0], "CTest");
+  EXPECT_EQ(outputs[0].prop_counts[0], 2);
+  for (int i = 1; i < 3; ++i) {
+    EXPECT_EQ(outputs[i].class_names, outputs[0].class_names);
+    EXPECT_EQ(outputs[i].prop_counts, outputs[0].prop_counts);
+  }
+  EXPECT_TRUE(permanent[1] == permanent[2]);
+  EXPECT_TRUE(temp[1] == temp[2]);
+
+  dg_parser_context_free(&context);
+  dg_bitwriter_free(&dt_writer);
+}
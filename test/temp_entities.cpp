@@ -0,0 +1,100 @@
+#include "demogobbler.h"
+#include "demogobbler/bitwriter.h"
+#include "utils/datatables.hpp"
+#include "gtest/gtest.h"
+#include <cstring>
+#include <vector>
+
+static void write_temp_entity_props(dg_bitwriter *writer, const dg_demver_data *version,
+                                    std::vector<prop_value> props) {
+  dg_ent_update update;
+  memset(&update, 0, sizeof(update));
+  update.prop_value_array = props.data();
+  update.prop_value_array_size = props.size();
+  dg_bitwriter_write_props(writer, version, &update);
+}
+
+TEST(temp_entities, parse) {
+  dg_demver_data version = get_version();
+  dg_arena arena = dg_arena_create(1 << 16);
+  dg_alloc_state allocator = dg_arena_create_allocator(&arena);
+  dg_bitwriter dt_writer;
+  dg_bitwriter_init(&dt_writer, 1024);
+  write_test_datatables(&dt_writer, &version, {{"m_iFirst", 8}, {"m_iSecond", 8}});
+  auto parsed = parse_test_datatables(&dt_writer, &version, &allocator);
+  ASSERT_FALSE(parsed.error) << parsed.error_message;
+
+  estate entity_state;
+  memset(&entity_state, 0, sizeof(entity_state));
+  estate_init_args init_args;
+  init_args.allocator = &allocator;
+  init_args.flatten_datatables = true;
+  init_args.message = &parsed.output;
+  init_args.should_store_props = false;
+  init_args.build_prop_lookup = false;
+  init_args.version_data = &version;
+  auto result = dg_estate_init(&entity_state, init_args);
+  ASSERT_FALSE(result.error) << result.error_message;
+
+  // The first entity creates a CTest, the second one is a delayed delta from the first
+  dg_bitwriter writer;
+  dg_bitwriter_init(&writer, 1024);
+  dg_bitwriter_write_bit(&writer, false);
+  dg_bitwriter_write_bit(&writer, true);
+  dg_bitwriter_write_uint(&writer, 1, 1); // Class ids are off by one
+  write_temp_entity_props(&writer, &version, {int_value(0, 42), int_value(1, 7)});
+  dg_bitwriter_write_bit(&writer, true);
+  dg_bitwriter_write_sint(&writer, 50, 8);
+  dg_bitwriter_write_bit(&writer, false);
+  write_temp_entity_props(&writer, &version, {int_value(1, -3)});
+
+  dg_svc_temp_entities message;
+  memset(&message, 0, sizeof(message));
+  message.num_entries = 2;
+  message.data = dg_bitstream_create(writer.ptr, writer.bitoffset);
+
+  dg_svc_temp_entities_parsed output;
+  dg_temp_entities_parse_args args;
+  memset(&args, 0, sizeof(args));
+  args.message = &message;
+  args.allocator = &allocator;
+  args.permanent_allocator = &allocator;
+  args.demver_data = &version;
+  args.entity_state = &entity_state;
+  args.output = &output;
+  result = dg_parse_temp_entities(&args);
+  ASSERT_FALSE(result.error) << result.error_message;
+  ASSERT_EQ(output.entities_count, 2);
+  EXPECT_EQ(output.orig, &message);
+
+  const dg_temp_entity *first = output.entities;
+  EXPECT_TRUE(first->new_class);
+  EXPECT_EQ(first->delay, 0.0f);
+  ASSERT_EQ(first->update.datatable_id, 0);
+  EXPECT_STREQ(parsed.output.serverclasses[first->update.datatable_id].serverclass_name, "CTest");
+  ASSERT_EQ(first->update.prop_value_array_size, 2);
+  EXPECT_EQ(first->update.prop_value_array[0].prop_index, 0);
+  EXPECT_EQ(first->update.prop_value_array[0].value.signed_val, 42);
+  EXPECT_EQ(first->update.prop_value_array[1].prop_index, 1);
+  EXPECT_EQ(first->update.prop_value_array[1].value.signed_val, 7);
+
+  const dg_temp_entity *second = output.entities + 1;
+  EXPECT_FALSE(second->new_class);
+  EXPECT_FLOAT_EQ(second->delay, 0.5f);
+  EXPECT_EQ(second->update.datatable_id, 0);
+  ASSERT_EQ(second->update.prop_value_array_size, 1);
+  EXPECT_EQ(second->update.prop_value_array[0].prop_index, 1);
+  EXPECT_EQ(second->update.prop_value_array[0].value.signed_val, -3);
+
+  // Filtered classes are decoded but left out of the output
+  bool class_filter[] = {false};
+  args.class_filter = class_filter;
+  result = dg_parse_temp_entities(&args);
+  ASSERT_FALSE(result.error) << result.error_message;
+  EXPECT_EQ(output.entities_count, 0);
+
+  dg_bitwriter_free(&writer);
+  dg_estate_free(&entity_state);
+  dg_bitwriter_free(&dt_writer);
+  dg_arena_free(&arena);
+}
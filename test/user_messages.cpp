@@ -0,0 +1,98 @@
+extern "C" {
+#include "demogobbler.h"
+#include "demogobbler/bitwriter.h"
+}
+
+#include "gtest/gtest.h"
+#include "utils/datatables.hpp"
+#include <cstring>
+
+TEST(user_messages, portal2) {
+  dg_arena arena = dg_arena_create(4096);
+  dg_alloc_state allocator = dg_arena_create_allocator(&arena);
+  dg_demver_data version = get_version("portal2", 4, 2001);
+
+  EXPECT_EQ(dg_get_user_message_type(&version, 11), um_shake);
+  EXPECT_EQ(dg_get_user_message_type(&version, 13), um_fade);
+  EXPECT_EQ(dg_get_user_message_type(&version, 12), um_invalid);
+  EXPECT_EQ(dg_get_user_message_type(&version, 255), um_invalid);
+
+  dg_bitwriter writer;
+  dg_bitwriter_init(&writer, 1024);
+  dg_bitwriter_write_uint(&writer, 3, 8);
+  dg_bitwriter_write_uint(&writer, 1, 8);
+  dg_bitwriter_write_cstring(&writer, "#Portal_Chat");
+  dg_bitwriter_write_cstring(&writer, "player");
+
+  dg_user_message_parse_args args;
+  args.allocator = &allocator;
+  args.version_data = &version;
+  args.msg_type = 4;
+  args.stream = dg_bitstream_create(writer.ptr, writer.bitoffset);
+
+  dg_user_message_parsed parsed;
+  auto result = dg_parse_user_message(&parsed, &args);
+  ASSERT_EQ(result.error, false);
+  ASSERT_EQ(parsed.type, um_saytext2);
+  EXPECT_EQ(parsed.message_um_saytext2.client, 3);
+  EXPECT_EQ(parsed.message_um_saytext2.chat, true);
+  EXPECT_STREQ(parsed.message_um_saytext2.msg_name, "#Portal_Chat");
+  EXPECT_STREQ(parsed.message_um_saytext2.params[0], "player");
+  EXPECT_EQ(parsed.message_um_saytext2.params[1], nullptr);
+
+  writer.bitoffset = 0;
+  dg_bitwriter_write_uint(&writer, 0, 8);
+  dg_bitwriter_write_float(&writer, 1.5f);
+  dg_bitwriter_write_float(&writer, 2.5f);
+  dg_bitwriter_write_float(&writer, 3.5f);
+  args.msg_type = 11;
+  args.stream = dg_bitstream_create(writer.ptr, writer.bitoffset);
+  result = dg_parse_user_message(&parsed, &args);
+  ASSERT_EQ(result.error, false);
+  ASSERT_EQ(parsed.type, um_shake);
+  EXPECT_EQ(parsed.message_um_shake.amplitude, 1.5f);
+  EXPECT_EQ(parsed.message_um_shake.duration, 3.5f);
+
+  // Truncated message should not decode
+  args.stream = dg_bitstream_create(writer.ptr, 40);
+  result = dg_parse_user_message(&parsed, &args);
+  EXPECT_EQ(result.error, true);
+
+  dg_bitwriter_free(&writer);
+  dg_arena_free(&arena);
+}
+
+TEST(user_messages, old_engine) {
+  dg_arena arena = dg_arena_create(4096);
+  dg_alloc_state allocator = dg_arena_create_allocator(&arena);
+  dg_demver_data version = get_version("hl2", 3, 7);
+
+  // No SayText2 before the orange box, TextMsg comes right after SayText
+  EXPECT_EQ(dg_get_user_message_type(&version, 3), um_saytext);
+  EXPECT_EQ(dg_get_user_message_type(&version, 4), um_textmsg);
+  EXPECT_EQ(dg_get_user_message_type(&version, 5), um_invalid);
+
+  dg_bitwriter writer;
+  dg_bitwriter_init(&writer, 1024);
+  dg_bitwriter_write_uint(&writer, 4, 8);
+  dg_bitwriter_write_cstring(&writer, "#Game_saved");
+  dg_bitwriter_write_cstring(&writer, "player");
+
+  dg_user_message_parse_args args;
+  args.allocator = &allocator;
+  args.version_data = &version;
+  args.msg_type = 4;
+  args.stream = dg_bitstream_create(writer.ptr, writer.bitoffset);
+
+  dg_user_message_parsed parsed;
+  auto result = dg_parse_user_message(&parsed, &args);
+  ASSERT_EQ(result.error, false);
+  ASSERT_EQ(parsed.type, um_textmsg);
+  EXPECT_EQ(parsed.message_um_textmsg.dest, 4);
+  EXPECT_STREQ(parsed.message_um_textmsg.msg_name, "#Game_saved");
+  EXPECT_STREQ(parsed.message_um_textmsg.params[0], "player");
+  EXPECT_EQ(parsed.message_um_textmsg.params[1], nullptr);
+
+  dg_bitwriter_free(&writer);
+  dg_arena_free(&arena);
+}
@@ -0,0 +1,61 @@
+#include "datatables.hpp"
+#include <cstring>
+
+dg_demver_data get_version(const char *game_directory, int demo_protocol, int net_protocol) {
+  dg_header header;
+  memset(&header, 0, sizeof(header));
+  strcpy(header.game_directory, game_directory);
+  header.demo_protocol = demo_protocol;
+  header.net_protocol = net_protocol;
+  return dg_get_demo_version(&header);
+}
+
+void write_test_datatables(dg_bitwriter *writer, const dg_demver_data *version,
+                           const std::vector<test_prop> &props) {
+  dg_bitwriter_write_bit(writer, true);
+  dg_bitwriter_write_bit(writer, false); // needs_decoder
+  dg_bitwriter_write_cstring(writer, "DT_Test");
+  dg_bitwriter_write_uint(writer, props.size(), version->datatable_propcount_bits);
+  for (auto &prop : props) {
+    dg_bitwriter_write_uint(writer, 0, 5); // int
+    dg_bitwriter_write_cstring(writer, prop.name);
+    dg_bitwriter_write_uint(writer, 0, version->sendprop_flag_bits);
+    if (version->demo_protocol >= 4 && version->game != l4d) {
+      dg_bitwriter_write_uint(writer, 0, 8); // priority
+    }
+    dg_bitwriter_write_float(writer, 0);
+    dg_bitwriter_write_float(writer, 0);
+    dg_bitwriter_write_uint(writer, prop.numbits, version->sendprop_numbits_for_numbits);
+  }
+  dg_bitwriter_write_bit(writer, false);
+
+  dg_bitwriter_write_uint(writer, 1, 16);
+  dg_bitwriter_write_uint(writer, 0, 16);
+  dg_bitwriter_write_cstring(writer, "CTest");
+  dg_bitwriter_write_cstring(writer, "DT_Test");
+}
+
+dg_datatables get_datatables_message(const dg_bitwriter *writer) {
+  dg_datatables message;
+  memset(&message, 0, sizeof(message));
+  message.data = writer->ptr;
+  message.size_bytes = (writer->bitoffset + 7) / 8;
+  return message;
+}
+
+dg_datatables_parsed_rval parse_test_datatables(const dg_bitwriter *writer, dg_demver_data *version,
+                                                dg_alloc_state *allocator) {
+  dg_datatables message = get_datatables_message(writer);
+  return dg_parse_datatables(version, allocator, &message);
+}
+
+prop_value int_value(uint32_t index, int32_t value) {
+  prop_value output;
+  memset(&output, 0, sizeof(output));
+  output.prop_index = index;
+  output.value.signed_val = value;
+  output.value.proptype = sendproptype_int;
+  output.value.type = dg_int_signed;
+  output.value.prop_numbits = 8;
+  return output;
+}
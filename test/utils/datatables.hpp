@@ -0,0 +1,23 @@
+#pragma once
+
+#include "demogobbler.h"
+#include "demogobbler/bitwriter.h"
+#include <vector>
+
+// Fixtures for tests that need datatables and entity data without a demo file
+
+struct test_prop {
+  const char *name;
+  uint32_t numbits;
+};
+
+dg_demver_data get_version(const char *game_directory = "portal", int demo_protocol = 3,
+                           int net_protocol = 15);
+// Single class CTest with the table DT_Test that has only int props
+void write_test_datatables(dg_bitwriter *writer, const dg_demver_data *version,
+                           const std::vector<test_prop> &props);
+dg_datatables get_datatables_message(const dg_bitwriter *writer);
+dg_datatables_parsed_rval parse_test_datatables(const dg_bitwriter *writer, dg_demver_data *version,
+                                                dg_alloc_state *allocator);
+// Signed int value of a prop written with 8 bits
+prop_value int_value(uint32_t index, int32_t value);
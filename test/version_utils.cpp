@@ -0,0 +1,29 @@
+#include "gtest/gtest.h"
+extern "C" {
+  #include "demogobbler.h"
+  #include "demogobbler/version_utils.h"
+}
+#include <cstring>
+
+TEST(demo_version, netmessage_ids) {
+  for (int demo_protocol : {1, 3, 4}) {
+    dg_header header;
+    memset(&header, 0, sizeof(header));
+    header.demo_protocol = demo_protocol;
+    header.net_protocol = demo_protocol == 4 ? 2001 : 15;
+    strcpy(header.game_directory, "portal2");
+    dg_demver_data version = dg_get_demo_version(&header);
+
+    for (int type = 0; type < svc_invalid; ++type) {
+      int expected = -1;
+      for (unsigned int i = 0; i < version.netmessage_count; ++i) {
+        if (version.netmessage_array[i] == type) {
+          expected = i;
+          break;
+        }
+      }
+      EXPECT_EQ(version.netmessage_ids[type], expected) << "protocol " << demo_protocol;
+    }
+    EXPECT_EQ(version.netmessage_ids[svc_invalid], -1);
+  }
+}
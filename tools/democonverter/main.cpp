@@ -1,16 +1,24 @@
 #include "demogobbler.h"
 #include "demogobbler/freddie.hpp"
 #include <cstdio>
+#include <cstring>
 
 int main(int argc, char **argv) {
+  // --parallel keeps the whole input in memory and encodes it on every core
+  bool parallel = argc > 1 && std::strcmp(argv[1], "--parallel") == 0;
+  if (parallel) {
+    --argc;
+    ++argv;
+  }
+
   if (argc <= 3) {
-    printf("Usage: democonverter <example file> <input file> <output file>\n");
+    printf("Usage: democonverter [--parallel] <example file> <input file> <output file>\n");
     return 0;
   }
 
+  // Only the header and datatables of the example are needed, the packets are left undecoded
   freddie::demo_t example;
-  freddie::demo_t input;
-  auto result = freddie::demo_t::parse_demo(&example, argv[1]);
+  auto result = freddie::demo_t::parse_demo_lazy(&example, argv[1]);
 
   if(result.error)
   {
@@ -18,29 +26,32 @@ int main(int argc, char **argv) {
     return 1;
   }
 
-  result = freddie::demo_t::parse_demo(&input, argv[2]);
-
-  if(result.error)
-  {
-    std::printf("error parsing input demo: %s\n", result.error_message);
-    return 1;
+  if (parallel) {
+    freddie::demo_t input;
+    result = freddie::demo_t::parse_demo(&input, argv[2]);
+
+    if(result.error)
+    {
+      std::printf("error parsing input demo: %s\n", result.error_message);
+      return 1;
+    }
+
+    result = freddie::convert_demo(&example, &input);
+
+    if(!result.error)
+    {
+      result = input.write_demo(argv[3], 0);
+    }
+  } else {
+    // The input is converted as it is parsed and never kept in memory as a whole
+    result = freddie::convert_demo(&example, argv[2], argv[3]);
   }
 
-  result = freddie::convert_demo(&example, &input);
-
   if(result.error)
   {
     std::printf("error converting demo: %s\n", result.error_message);
     return 1;
   }
 
-  result = input.write_demo(argv[3]);
-
-  if(result.error)
-  {
-    std::printf("error writing output demo: %s\n", result.error_message);
-    return 1;
-  }
-
   return 0;
-}
\ No newline at end of file
+}
@@ -374,7 +374,7 @@ void print_flattened_props(parser_state *state) {
     printf("Sendtable %s: flattened, %lu props\n", class_data.dt_name, class_data.prop_count);
 
     for (size_t u = 0; u < class_data.prop_count; ++u) {
-      dg_sendprop *prop = class_data.props + u;
+      dg_sendprop *prop = class_data.props[u];
       printf("[%lu]", u);
       print_prop(prop);
     }
@@ -468,7 +468,7 @@ static void print_inner_prop_value(dg_sendprop *prop, dg_prop_value_inner value)
 }
 
 static void print_prop_value(prop_value *value, dg_serverclass_data* data) {
-  dg_sendprop *prop = data->props + value->prop_index;
+  dg_sendprop *prop = data->props[value->prop_index];
   const char *prop_name = get_prop_name(prop);
   printf("\t[%u] %s = ", value->prop_index, prop_name);
   print_inner_prop_value(prop, value->value);
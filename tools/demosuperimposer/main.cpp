@@ -15,6 +15,7 @@ static int get_prop_index(demo_t *demo, int datatable_id, const char *prop_name)
   args.allocator = &allocator;
   args.flatten_datatables = false;
   args.should_store_props = false;
+  args.build_prop_lookup = true;
   args.message = demo->get_datatables();
   auto result = dg_estate_init(&state, args);
   if (result.error) {
@@ -22,39 +23,23 @@ static int get_prop_index(demo_t *demo, int datatable_id, const char *prop_name)
     return -1;
   }
 
-  int prop_index = -1;
-  dg_serverclass_data *class_data =
-      dg_estate_serverclass_data(&state, &demo->demver_data, &allocator, datatable_id);
-  for (size_t i = 0; i < class_data->prop_count; i++) {
-    if (strcmp(prop_name, class_data->props[i].name) == 0) {
-      prop_index = i;
-      break;
-    }
-  }
+  dg_estate_serverclass_data(&state, &demo->demver_data, &allocator, datatable_id);
+  int prop_index = dg_estate_find_prop(&state, datatable_id, prop_name);
 
   dg_estate_free(&state);
   return prop_index;
 }
 
 static void collect_player_updates(demo_t *demo, std::map<int32_t, dg_ent_update> &data) {
-  for (auto &message : demo->packets) {
-    auto *packet = &message->packet;
-    packet_parsed *ptr = std::get_if<packet_parsed>(packet);
-
-    if (!ptr)
-      continue;
-
+  for (auto location : demo->get_netmessages(svc_packet_entities)) {
+    packet_parsed *ptr = std::get_if<packet_parsed>(&demo->packets[location.packet_index]);
     int32_t tick = ptr->orig.preamble.tick;
-    for (size_t msg_index = 0; msg_index < ptr->message_count; ++msg_index) {
-      packet_net_message *msg = ptr->messages + msg_index;
-      if (msg->mtype == svc_packet_entities) {
-        dg_packetentities_data *packet_entities = &msg->message_svc_packet_entities.parsed->data;
-        for (uint32_t j = 0; j < packet_entities->ent_updates_count; j++) {
-          if (packet_entities->ent_updates[j].ent_index == 1) {
-            data[tick] = packet_entities->ent_updates[j];
-            break;
-          }
-        }
+    packet_net_message *msg = ptr->messages + location.message_index;
+    dg_packetentities_data *packet_entities = &msg->message_svc_packet_entities.parsed->data;
+    for (uint32_t j = 0; j < packet_entities->ent_updates_count; j++) {
+      if (packet_entities->ent_updates[j].ent_index == 1) {
+        data[tick] = packet_entities->ent_updates[j];
+        break;
       }
     }
   }
@@ -65,81 +50,73 @@ static void add_player_updates(demo_t *demo, std::vector<std::map<int32_t, dg_en
   // Changing m_flSimulationTime doesn't seem to fix Portal2 demo
   bool should_smooth_demo = (demo->demver_data.demo_protocol < 4);
 
-  for (auto &message : demo->packets) {
-    auto *packet = &message->packet;
-    packet_parsed *ptr = std::get_if<packet_parsed>(packet);
-
-    if (!ptr)
-      continue;
-
+  for (auto location : demo->get_netmessages(svc_packet_entities)) {
+    packet_parsed *ptr = std::get_if<packet_parsed>(&demo->packets[location.packet_index]);
     int32_t tick = ptr->orig.preamble.tick;
-    for (size_t msg_index = 0; msg_index < ptr->message_count; ++msg_index) {
-      packet_net_message *msg = ptr->messages + msg_index;
-      if (msg->mtype == svc_packet_entities) {
-        dg_packetentities_data *packet_entities = &msg->message_svc_packet_entities.parsed->data;
-
-        if (should_smooth_demo && m_flSimulationTime_index == -1) {
-          for (uint32_t i = 0; i < packet_entities->ent_updates_count; i++) {
-            if (packet_entities->ent_updates[i].ent_index == 1) {
-              m_flSimulationTime_index = get_prop_index(
-                  demo, packet_entities->ent_updates[i].datatable_id, "m_flSimulationTime");
-              break;
-            }
-          }
+    packet_net_message *msg = ptr->messages + location.message_index;
+    dg_packetentities_data *packet_entities = &msg->message_svc_packet_entities.parsed->data;
+
+    if (should_smooth_demo && m_flSimulationTime_index == -1) {
+      for (uint32_t i = 0; i < packet_entities->ent_updates_count; i++) {
+        if (packet_entities->ent_updates[i].ent_index == 1) {
+          m_flSimulationTime_index = get_prop_index(
+              demo, packet_entities->ent_updates[i].datatable_id, "m_flSimulationTime");
+          break;
         }
+      }
+    }
 
-        // Get all the updates
-        std::vector<dg_ent_update> player_updates;
-        uint32_t max_entries = msg->message_svc_packet_entities.max_entries;
-        for (size_t i = 0; i < data.size(); i++) {
-          if (data[i].find(tick) == data[i].end())
-            continue;
-
-          // Ghost index starts at DEMO_GHOST_INDEX
-          dg_ent_update *update = &data[i][tick];
-          update->ent_index = DEMO_GHOST_INDEX + i;
-          max_entries = DEMO_GHOST_INDEX + i - 1;
-
-          if (should_smooth_demo && m_flSimulationTime_index != -1) {
-            // Hack to fix interpolation issue
-            for (size_t j = 0; j < update->prop_value_array_size; j++) {
-              if ((int)update->prop_value_array[j].prop_index == m_flSimulationTime_index &&
-                  update->prop_value_array[j].value.signed_val < 33) {
-                update->prop_value_array[j].value.signed_val += 100;
-              }
-            }
+    // Get all the updates
+    std::vector<dg_ent_update> player_updates;
+    uint32_t max_entries = msg->message_svc_packet_entities.max_entries;
+    for (size_t i = 0; i < data.size(); i++) {
+      if (data[i].find(tick) == data[i].end())
+        continue;
+
+      // Ghost index starts at DEMO_GHOST_INDEX
+      dg_ent_update *update = &data[i][tick];
+      update->ent_index = DEMO_GHOST_INDEX + i;
+      max_entries = DEMO_GHOST_INDEX + i - 1;
+
+      if (should_smooth_demo && m_flSimulationTime_index != -1) {
+        // Hack to fix interpolation issue
+        for (size_t j = 0; j < update->prop_value_array_size; j++) {
+          if ((int)update->prop_value_array[j].prop_index == m_flSimulationTime_index &&
+              update->prop_value_array[j].value.signed_val < 33) {
+            update->prop_value_array[j].value.signed_val += 100;
           }
-          player_updates.push_back(data[i][tick]);
         }
-
-        if (player_updates.empty())
-          continue;
-
-        // Edit the packet_entities->ent_pudates
-        write_packetentities_args args = {0};
-        args.is_delta = msg->message_svc_packet_entities.is_delta;
-        args.version = &demo->demver_data;
-        std::vector<dg_ent_update> new_updates(packet_entities->ent_updates,
-                                               packet_entities->ent_updates +
-                                                   packet_entities->ent_updates_count);
-        new_updates.insert(new_updates.end(), player_updates.begin(), player_updates.end());
-
-        packet_entities->ent_updates_count = new_updates.size();
-        packet_entities->ent_updates = new_updates.data();
-        msg->message_svc_packet_entities.max_entries = max_entries;
-        msg->message_svc_packet_entities.updated_entries += player_updates.size();
-
-        args.data = &msg->message_svc_packet_entities.parsed->data;
-        uint32_t bits = dg_bitstream_bits_left(&msg->message_svc_packet_entities.data);
-        dg_bitwriter bitwriter;
-        dg_bitwriter_init(&bitwriter, bits);
-        auto stream = get_start_state(&bitwriter);
-        dg_bitwriter_write_packetentities(&bitwriter, args);
-        freddie::finalize_stream(&stream, &bitwriter);
-        message->memory.attach(bitwriter.ptr); // transfer the bitwriter memory over to the packet
-        msg->message_svc_packet_entities.data = stream;
       }
+      player_updates.push_back(data[i][tick]);
     }
+
+    if (player_updates.empty())
+      continue;
+
+    // Edit the packet_entities->ent_pudates
+    write_packetentities_args args = {0};
+    args.is_delta = msg->message_svc_packet_entities.is_delta;
+    args.version = &demo->demver_data;
+    std::vector<dg_ent_update> new_updates(packet_entities->ent_updates,
+                                           packet_entities->ent_updates +
+                                               packet_entities->ent_updates_count);
+    new_updates.insert(new_updates.end(), player_updates.begin(), player_updates.end());
+
+    packet_entities->ent_updates_count = new_updates.size();
+    packet_entities->ent_updates = new_updates.data();
+    msg->message_svc_packet_entities.max_entries = max_entries;
+    msg->message_svc_packet_entities.updated_entries += player_updates.size();
+
+    args.data = &msg->message_svc_packet_entities.parsed->data;
+    uint32_t bits = dg_bitstream_bits_left(&msg->message_svc_packet_entities.data);
+    dg_bitwriter bitwriter;
+    dg_bitwriter_init(&bitwriter, bits);
+    auto stream = get_start_state(&bitwriter);
+    dg_bitwriter_write_packetentities(&bitwriter, args);
+    freddie::finalize_stream(&stream, &bitwriter);
+    demo->memory.attach(bitwriter.ptr); // transfer the bitwriter memory over to the demo
+    msg->message_svc_packet_entities.data = stream;
+    ptr->modified = true;
   }
 }
 
@@ -22,17 +22,6 @@ static void print_int(dg_sendprop *prop, dg_prop_value_inner value) {
   }
 }
 
-static const char *get_prop_name(dg_sendprop *prop) {
-  static char BUFFER[1024];
-
-  if (prop->proptype != sendproptype_datatable && prop->baseclass) {
-    snprintf(BUFFER, sizeof(BUFFER), "%s.%s", prop->baseclass->name, prop->name);
-    return BUFFER;
-  } else {
-    return prop->name;
-  }
-}
-
 static void grab_header(parser_state* a, dg_header* header)
 {
   dump_state* state = a->client_state;
@@ -44,57 +33,47 @@ void handle_packet(parser_state *a, packet_parsed *message) {
   state->tick = message->orig.preamble.tick;
 }
 
-static void handle_packetentities_parsed(parser_state *state,
-                                        dg_svc_packetentities_parsed *message) {
+static void handle_changed_props(parser_state *state, const dg_changed_props *changes) {
   dump_state* dumpstate = state->client_state;
 
-  for (size_t i = 0; i < message->data.ent_updates_count; ++i) {
+  for (size_t i = 0; i < changes->entities_count; ++i) {
+    const dg_changed_entity *entity = changes->entities + i;
+    if(entity->ent_index != 3)
+      continue;
 
-    dg_ent_update *update = message->data.ent_updates + i;
-    if(update->ent_index != 3)
+    int index = dg_estate_find_prop(&state->entity_state, entity->ent->datatable_id, "m_iHealth.001");
+    if(index == -1 || !dg_edict_prop_changed(entity->ent, index))
       continue;
-    dg_serverclass_data* data = state->entity_state.class_datas + update->datatable_id;
-
-    if (update->prop_value_array_size > 0) {
-      for (size_t u = 0; u < update->prop_value_array_size; ++u) {
-        prop_value *value = update->prop_value_array + u;
-        dg_sendprop* prop = data->props + value->prop_index;
-        const char *prop_name = get_prop_name(prop);
-
-        if(strcmp("m_iHealth.001", prop_name) == 0)
-        {
-          int hp = value->value.signed_val;
-
-          if(hp < dumpstate->prev_health && !dumpstate->has_died && (!dumpstate->is_outland_01 || hp != 72))
-          {
-            dumpstate->has_died = true;
-            int startTick = dumpstate->tick - 660;
-
-            if(startTick > 0)
-            {
-              printf("demoactions\n"
-              "{\n"
-                "\t\"1\"\n"
-                "\t{\n"
-                  "\t\tfactory \"SkipAhead\"\n"
-                  "\t\tname \"Unnamed1\"\n"
-                  "\t\tstarttick \"0\"\n"
-                  "\t\tskiptotick \"%d\"\n"
-                "\t}\n"
-              "}\n", startTick);
-            }
-            else
-            {
-              printf("demoactions\n"
-              "{\n"
-              "}\n");
-            }
-          }
-
-          dumpstate->prev_health = hp;
-        }   
+
+    int hp = entity->ent->props.values[index].signed_val;
+
+    if(hp < dumpstate->prev_health && !dumpstate->has_died && (!dumpstate->is_outland_01 || hp != 72))
+    {
+      dumpstate->has_died = true;
+      int startTick = dumpstate->tick - 660;
+
+      if(startTick > 0)
+      {
+        printf("demoactions\n"
+        "{\n"
+          "\t\"1\"\n"
+          "\t{\n"
+            "\t\tfactory \"SkipAhead\"\n"
+            "\t\tname \"Unnamed1\"\n"
+            "\t\tstarttick \"0\"\n"
+            "\t\tskiptotick \"%d\"\n"
+          "\t}\n"
+        "}\n", startTick);
+      }
+      else
+      {
+        printf("demoactions\n"
+        "{\n"
+        "}\n");
       }
     }
+
+    dumpstate->prev_health = hp;
   }
 }
 
@@ -128,7 +107,9 @@ int main(int argc, char **argv) {
   dg_settings_init(&settings);
   settings.header_handler = grab_header;
   settings.packet_parsed_handler = handle_packet;
-  settings.packetentities_parsed_handler = handle_packetentities_parsed;
+  // Only called for entities whose props changed value, the props are kept in the entity state
+  settings.changed_props_handler = handle_changed_props;
+  settings.build_prop_lookup = true;
   dump_state dump;
   memset(&dump, 0, sizeof(dump_state));
 
@@ -1,8 +1,16 @@
 #include "demogobbler.h"
+#include "demogobbler/conversions.h"
 #include "stdio.h"
 #include <string.h>
 
+typedef struct {
+  int datatable_id;
+  int view_offset_index[3];
+} jumpsmoother_state;
+
 static void handle_svcpacketentities_parsed(parser_state *_state, dg_svc_packetentities_parsed *message) {
+  jumpsmoother_state *state = _state->client_state;
+
   for(size_t i=0; i < message->data.ent_updates_count; ++i) {
     dg_ent_update* update = message->data.ent_updates + i;
 
@@ -11,11 +19,26 @@ static void handle_svcpacketentities_parsed(parser_state *_state, dg_svc_packete
     else if(update->ent_index > 1)
       break;
 
-    for(size_t prop_index; prop_index < update->prop_value_array_size; ++prop_index) {
+    // Resolve the props once, the update loop only compares indices
+    if(update->datatable_id != state->datatable_id) {
+      static const char *names[] = {"m_vecViewOffset[0]", "m_vecViewOffset[1]", "m_vecViewOffset[2]"};
+      state->datatable_id = update->datatable_id;
+      for(size_t u=0; u < 3; ++u) {
+        state->view_offset_index[u] = dg_estate_find_prop(&_state->entity_state, update->datatable_id, names[u]);
+      }
+    }
+
+    dg_serverclass_data* data = _state->entity_state.class_datas + update->datatable_id;
+    for(size_t prop_index=0; prop_index < update->prop_value_array_size; ++prop_index) {
       prop_value value = update->prop_value_array[prop_index];
-      if(strstr(value.prop->name, "m_vecViewOffset") != NULL)
-      {
-        //
+      for(size_t u=0; u < 3; ++u) {
+        if((int)value.prop_index == state->view_offset_index[u])
+        {
+          // The view offset is usually a scaled float, the sendprop knows how to decode it
+          float out = dg_prop_to_float(data->props[value.prop_index], value.value);
+          printf("m_vecViewOffset[%d] = %f\n", (int)u, out);
+          break;
+        }
       }
     }
   }
@@ -27,8 +50,14 @@ int main(int argc, char **argv) {
     return 0;
   }
 
+  jumpsmoother_state state;
+  memset(&state, 0, sizeof(state));
+  state.datatable_id = -1;
+
   dg_settings settings;
   dg_settings_init(&settings);
+  settings.client_state = &state;
+  settings.build_prop_lookup = true;
   settings.packetentities_parsed_handler = handle_svcpacketentities_parsed;
 
   dg_parse_file(&settings, argv[1]);
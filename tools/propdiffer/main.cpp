@@ -1,8 +1,11 @@
 #include "demogobbler.h"
 #include "demogobbler/freddie.hpp"
+#include "demogobbler/utils.h"
 #include <cstdio>
 #include <stdarg.h>
 #include <string.h>
+#include <string_view>
+#include <unordered_map>
 
 const char* firstdemo = nullptr;
 const char* seconddemo = nullptr;
@@ -25,11 +28,11 @@ static void print_msg(bool first, const char* format, ...) {
 
 static int32_t get_dt(const estate *state, const char *name, int32_t initial_guess) {
   if ((int32_t)state->serverclass_count > initial_guess &&
-      strcmp(state->class_datas[initial_guess].dt_name, name) == 0) {
+      dt_name_equal(state->class_datas[initial_guess].dt_name, name)) {
     return initial_guess;
   } else {
     for (int32_t i = 0; i < (int32_t)state->serverclass_count; ++i) {
-      if (strcmp(name, state->class_datas[i].dt_name) == 0) {
+      if (dt_name_equal(name, state->class_datas[i].dt_name)) {
         return i;
       }
     }
@@ -41,19 +44,9 @@ static int32_t get_dt(const estate *state, const char *name, int32_t initial_gue
   if (args->func)                                                                                  \
   args->func(__VA_ARGS__)
 
-static bool prop_equal(const dg_sendprop* prop1, const char* prop_name)
-{
-  char prop1_name[64];
-  dg_sendprop_name(prop1_name, sizeof(prop1_name), prop1);
-
-  return strcmp(prop1_name, prop_name) == 0;
-}
 
 static bool prop_attributes_equal(const compare_props_args *args, const dg_sendprop* prop1, const dg_sendprop* prop2)
 {
-  char prop1_name[64];
-  dg_sendprop_name(prop1_name, sizeof(prop1_name), prop1);
-
   bool equal = true;
 #define COMPARE_ELEMENT(x) if(prop1->x != prop2->x) { \
     equal = false; \
@@ -83,43 +76,75 @@ static bool prop_attributes_equal(const compare_props_args *args, const dg_sendp
   return equal;
 }
 
-static dg_sendprop* find_prop(const dg_serverclass_data *data, const char* name, size_t initial_index)
+namespace {
+// Props are looked up by table and prop name without building the qualified name
+struct prop_name {
+  std::string_view table;
+  std::string_view name;
+  bool operator==(const prop_name &rhs) const { return table == rhs.table && name == rhs.name; }
+};
+
+struct prop_name_hash {
+  size_t operator()(const prop_name &key) const {
+    return std::hash<std::string_view>()(key.table) * 31 + std::hash<std::string_view>()(key.name);
+  }
+};
+
+typedef std::unordered_map<prop_name, int, prop_name_hash> prop_name_map;
+} // namespace
+
+static bool prop_equal(const dg_sendprop *prop1, const dg_sendprop *prop2) {
+  return dt_name_equal(prop1->name, prop2->name) &&
+         dt_name_equal(prop1->baseclass->name, prop2->baseclass->name);
+}
+
+// Returns the index of the prop or -1 if not found. The lookup is filled on the first miss.
+static int find_prop(const estate *state, uint32_t datatable_id, const dg_sendprop *prop,
+                     size_t initial_index, prop_name_map *lookup)
 {
-  if(initial_index < data->prop_count)
+  const dg_serverclass_data *data = state->class_datas + datatable_id;
+  if(initial_index < data->prop_count && prop_equal(data->props[initial_index], prop))
   {
-    if(prop_equal(data->props + initial_index, name))
-    {
-      return data->props + initial_index;
-    }
+    return initial_index;
   }
 
-  for(size_t i=0; i < data->prop_count; ++i)
+  if(lookup->empty())
   {
-    if(prop_equal(data->props + i, name))
-      return data->props + i;
+    for(size_t i=0; i < data->prop_count; ++i)
+    {
+      lookup->emplace(prop_name{data->props[i]->baseclass->name, data->props[i]->name}, i);
+    }
   }
 
-  return nullptr;
+  auto it = lookup->find(prop_name{prop->baseclass->name, prop->name});
+  return it != lookup->end() ? it->second : -1;
 }
 
 static void compare_sendtable_props(const compare_props_args *args,
-                                    const dg_serverclass_data *data1,
-                                    const dg_serverclass_data *data2) {
-  char buffer[64];
+                                    const estate *state1, uint32_t datatable_id1,
+                                    const estate *state2, uint32_t datatable_id2) {
+  const dg_serverclass_data *data1 = state1->class_datas + datatable_id1;
+  const dg_serverclass_data *data2 = state2->class_datas + datatable_id2;
+  prop_name_map lookup1;
+  prop_name_map lookup2;
+  // Names are only built for the props that get printed
+  char buffer[256];
   for(size_t i=0; i < data1->prop_count; ++i)
   {
-    dg_sendprop* first_prop = data1->props + i;
-    dg_sendprop_name(buffer, sizeof(buffer), first_prop);
-    dg_sendprop* prop = find_prop(data2, buffer, i);
-    if(!prop)
+    dg_sendprop* first_prop = data1->props[i];
+    int found_index = find_prop(state2, datatable_id2, first_prop, i, &lookup2);
+    if(found_index == -1)
     {
+      dg_sendprop_name(buffer, sizeof(buffer), first_prop);
       args->func(true, "\tonly has %s at %lu\n", buffer, i);
       continue;
     }
-  
-    size_t index = prop - data2->props;
+
+    size_t index = found_index;
+    dg_sendprop* prop = data2->props[index];
     if(index != i)
     {
+      dg_sendprop_name(buffer, sizeof(buffer), first_prop);
       args->func(true, "\tprop %s index changed %lu -> %lu\n", buffer, i, index);
     }
 
@@ -128,11 +153,10 @@ static void compare_sendtable_props(const compare_props_args *args,
 
   for(size_t i=0; i < data2->prop_count; ++i)
   {
-    dg_sendprop* first_prop = data2->props + i;
-    dg_sendprop_name(buffer, sizeof(buffer), first_prop);
-    dg_sendprop* prop = find_prop(data1, buffer, i);
-    if(!prop)
+    dg_sendprop* first_prop = data2->props[i];
+    if(find_prop(state1, datatable_id1, first_prop, i, &lookup1) == -1)
     {
+      dg_sendprop_name(buffer, sizeof(buffer), first_prop);
       args->func(false, "\tonly has %s at %lu\n", buffer, i);
       continue;
     }